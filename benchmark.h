@@ -0,0 +1,183 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+// nearest-rank percentile of sorted values
+inline double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+    if (rank < 1)
+        rank = 1;
+    if (rank > sorted.size())
+        rank = sorted.size();
+    return sorted[rank - 1];
+}
+
+// JSON object with the mean, p50, p95, p99 and max of a set of times
+inline std::string summariseTimes(const std::vector<double>& values)
+{
+    std::vector<double> sorted(values);
+    std::sort(sorted.begin(), sorted.end());
+    double mean = 0.0;
+    for (size_t i = 0; i < sorted.size(); i++)
+        mean += sorted[i];
+    if (!sorted.empty())
+        mean /= sorted.size();
+
+    std::ostringstream json;
+    json << "{ \"mean\": " << mean
+        << ", \"p50\": " << percentile(sorted, 50.0)
+        << ", \"p95\": " << percentile(sorted, 95.0)
+        << ", \"p99\": " << percentile(sorted, 99.0)
+        << ", \"max\": " << (sorted.empty() ? 0.0 : sorted.back()) << " }";
+    return json.str();
+}
+
+// Stages of a frame that the benchmark times separately
+enum Frame_Stage {
+    STAGE_UPDATE,   // input, camera and animation
+    STAGE_SUBMIT,   // issuing GL commands for the scene
+    STAGE_SWAP,     // swapping buffers (or finishing the frame when headless)
+    STAGE_COUNT
+};
+
+// Records CPU time per frame and per stage and reports percentiles as JSON, so builds can be compared.
+// A stage can be entered more than once per frame; its times are summed. Nothing is recorded unless Enabled is set.
+class FrameBenchmark
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    bool Enabled;
+
+    FrameBenchmark() : Enabled(false), startupMs(0.0), currentStage(STAGE_COUNT), inFrame(false)
+    {
+        programStart = Clock::now();
+    }
+
+    // call once before the first frame so the time spent loading is reported as startup time
+    void EndStartup()
+    {
+        startupMs = millisecondsSince(programStart);
+        runStart = Clock::now();
+    }
+
+    void BeginFrame()
+    {
+        if (!Enabled)
+            return;
+        for (int i = 0; i < STAGE_COUNT; i++)
+            current[i] = 0.0;
+        frameStart = Clock::now();
+        inFrame = true;
+    }
+
+    void BeginStage(Frame_Stage stage)
+    {
+        if (!Enabled)
+            return;
+        currentStage = stage;
+        stageStart = Clock::now();
+    }
+
+    void EndStage()
+    {
+        if (currentStage != STAGE_COUNT)
+            current[currentStage] += millisecondsSince(stageStart);
+        currentStage = STAGE_COUNT;
+    }
+
+    void EndFrame()
+    {
+        if (!inFrame)
+            return;
+        for (int i = 0; i < STAGE_COUNT; i++)
+            stageTimes[i].push_back(current[i]);
+        frameTimes.push_back(millisecondsSince(frameStart));
+        inFrame = false;
+    }
+
+    // adds a named JSON value (object, array or number) to the report
+    void AddSection(const std::string& name, const std::string& json)
+    {
+        sections.push_back(std::make_pair(name, json));
+    }
+
+    size_t FrameCount() const
+    {
+        return frameTimes.size();
+    }
+
+    void WriteReport(std::ostream& out) const
+    {
+        double runSeconds = millisecondsSince(runStart) / 1000.0;
+        double frameMsTotal = 0.0;
+        for (size_t i = 0; i < frameTimes.size(); i++)
+            frameMsTotal += frameTimes[i];
+
+        out << "{\n";
+        out << "  \"frames\": " << frameTimes.size() << ",\n";
+        out << "  \"startup_ms\": " << startupMs << ",\n";
+        out << "  \"run_seconds\": " << runSeconds << ",\n";
+        out << "  \"fps\": " << (frameMsTotal > 0.0 ? frameTimes.size() * 1000.0 / frameMsTotal : 0.0) << ",\n";
+        out << "  \"frame_ms\": " << summariseTimes(frameTimes) << ",\n";
+        out << "  \"stages_ms\": {\n";
+        const char* names[STAGE_COUNT] = { "update", "submit", "swap" };
+        for (int i = 0; i < STAGE_COUNT; i++)
+            out << "    \"" << names[i] << "\": " << summariseTimes(stageTimes[i]) << (i + 1 < STAGE_COUNT ? ",\n" : "\n");
+        out << "  }";
+        for (size_t i = 0; i < sections.size(); i++)
+            out << ",\n  \"" << sections[i].first << "\": " << sections[i].second;
+        out << "\n}" << std::endl;
+    }
+
+    // writes to the given file, or to stdout when the path is empty
+    bool WriteReport(const std::string& path) const
+    {
+        if (path.empty())
+        {
+            WriteReport(std::cout);
+            return true;
+        }
+        std::ofstream file(path.c_str());
+        if (!file)
+        {
+            std::cout << "ERROR::BENCHMARK::REPORT_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        WriteReport(file);
+        if (!file)
+        {
+            std::cout << "ERROR::BENCHMARK::REPORT_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    Clock::time_point programStart, runStart, frameStart, stageStart;
+    double startupMs;
+    double current[STAGE_COUNT];
+    Frame_Stage currentStage;
+    bool inFrame;
+
+    std::vector<double> frameTimes;
+    std::vector<double> stageTimes[STAGE_COUNT];
+    std::vector<std::pair<std::string, std::string> > sections;
+
+    static double millisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+};
+#endif
@@ -105,6 +105,16 @@ public:
         updateCameraVectors();
     }
 
+    // places the camera directly, e.g. when replaying a recorded path. Recomputes the same vectors as live input so replays match exactly
+    void SetPose(glm::vec3 position, float yaw, float pitch, float zoom)
+    {
+        Position = position;
+        Yaw = yaw;
+        Pitch = pitch;
+        Zoom = zoom;
+        updateCameraVectors();
+    }
+
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
     void ProcessMouseScroll(float yoffset)
     {
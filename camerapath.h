@@ -0,0 +1,106 @@
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include "camera.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+// One tick of camera state. Only the values that input changes are stored, the rest are derived from them
+struct CameraSample {
+    float Position[3];
+    float Yaw;
+    float Pitch;
+    float Zoom;
+};
+
+// A recorded camera session, one sample per frame, used to repeat flythroughs exactly.
+// File layout: "CAMP", uint32 version, uint32 sample count, then the samples as raw little-endian floats (24 bytes each).
+class CameraPath
+{
+public:
+    std::vector<CameraSample> Samples;
+
+    // appends the camera's current state as the next tick
+    void Record(const Camera& camera)
+    {
+        CameraSample sample;
+        sample.Position[0] = camera.Position.x;
+        sample.Position[1] = camera.Position.y;
+        sample.Position[2] = camera.Position.z;
+        sample.Yaw = camera.Yaw;
+        sample.Pitch = camera.Pitch;
+        sample.Zoom = camera.Zoom;
+        Samples.push_back(sample);
+    }
+
+    // moves the camera to the given tick, holding the last sample once the path has ended. Returns false past the end
+    bool Apply(Camera& camera, size_t tick) const
+    {
+        if (Samples.empty())
+            return false;
+        const CameraSample& sample = Samples[tick < Samples.size() ? tick : Samples.size() - 1];
+        camera.SetPose(glm::vec3(sample.Position[0], sample.Position[1], sample.Position[2]), sample.Yaw, sample.Pitch, sample.Zoom);
+        return tick < Samples.size();
+    }
+
+    bool Save(const std::string& path) const
+    {
+        std::ofstream file(path.c_str(), std::ios::binary);
+        if (!file)
+        {
+            std::cout << "ERROR::CAMERAPATH::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        uint32_t header[2] = { VERSION, (uint32_t)Samples.size() };
+        file.write(magic(), 4);
+        file.write((const char*)header, sizeof(header));
+        if (!Samples.empty())
+            file.write((const char*)&Samples[0], Samples.size() * sizeof(CameraSample));
+        return (bool)file;
+    }
+
+    bool Load(const std::string& path)
+    {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        char fileMagic[4];
+        uint32_t header[2];
+        if (!file.read(fileMagic, 4) || std::memcmp(fileMagic, magic(), 4) != 0 || !file.read((char*)header, sizeof(header)) || header[0] != VERSION)
+        {
+            std::cout << "ERROR::CAMERAPATH::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+            return false;
+        }
+        // the count is checked against what the file holds before anything is allocated for it
+        std::streamoff start = file.tellg();
+        file.seekg(0, std::ios::end);
+        std::streamoff available = file.tellg() - start;
+        file.seekg(start);
+        if ((uint64_t)header[1] * sizeof(CameraSample) > (uint64_t)available)
+        {
+            std::cout << "ERROR::CAMERAPATH::FILE_TRUNCATED: " << path << std::endl;
+            Samples.clear();
+            return false;
+        }
+        Samples.resize(header[1]);
+        if (header[1] > 0 && !file.read((char*)&Samples[0], (std::streamsize)header[1] * sizeof(CameraSample)))
+        {
+            std::cout << "ERROR::CAMERAPATH::FILE_TRUNCATED: " << path << std::endl;
+            Samples.clear();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static const uint32_t VERSION = 1;
+    // a function rather than a static array, so the header can be included in any number of translation units
+    static const char* magic()
+    {
+        return "CAMP";
+    }
+};
+#endif
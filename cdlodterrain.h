@@ -0,0 +1,333 @@
+#ifndef CDLOD_TERRAIN_H
+#define CDLOD_TERRAIN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "terrain.h"
+#include "frustum.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+// Most LOD levels the quadtree can have, also the size of the shader's morph range array. Level 11 nodes are
+// CDLOD_GRID_SIZE * 2^11 = 65536 samples across
+#define CDLOD_MAX_LODS 12
+
+// quads along each side of the grid mesh every node is drawn with
+const int CDLOD_GRID_SIZE = 32;
+// level 0 nodes are drawn within this distance of the camera, and each level after covers twice the distance
+const float CDLOD_LOD_DISTANCE = 32.0f;
+// fraction of the way through its range at which a level starts morphing into the next
+const float CDLOD_MORPH_START = 0.66f;
+
+// Continuous distance-dependent level of detail (Strugar, "Continuous Distance-Dependent Level of Detail for
+// Rendering Heightmaps", 2009). The heightmap is covered by a quadtree whose level 0 nodes are CDLOD_GRID_SIZE
+// samples across, each level's nodes twice the size of the last. Every frame the tree is walked from the roots,
+// skipping nodes outside the view frustum or hidden behind hills (see SetOcclusion), and a node is drawn at the
+// coarsest level whose distance range it falls in. Every node is the same CDLOD_GRID_SIZE x CDLOD_GRID_SIZE grid mesh
+// stretched over its area, with the heights read from the heightmap texture in the vertex shader, so one mesh and one
+// instanced draw per grid part covers the whole terrain. Towards the end of a level's range its vertices morph onto
+// the next level's grid, so there are no cracks or popping where levels meet.
+//
+// The cost of a frame depends on the number of nodes selected, which depends on the view and the LOD distance rather
+// than the size of the heightmap.
+class CdlodTerrain : public TerrainRenderer
+{
+public:
+    CdlodTerrain() : VAO(0), gridVBO(0), gridIBO(0), instanceVBO(0), heightmapTexture(0), levelCount(0), rows(0), columns(0) {}
+
+    bool Init(const Heightmap& heightmap) override
+    {
+        PROFILE_BEGIN(terrainBuildZone, "Build terrain quadtree");
+        rows = heightmap.Rows;
+        columns = heightmap.Columns;
+
+        // enough levels for one root to cover the map, or as many as the shader allows and several roots
+        levelCount = 1;
+        while (levelCount < CDLOD_MAX_LODS && nodeSize(levelCount - 1) < std::max(rows, columns) - 1)
+            levelCount++;
+        buildBounds(heightmap);
+        std::cout << "Created terrain quadtree with " << levelCount << " levels and " << nodeRows[levelCount - 1] * nodeColumns[levelCount - 1]
+            << " roots" << std::endl;
+
+        for (int level = 0; level < levelCount; level++)
+            ranges[level] = level == levelCount - 1 ? 1e30f : CDLOD_LOD_DISTANCE * (float)(1 << level);
+        PROFILE_END(terrainBuildZone);
+
+        std::ostringstream defines;
+        defines << "#define MAX_LODS " << CDLOD_MAX_LODS << "\n#define GRID_SIZE " << CDLOD_GRID_SIZE << ".0\n";
+        shader.reset(new Shader("terrainCdlod.vs", "heightMapShader.fs", shaderDefines(defines.str())));
+        setUpShader(*shader);
+
+        PROFILE_BEGIN(terrainUploadZone, "Upload terrain buffers");
+        buildGrid();
+        heightmapTexture = createHeightTexture(heightmap, *shader);
+        GpuBytes = (CDLOD_GRID_SIZE + 1) * (CDLOD_GRID_SIZE + 1) * sizeof(glm::vec2) + CDLOD_GRID_SIZE * CDLOD_GRID_SIZE * 6 * sizeof(unsigned short)
+            + heightmap.Heights.size() * sizeof(unsigned short);
+        PROFILE_END(terrainUploadZone);
+
+        for (int level = 0; level < levelCount; level++)
+        {
+            // the top level never morphs, as there's no coarser level to morph into
+            float previous = level == 0 ? 0.0f : ranges[level - 1];
+            glm::vec2 morph = level == levelCount - 1 ? glm::vec2(1e30f, 2e30f)
+                : glm::vec2(previous + (ranges[level] - previous) * CDLOD_MORPH_START, ranges[level]);
+            shader->setVec2("morphRanges[" + std::to_string(level) + "]", morph);
+        }
+        return true;
+    }
+
+    void Draw(const glm::vec3& cameraPos, const glm::mat4& viewProjection) override
+    {
+        {
+            PROFILE_SCOPE("CdlodTerrain::Select");
+            frustum.Extract(viewProjection);
+            for (int part = 0; part < 5; part++)
+                selected[part].clear();
+            int top = levelCount - 1;
+            for (int row = 0; row < nodeRows[top]; row++)
+                for (int column = 0; column < nodeColumns[top]; column++)
+                    selectNode(top, row, column, cameraPos);
+        }
+
+        NodesDrawn = TrianglesDrawn = DrawCalls = 0;
+        instances.clear();
+        for (int part = 0; part < 5; part++)
+            instances.insert(instances.end(), selected[part].begin(), selected[part].end());
+        if (instances.empty())
+            return;
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        // orphaned like the crowd's instance buffer, so this frame's selection doesn't wait on last frame's draws
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(glm::vec4), &instances[0]);
+
+        shader->use();
+        glBindVertexArray(VAO);
+        // whole nodes draw every index, quadrant q of a node the q-th quarter of them
+        const GLsizei quadrantIndices = (GLsizei)(CDLOD_GRID_SIZE * CDLOD_GRID_SIZE / 4 * 6);
+        size_t first = 0;
+        for (int part = 0; part < 5; part++)
+        {
+            size_t count = selected[part].size();
+            if (count == 0)
+                continue;
+            // GL 3.3 has no base instance, so the instance attribute is pointed at this part's nodes instead
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)(first * sizeof(glm::vec4)));
+            GLsizei indexCount = part == 0 ? 4 * quadrantIndices : quadrantIndices;
+            size_t indexOffset = part == 0 ? 0 : (part - 1) * quadrantIndices * sizeof(unsigned short);
+            glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, (void*)indexOffset, (GLsizei)count);
+
+            NodesDrawn += count;
+            TrianglesDrawn += count * indexCount / 3;
+            DrawCalls++;
+            first += count;
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // a heightmap of the same size only needs new bounds and a new height texture
+    bool UpdateHeights(const Heightmap& heightmap) override
+    {
+        if (heightmap.Rows != rows || heightmap.Columns != columns)
+            return TerrainRenderer::UpdateHeights(heightmap);
+        buildBounds(heightmap);
+        updateHeightTexture(heightmap, heightmapTexture, *shader);
+        return true;
+    }
+
+    // an edit only needs the bounds of the nodes over it and its texels
+    bool UpdateRegion(const Heightmap& heightmap, const HeightmapRect& rect) override
+    {
+        PROFILE_SCOPE("CdlodTerrain::UpdateRegion");
+        if (heightmap.Rows != rows || heightmap.Columns != columns)
+            return TerrainRenderer::UpdateHeights(heightmap);
+        updateBounds(heightmap, rect);
+        updateHeightTextureRegion(heightmap, rect, heightmapTexture, *shader);
+        return true;
+    }
+
+    void Destroy() override
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &gridVBO);
+        glDeleteBuffers(1, &gridIBO);
+        glDeleteBuffers(1, &instanceVBO);
+        glDeleteTextures(1, &heightmapTexture);
+    }
+
+private:
+    unsigned int VAO, gridVBO, gridIBO, instanceVBO;
+    unsigned int heightmapTexture;
+    std::unique_ptr<Shader> shader;
+
+    int levelCount;
+    int rows, columns;
+    // nodes along each side of the map at each level, and each node's lowest and highest height, row by row
+    int nodeRows[CDLOD_MAX_LODS];
+    int nodeColumns[CDLOD_MAX_LODS];
+    std::vector<glm::vec2> bounds[CDLOD_MAX_LODS];
+    // distance from the camera within which each level is drawn
+    float ranges[CDLOD_MAX_LODS];
+
+    Frustum frustum;
+    // this frame's nodes as (first row, first column, size in samples, level): whole nodes, then each quadrant
+    std::vector<glm::vec4> selected[5];
+    std::vector<glm::vec4> instances;
+
+    static int nodeSize(int level)
+    {
+        return CDLOD_GRID_SIZE << level;
+    }
+
+    void buildBounds(const Heightmap& heightmap)
+    {
+        for (int level = 0; level < levelCount; level++)
+        {
+            int size = nodeSize(level);
+            nodeRows[level] = std::max((rows - 1 + size - 1) / size, 1);
+            nodeColumns[level] = std::max((columns - 1 + size - 1) / size, 1);
+            bounds[level].resize((size_t)nodeRows[level] * nodeColumns[level]);
+        }
+        updateBounds(heightmap, HeightmapRect(0, 0, rows - 1, columns - 1));
+    }
+
+    // the bounds of every node over the samples in rect, from level 0 up. A sample on the edge between two nodes
+    // is in both
+    void updateBounds(const Heightmap& heightmap, const HeightmapRect& rect)
+    {
+        int size = nodeSize(0);
+        glm::ivec2 first(std::max(rect.FirstRow - 1, 0) / size, std::max(rect.FirstColumn - 1, 0) / size);
+        glm::ivec2 last(rect.LastRow / size, rect.LastColumn / size);
+        for (int level = 0; level < levelCount; level++, first /= 2, last /= 2)
+        {
+            size = nodeSize(level);
+            for (int row = first.x; row <= std::min(last.x, nodeRows[level] - 1); row++)
+            {
+                for (int column = first.y; column <= std::min(last.y, nodeColumns[level] - 1); column++)
+                {
+                    glm::vec2& bound = bounds[level][(size_t)row * nodeColumns[level] + column];
+                    bound = glm::vec2(1e30f, -1e30f);
+                    if (level == 0)
+                    {
+                        heightmap.MinMax(row * size, column * size, (row + 1) * size, (column + 1) * size, bound.x, bound.y);
+                        continue;
+                    }
+                    // a node's range is its children's
+                    for (int child = 0; child < 4; child++)
+                    {
+                        int childRow = row * 2 + child / 2, childColumn = column * 2 + child % 2;
+                        if (childRow >= nodeRows[level - 1] || childColumn >= nodeColumns[level - 1])
+                            continue;
+                        const glm::vec2& childBound = bounds[level - 1][(size_t)childRow * nodeColumns[level - 1] + childColumn];
+                        bound.x = std::min(bound.x, childBound.x);
+                        bound.y = std::max(bound.y, childBound.y);
+                    }
+                }
+            }
+        }
+    }
+
+    // one grid of (CDLOD_GRID_SIZE + 1)^2 vertices at positions in [0, 1]^2, indexed a quadrant at a time so each
+    // quarter of the node can be drawn on its own
+    void buildGrid()
+    {
+        const int verticesPerSide = CDLOD_GRID_SIZE + 1;
+        std::vector<glm::vec2> vertices;
+        for (int row = 0; row < verticesPerSide; row++)
+            for (int column = 0; column < verticesPerSide; column++)
+                vertices.push_back(glm::vec2((float)row / CDLOD_GRID_SIZE, (float)column / CDLOD_GRID_SIZE));
+
+        std::vector<unsigned short> indices;
+        const int half = CDLOD_GRID_SIZE / 2;
+        for (int quadrant = 0; quadrant < 4; quadrant++)
+        {
+            int firstRow = (quadrant / 2) * half, firstColumn = (quadrant % 2) * half;
+            for (int row = firstRow; row < firstRow + half; row++)
+            {
+                for (int column = firstColumn; column < firstColumn + half; column++)
+                {
+                    unsigned short corner = (unsigned short)(row * verticesPerSide + column);
+                    indices.push_back(corner);
+                    indices.push_back((unsigned short)(corner + verticesPerSide));
+                    indices.push_back((unsigned short)(corner + 1));
+                    indices.push_back((unsigned short)(corner + 1));
+                    indices.push_back((unsigned short)(corner + verticesPerSide));
+                    indices.push_back((unsigned short)(corner + verticesPerSide + 1));
+                }
+            }
+        }
+
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+
+        glGenBuffers(1, &gridVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        glGenBuffers(1, &gridIBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridIBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
+
+        // the node each instance draws, pointed at the right part of the buffer before each draw
+        glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // the world-space box around a node, cut off at the edge of the map
+    void nodeBox(int level, int row, int column, glm::vec3& low, glm::vec3& high) const
+    {
+        int size = nodeSize(level);
+        const glm::vec2& bound = bounds[level][(size_t)row * nodeColumns[level] + column];
+        low = glm::vec3((row * size - rows / 2.0f) * HEIGHTMAP_SPACING, bound.x, (column * size - columns / 2.0f) * HEIGHTMAP_SPACING);
+        high = glm::vec3((std::min((row + 1) * size, rows - 1) - rows / 2.0f) * HEIGHTMAP_SPACING, bound.y,
+            (std::min((column + 1) * size, columns - 1) - columns / 2.0f) * HEIGHTMAP_SPACING);
+    }
+
+    // Adds the node, or the parts of it that its children don't cover, to this frame's selection. Returns false if
+    // the node is beyond its level's range, so the caller has to draw the area at its own level
+    bool selectNode(int level, int row, int column, const glm::vec3& cameraPos)
+    {
+        glm::vec3 low, high;
+        nodeBox(level, row, column, low, high);
+        if (!sphereIntersectsBox(cameraPos, ranges[level], low, high))
+            return false;
+        // out of view, but handled: nothing needs drawing
+        if (!frustum.IntersectsBox(low, high) || (occlusion && occlusion->IsOccluded(low, high)))
+            return true;
+
+        int size = nodeSize(level);
+        glm::vec4 node((float)(row * size), (float)(column * size), (float)size, (float)level);
+        if (level == 0 || !sphereIntersectsBox(cameraPos, ranges[level - 1], low, high))
+        {
+            selected[0].push_back(node);
+            return true;
+        }
+
+        for (int child = 0; child < 4; child++)
+        {
+            int childRow = row * 2 + child / 2, childColumn = column * 2 + child % 2;
+            // children past the edge of the map have nothing to draw
+            if (childRow >= nodeRows[level - 1] || childColumn >= nodeColumns[level - 1])
+                continue;
+            if (!selectNode(level - 1, childRow, childColumn, cameraPos))
+                selected[1 + child].push_back(node);
+        }
+        return true;
+    }
+};
+#endif
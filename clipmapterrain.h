@@ -0,0 +1,480 @@
+#ifndef CLIPMAP_TERRAIN_H
+#define CLIPMAP_TERRAIN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "terrain.h"
+#include "frustum.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+// Most levels the clipmap can have, also the size of the shader's level centre array. Level 11 spans
+// (CLIPMAP_LEVEL_VERTICES - 1) * 2^11 = 258048 samples
+#define CLIPMAP_MAX_LEVELS 12
+
+// vertices along each side of a block, and of a whole level (four blocks and the two-quad gap in the middle)
+const int CLIPMAP_BLOCK_VERTICES = 32;
+const int CLIPMAP_LEVEL_VERTICES = 4 * CLIPMAP_BLOCK_VERTICES - 1;
+// texels along each side of a level's texture, a power of two so wrapping is a mask
+const int CLIPMAP_TEXTURE_SIZE = 128;
+// width in level units of the band at the outside of a level whose heights blend into the next level's
+const float CLIPMAP_TRANSITION_WIDTH = CLIPMAP_LEVEL_VERTICES / 10.0f;
+
+// Geometry clipmaps (Asirvatham and Hoppe, "Terrain Rendering Using GPU-Based Geometry Clipmaps", GPU Gems 2). The
+// terrain around the camera is a stack of nested square grids of CLIPMAP_LEVEL_VERTICES vertices, level l spaced
+// 2^l samples apart, so each level covers twice the area of the one inside it at half the resolution. Each level
+// keeps the heights it covers in a layer of a CLIPMAP_TEXTURE_SIZE texture array, addressed toroidally: as the
+// camera moves a level slides along its grid in steps of two, and only the rows and columns that came into view are
+// uploaded, wrapping round the layer, instead of the whole level.
+//
+// The geometry is a few fixed meshes placed with instancing: each level is a ring of 12 blocks and 4 fix-ups around
+// the level inside it, an L-shaped trim fills the one-unit gap left by the finer level being off-centre, and the
+// finest level's hole is filled by a single interior mesh. Towards its outside edge a level's heights blend into
+// those of the next level, so at the edge its vertices lie on the coarser level's triangles and there are no cracks.
+//
+// Every frame draws the same handful of instanced meshes whatever the size of the heightmap, and the texture updates
+// depend only on how far the camera moved, so frame time stays the same over any extent of terrain.
+class ClipmapTerrain : public TerrainRenderer
+{
+public:
+    ClipmapTerrain() : VAO(0), meshVBO(0), meshIBO(0), instanceVBO(0), clipmapTexture(0), levelCount(0), rows(0), columns(0),
+        lowest(0.0f), highest(0.0f)
+    {
+        for (int level = 0; level < CLIPMAP_MAX_LEVELS; level++)
+            levelValid[level] = false;
+    }
+
+    bool Init(const Heightmap& heightmap) override
+    {
+        rows = heightmap.Rows;
+        columns = heightmap.Columns;
+
+        // enough levels for the outermost to cover the whole map from anywhere on it
+        levelCount = 1;
+        while (levelCount < CLIPMAP_MAX_LEVELS && (CLIPMAP_LEVEL_VERTICES - 1) << (levelCount - 1) < 2 * std::max(rows, columns))
+            levelCount++;
+        quantiseHeights(heightmap);
+
+        std::ostringstream defines;
+        defines << "#define MAX_LEVELS " << CLIPMAP_MAX_LEVELS << "\n#define TEXTURE_SIZE " << CLIPMAP_TEXTURE_SIZE
+            << "\n#define HALF_EXTENT " << (CLIPMAP_LEVEL_VERTICES - 1) / 2 << ".0\n#define TRANSITION_WIDTH " << CLIPMAP_TRANSITION_WIDTH << "\n";
+        shader.reset(new Shader("terrainClipmap.vs", "heightMapShader.fs", shaderDefines(defines.str())));
+        setUpShader(*shader);
+        shader->setVec2("heightRange", glm::vec2(lowest, highest));
+        shader->setVec2("heightmapSize", glm::vec2((float)rows, (float)columns));
+        shader->setFloat("spacing", HEIGHTMAP_SPACING);
+        shader->setInt("levelCount", levelCount);
+        levelCentres = shader->uniform<glm::vec2>("levelCentres[0]");
+
+        PROFILE_BEGIN(terrainUploadZone, "Upload terrain buffers");
+        buildMeshes();
+        glGenTextures(1, &clipmapTexture);
+        glActiveTexture(GL_TEXTURE0 + HEIGHTMAP_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, clipmapTexture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R16, CLIPMAP_TEXTURE_SIZE, CLIPMAP_TEXTURE_SIZE, levelCount, 0, GL_RED, GL_UNSIGNED_SHORT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glActiveTexture(GL_TEXTURE0);
+        GpuBytes = meshBytes + (size_t)CLIPMAP_TEXTURE_SIZE * CLIPMAP_TEXTURE_SIZE * levelCount * sizeof(unsigned short);
+        PROFILE_END(terrainUploadZone);
+
+        for (int level = 0; level < CLIPMAP_MAX_LEVELS; level++)
+            levelValid[level] = false;
+        std::cout << "Created clipmap of " << levelCount << " levels of " << CLIPMAP_LEVEL_VERTICES << " x " << CLIPMAP_LEVEL_VERTICES << " vertices" << std::endl;
+        return true;
+    }
+
+    void Draw(const glm::vec3& cameraPos, const glm::mat4& viewProjection) override
+    {
+        {
+            PROFILE_SCOPE("ClipmapTerrain::Update");
+            float cameraRow = cameraPos.x / HEIGHTMAP_SPACING + rows / 2.0f, cameraColumn = cameraPos.z / HEIGHTMAP_SPACING + columns / 2.0f;
+            for (int level = 0; level < levelCount; level++)
+            {
+                // each level moves in steps of two of its own units, so its vertices stay on the next level's grid
+                float step = (float)(2 << level);
+                glm::ivec2 origin(2 * (int)std::floor(cameraRow / step) - 2 * CLIPMAP_BLOCK_VERTICES + 2,
+                    2 * (int)std::floor(cameraColumn / step) - 2 * CLIPMAP_BLOCK_VERTICES + 2);
+                updateLevel(level, origin);
+                centres[level] = glm::vec2(origin) + (float)((CLIPMAP_LEVEL_VERTICES - 1) / 2);
+            }
+        }
+
+        {
+            PROFILE_SCOPE("ClipmapTerrain::Select");
+            frustum.Extract(viewProjection);
+            for (int mesh = 0; mesh < MESH_COUNT; mesh++)
+                selected[mesh].clear();
+            selectInstances();
+        }
+
+        NodesDrawn = TrianglesDrawn = DrawCalls = 0;
+        instances.clear();
+        for (int mesh = 0; mesh < MESH_COUNT; mesh++)
+            instances.insert(instances.end(), selected[mesh].begin(), selected[mesh].end());
+        if (instances.empty())
+            return;
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        // orphaned like the CDLOD instance buffer, so this frame's instances don't wait on last frame's draws
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(ClipmapInstance), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(ClipmapInstance), &instances[0]);
+
+        shader->use();
+        glUniform2fv(levelCentres.Location, levelCount, &centres[0].x);
+        glBindVertexArray(VAO);
+        size_t first = 0;
+        for (int mesh = 0; mesh < MESH_COUNT; mesh++)
+        {
+            size_t count = selected[mesh].size();
+            if (count == 0)
+                continue;
+            // GL 3.3 has no base instance, so the instance attributes are pointed at this mesh's instances instead
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ClipmapInstance), (void*)(first * sizeof(ClipmapInstance)));
+            glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(ClipmapInstance), (void*)(first * sizeof(ClipmapInstance) + sizeof(glm::vec4)));
+            glDrawElementsInstanced(GL_TRIANGLES, meshIndexCounts[mesh], GL_UNSIGNED_SHORT, (void*)(meshFirstIndices[mesh] * sizeof(unsigned short)), (GLsizei)count);
+
+            NodesDrawn += count;
+            TrianglesDrawn += count * meshIndexCounts[mesh] / 3;
+            DrawCalls++;
+            first += count;
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // a heightmap of the same size only needs its heights quantised again, and every level uploaded on the next Draw
+    bool UpdateHeights(const Heightmap& heightmap) override
+    {
+        if (heightmap.Rows != rows || heightmap.Columns != columns)
+            return TerrainRenderer::UpdateHeights(heightmap);
+        quantiseHeights(heightmap);
+        shader->use();
+        shader->setVec2("heightRange", glm::vec2(lowest, highest));
+        for (int level = 0; level < CLIPMAP_MAX_LEVELS; level++)
+            levelValid[level] = false;
+        return true;
+    }
+
+    // An edit within the height range only needs its samples quantised again. Every level is uploaded again on the
+    // next Draw, which costs the same as a camera jump whatever the size of the map
+    bool UpdateRegion(const Heightmap& heightmap, const HeightmapRect& rect) override
+    {
+        PROFILE_SCOPE("ClipmapTerrain::UpdateRegion");
+        float low, high;
+        heightmap.MinMax(rect.FirstRow, rect.FirstColumn, rect.LastRow, rect.LastColumn, low, high);
+        if (heightmap.Rows != rows || heightmap.Columns != columns)
+            return UpdateHeights(heightmap);
+        for (int level = 0; level < CLIPMAP_MAX_LEVELS; level++)
+            levelValid[level] = false;
+        // past the range every sample needs quantising again, leaving room for the edits after
+        if (low < lowest || high > highest)
+        {
+            quantiseHeights(heightmap, HEIGHTMAP_EDIT_HEADROOM);
+            shader->use();
+            shader->setVec2("heightRange", glm::vec2(lowest, highest));
+            return true;
+        }
+        float step = (highest - lowest) / 65535.0f;
+        for (int row = rect.FirstRow; row <= rect.LastRow; row++)
+        {
+            for (int column = rect.FirstColumn; column <= rect.LastColumn; column++)
+            {
+                size_t i = (size_t)row * columns + column;
+                texels[i] = (unsigned short)((heightmap.Heights[i] - lowest) / step + 0.5f);
+            }
+        }
+        return true;
+    }
+
+    void Destroy() override
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &meshVBO);
+        glDeleteBuffers(1, &meshIBO);
+        glDeleteBuffers(1, &instanceVBO);
+        glDeleteTextures(1, &clipmapTexture);
+    }
+
+private:
+    enum Mesh {
+        MESH_BLOCK,             // CLIPMAP_BLOCK_VERTICES square, 12 to a ring
+        MESH_ROW_FIXUP,         // 3 x CLIPMAP_BLOCK_VERTICES, filling the gap between blocks above and below the centre
+        MESH_COLUMN_FIXUP,      // CLIPMAP_BLOCK_VERTICES x 3, the same either side of the centre
+        MESH_TRIM,              // L-shaped strip, one unit wide, between a level's hole and the level inside it
+        MESH_INTERIOR,          // fills the hole in the middle of the finest level
+        MESH_COUNT
+    };
+
+    // a mesh placed at (row, column) sample offset with its local coordinates multiplied by scale, which is negative
+    // along an axis to mirror it, and the level whose heights it reads
+    struct ClipmapInstance
+    {
+        glm::vec4 offsetScale;
+        float level;
+    };
+
+    unsigned int VAO, meshVBO, meshIBO, instanceVBO;
+    unsigned int clipmapTexture;
+    std::unique_ptr<Shader> shader;
+    Uniform<glm::vec2> levelCentres;
+    size_t meshBytes;
+    GLsizei meshIndexCounts[MESH_COUNT];
+    size_t meshFirstIndices[MESH_COUNT];
+    // each mesh's extent in local units, for culling
+    glm::vec2 meshSizes[MESH_COUNT];
+
+    int levelCount;
+    int rows, columns;
+    // the map's heights quantised as in the texture, and the heights 0 and 65535 stand for
+    std::vector<unsigned short> texels;
+    float lowest, highest;
+
+    // the first (row, column) of each level in its own units, 2^level samples, and whether its texture layer holds it
+    glm::ivec2 origins[CLIPMAP_MAX_LEVELS];
+    bool levelValid[CLIPMAP_MAX_LEVELS];
+    glm::vec2 centres[CLIPMAP_MAX_LEVELS];
+    std::vector<unsigned short> uploadTexels;
+
+    Frustum frustum;
+    std::vector<ClipmapInstance> selected[MESH_COUNT];
+    std::vector<ClipmapInstance> instances;
+
+    // headroom widens the range as Heightmap::UpdateTexture's does
+    void quantiseHeights(const Heightmap& heightmap, float headroom = 0.0f)
+    {
+        heightmap.MinMax(0, 0, rows - 1, columns - 1, lowest, highest);
+        float margin = (highest - lowest) * headroom;
+        lowest -= margin;
+        highest += margin;
+        float step = highest > lowest ? (highest - lowest) / 65535.0f : 1.0f;
+        texels.resize(heightmap.Heights.size());
+        for (size_t i = 0; i < texels.size(); i++)
+            texels[i] = (unsigned short)((heightmap.Heights[i] - lowest) / step + 0.5f);
+        if (highest <= lowest)
+            highest = lowest + 65535.0f;
+        CpuBytes = texels.size() * sizeof(unsigned short);
+    }
+
+    // Moves a level to a new origin, uploading only the rows and columns it didn't cover before. A level that hasn't
+    // been uploaded, or moved further than its own size, is uploaded whole
+    void updateLevel(int level, const glm::ivec2& origin)
+    {
+        const int n = CLIPMAP_LEVEL_VERTICES;
+        glm::ivec2 old = origins[level];
+        origins[level] = origin;
+        if (!levelValid[level] || std::abs(origin.x - old.x) >= n || std::abs(origin.y - old.y) >= n)
+        {
+            levelValid[level] = true;
+            uploadRegion(level, origin.x, origin.x + n, origin.y, origin.y + n);
+            return;
+        }
+        if (origin.x > old.x)
+            uploadRegion(level, old.x + n, origin.x + n, origin.y, origin.y + n);
+        else if (origin.x < old.x)
+            uploadRegion(level, origin.x, old.x, origin.y, origin.y + n);
+        if (origin.y > old.y)
+            uploadRegion(level, origin.x, origin.x + n, old.y + n, origin.y + n);
+        else if (origin.y < old.y)
+            uploadRegion(level, origin.x, origin.x + n, origin.y, old.y);
+    }
+
+    static int wrap(int coordinate)
+    {
+        return coordinate & (CLIPMAP_TEXTURE_SIZE - 1);
+    }
+
+    // uploads rows [row0, row1) and columns [column0, column1) of a level, in its units, split where they wrap
+    // round the edge of the layer
+    void uploadRegion(int level, int row0, int row1, int column0, int column1)
+    {
+        glActiveTexture(GL_TEXTURE0 + HEIGHTMAP_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, clipmapTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        for (int rowStart = row0; rowStart < row1;)
+        {
+            int rowEnd = std::min(row1, rowStart + CLIPMAP_TEXTURE_SIZE - wrap(rowStart));
+            for (int columnStart = column0; columnStart < column1;)
+            {
+                int columnEnd = std::min(column1, columnStart + CLIPMAP_TEXTURE_SIZE - wrap(columnStart));
+                int width = columnEnd - columnStart, height = rowEnd - rowStart;
+                uploadTexels.resize((size_t)width * height);
+                for (int row = 0; row < height; row++)
+                {
+                    // a level point-samples the map, so its vertices have the same heights as the finer levels'
+                    int sampleRow = std::min(std::max((rowStart + row) * (1 << level), 0), rows - 1);
+                    for (int column = 0; column < width; column++)
+                    {
+                        int sampleColumn = std::min(std::max((columnStart + column) * (1 << level), 0), columns - 1);
+                        uploadTexels[(size_t)row * width + column] = texels[(size_t)sampleRow * columns + sampleColumn];
+                    }
+                }
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, wrap(columnStart), wrap(rowStart), level, width, height, 1, GL_RED, GL_UNSIGNED_SHORT, &uploadTexels[0]);
+                columnStart = columnEnd;
+            }
+            rowStart = rowEnd;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // Adds a mesh instance if any of it is on the map and in view. The box takes the whole map's height range, which
+    // is enough to drop the parts of the rings behind the camera
+    void addInstance(Mesh mesh, int level, const glm::vec2& offset, const glm::vec2& scale)
+    {
+        glm::vec2 end = offset + meshSizes[mesh] * scale;
+        glm::vec2 low = glm::min(offset, end), high = glm::max(offset, end);
+        if (high.x <= 0.0f || high.y <= 0.0f || low.x >= rows - 1 || low.y >= columns - 1)
+            return;
+        low = glm::max(low, glm::vec2(0.0f));
+        high = glm::min(high, glm::vec2((float)(rows - 1), (float)(columns - 1)));
+        glm::vec3 boxLow((low.x - rows / 2.0f) * HEIGHTMAP_SPACING, lowest, (low.y - columns / 2.0f) * HEIGHTMAP_SPACING);
+        glm::vec3 boxHigh((high.x - rows / 2.0f) * HEIGHTMAP_SPACING, highest, (high.y - columns / 2.0f) * HEIGHTMAP_SPACING);
+        if (!frustum.IntersectsBox(boxLow, boxHigh))
+            return;
+        ClipmapInstance instance;
+        instance.offsetScale = glm::vec4(offset, scale);
+        instance.level = (float)level;
+        selected[mesh].push_back(instance);
+    }
+
+    void selectInstances()
+    {
+        const int m = CLIPMAP_BLOCK_VERTICES;
+        // where blocks start along each side of a level, in its units; the two units from 2m - 2 are the fix-ups
+        const int blockStarts[4] = { 0, m - 1, 2 * m, 3 * m - 1 };
+        for (int level = 0; level < levelCount; level++)
+        {
+            float unit = (float)(1 << level);
+            glm::vec2 origin = glm::vec2(origins[level]) * unit;
+            for (int i = 0; i < 4; i++)
+            {
+                for (int j = 0; j < 4; j++)
+                {
+                    // the middle four blocks are where the finer level goes
+                    if ((i == 1 || i == 2) && (j == 1 || j == 2))
+                        continue;
+                    addInstance(MESH_BLOCK, level, origin + glm::vec2((float)blockStarts[i], (float)blockStarts[j]) * unit, glm::vec2(unit));
+                }
+            }
+            for (int k = 0; k < 4; k += 3)
+            {
+                addInstance(MESH_ROW_FIXUP, level, origin + glm::vec2((float)(2 * m - 2), (float)blockStarts[k]) * unit, glm::vec2(unit));
+                addInstance(MESH_COLUMN_FIXUP, level, origin + glm::vec2((float)blockStarts[k], (float)(2 * m - 2)) * unit, glm::vec2(unit));
+            }
+
+            if (level == 0)
+            {
+                addInstance(MESH_INTERIOR, level, origin + glm::vec2((float)(m - 1)) * unit, glm::vec2(unit));
+                continue;
+            }
+            // The finer level is two of its units (one of this level's) smaller than the hole, so it sits against
+            // one side of it along each axis. The trim covers the other side: it is built against the low sides
+            // and mirrored to the high side where the finer level sits low
+            glm::ivec2 hole = origins[level] + (m - 1);
+            glm::vec2 offset, scale;
+            for (int axis = 0; axis < 2; axis++)
+            {
+                bool finerAtLow = origins[level - 1][axis] == 2 * hole[axis];
+                offset[axis] = (float)(finerAtLow ? hole[axis] + 2 * m : hole[axis]) * unit;
+                scale[axis] = finerAtLow ? -unit : unit;
+            }
+            addInstance(MESH_TRIM, level, offset, scale);
+        }
+    }
+
+    // appends a grid of rows x columns vertices at local (row, column) offset, and its triangles
+    static void addGrid(std::vector<glm::vec2>& vertices, std::vector<unsigned short>& indices, int row0, int column0, int gridRows, int gridColumns)
+    {
+        unsigned short first = (unsigned short)vertices.size();
+        for (int row = 0; row < gridRows; row++)
+            for (int column = 0; column < gridColumns; column++)
+                vertices.push_back(glm::vec2((float)(row0 + row), (float)(column0 + column)));
+        for (int row = 0; row < gridRows - 1; row++)
+        {
+            for (int column = 0; column < gridColumns - 1; column++)
+            {
+                unsigned short corner = (unsigned short)(first + row * gridColumns + column);
+                indices.push_back(corner);
+                indices.push_back((unsigned short)(corner + gridColumns));
+                indices.push_back((unsigned short)(corner + 1));
+                indices.push_back((unsigned short)(corner + 1));
+                indices.push_back((unsigned short)(corner + gridColumns));
+                indices.push_back((unsigned short)(corner + gridColumns + 1));
+            }
+        }
+    }
+
+    // every mesh in one vertex and index buffer, in local (row, column) units
+    void buildMeshes()
+    {
+        const int m = CLIPMAP_BLOCK_VERTICES;
+        std::vector<glm::vec2> vertices;
+        std::vector<unsigned short> indices;
+        for (int mesh = 0; mesh < MESH_COUNT; mesh++)
+        {
+            meshFirstIndices[mesh] = indices.size();
+            switch (mesh)
+            {
+            case MESH_BLOCK:
+                addGrid(vertices, indices, 0, 0, m, m);
+                meshSizes[mesh] = glm::vec2((float)(m - 1));
+                break;
+            case MESH_ROW_FIXUP:
+                addGrid(vertices, indices, 0, 0, 3, m);
+                meshSizes[mesh] = glm::vec2(2.0f, (float)(m - 1));
+                break;
+            case MESH_COLUMN_FIXUP:
+                addGrid(vertices, indices, 0, 0, m, 3);
+                meshSizes[mesh] = glm::vec2((float)(m - 1), 2.0f);
+                break;
+            case MESH_TRIM:
+                // along the low row side the whole 2m of the hole, then the low column side less the shared corner
+                addGrid(vertices, indices, 0, 0, 2, 2 * m + 1);
+                addGrid(vertices, indices, 1, 0, 2 * m, 2);
+                meshSizes[mesh] = glm::vec2((float)(2 * m));
+                break;
+            default:
+                addGrid(vertices, indices, 0, 0, 2 * m + 1, 2 * m + 1);
+                meshSizes[mesh] = glm::vec2((float)(2 * m));
+                break;
+            }
+            meshIndexCounts[mesh] = (GLsizei)(indices.size() - meshFirstIndices[mesh]);
+        }
+
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+
+        glGenBuffers(1, &meshVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, meshVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        glGenBuffers(1, &meshIBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
+
+        // the placement of each instance, pointed at the right part of the buffer before each draw
+        glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ClipmapInstance), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(ClipmapInstance), (void*)sizeof(glm::vec4));
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        meshBytes = vertices.size() * sizeof(glm::vec2) + indices.size() * sizeof(unsigned short);
+    }
+};
+#endif
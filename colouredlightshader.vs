@@ -2,8 +2,15 @@
 layout (location = 0) in vec3 aPos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// per-frame camera state, see uniformblocks.h
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 terrainProjection;
+    vec3 cameraPos;
+};
 
 // adapted from https://learnopengl.com/Lighting/Basic-Lighting
 
@@ -0,0 +1,201 @@
+#ifndef CROWD_H
+#define CROWD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "mesh.h"
+#include "model.h"
+#include "profiler.h"
+#include "terrainquery.h"
+#include "horizonculler.h"
+
+#include <cmath>
+#include <vector>
+
+// a generous world-space box around a snowman and its arms, relative to its position on the ground
+const glm::vec3 SNOWMAN_BOUNDS_LOW(-0.6f, -0.1f, -0.6f);
+const glm::vec3 SNOWMAN_BOUNDS_HIGH(0.6f, 1.0f, 0.6f);
+
+// The crowd of walking snow-people. Positions are in the snowmen's own units, which the draw code scales by 0.2.
+// For instanced drawing every snowman's body and both arms get an InstanceData entry in one buffer: bodies first,
+// then left arms, then right arms, so the body model draws instances [0, N) and the arm model [N, 3N). Only the
+// snowmen Cull left visible are uploaded, packed at the start of each part: the first VisibleCount bodies, then
+// from N the left and right arms of those, so the arm model draws 2 * VisibleCount instances from N.
+class SnowmanCrowd
+{
+public:
+    std::vector<glm::vec3> StartPositions;
+    std::vector<glm::vec3> Positions;
+    std::vector<int> Materials;
+    // whether each snowman may be seen this frame, and how many may
+    std::vector<unsigned char> Visible;
+    size_t VisibleCount;
+    unsigned int InstanceVBO;
+
+    SnowmanCrowd() : VisibleCount(0), InstanceVBO(0) {}
+
+    size_t Count() const
+    {
+        return Positions.size();
+    }
+
+    // count snowmen. The first stand at the given start positions, the rest on square rings of a grid around them.
+    // Snowmen take the given material indices in turn
+    void Populate(const glm::vec3* startPositions, int startCount, int count, const std::vector<int>& materials)
+    {
+        StartPositions.clear();
+        for (int i = 0; i < startCount && i < count; i++)
+            StartPositions.push_back(startPositions[i]);
+
+        // each snowman walks a 2x2 square, so 4 units apart leaves room between them
+        const float spacing = 4.0f;
+        glm::vec3 low(0.0f), high(0.0f);
+        for (int i = 0; i < startCount; i++)
+        {
+            low = glm::min(low, startPositions[i]);
+            high = glm::max(high, startPositions[i]);
+        }
+        for (int ring = 1; (int)StartPositions.size() < count; ring++)
+        {
+            for (int x = -ring; x <= ring && (int)StartPositions.size() < count; x++)
+            {
+                // only the cells on the edge of the ring, the inside was filled by earlier rings
+                int zStep = (x == -ring || x == ring) ? 1 : 2 * ring;
+                for (int z = -ring; z <= ring && (int)StartPositions.size() < count; z += zStep)
+                {
+                    glm::vec3 position(x * spacing, 0.0f, z * spacing);
+                    // leave the area of the original crowd (and its walking squares) to them
+                    if (position.x >= low.x - spacing && position.x <= high.x + spacing && position.z >= low.z - spacing && position.z <= high.z + spacing)
+                        continue;
+                    StartPositions.push_back(position);
+                }
+            }
+        }
+        Positions = StartPositions;
+        Visible.assign(Positions.size(), 1);
+        VisibleCount = Positions.size();
+
+        Materials.resize(Positions.size());
+        for (size_t i = 0; i < Materials.size(); i++)
+            Materials[i] = materials[i % materials.size()];
+    }
+
+    // moves every snowman one step round its square
+    void Walk()
+    {
+        PROFILE_SCOPE("SnowmanCrowd::Walk");
+        for (size_t i = 0; i < Positions.size(); i++)
+        {
+            glm::vec3& position = Positions[i];
+            const glm::vec3& start = StartPositions[i];
+            if (position.x < (0.01 + start.x) && position.z < (1.99 + start.z)) position += glm::vec3(0.0f, 0.0f, 0.001f);
+            else if (position.x < (1.99 + start.x) && position.z > (1.99 + start.z)) position += glm::vec3(0.001f, 0.0f, 0.0f);
+            else if (position.x > (1.99 + start.x) && position.z > (0.01 + start.z)) position += glm::vec3(0.0f, 0.0f, -0.001f);
+            else position += glm::vec3(-0.001f, 0.0f, 0.0f);
+        }
+    }
+
+    // stands every snowman on the terrain, all in one batch query. Positions are in the snowmen's units, a fifth of
+    // the terrain's
+    void Ground(const TerrainQuery& terrain)
+    {
+        PROFILE_SCOPE("SnowmanCrowd::Ground");
+        size_t count = Count();
+        if (count == 0)
+            return;
+        groundX.resize(count);
+        groundZ.resize(count);
+        groundHeights.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            groundX[i] = Positions[i].x * 0.2f;
+            groundZ[i] = Positions[i].z * 0.2f;
+        }
+        terrain.Query(&groundX[0], &groundZ[0], count, &groundHeights[0], NULL);
+        for (size_t i = 0; i < count; i++)
+            Positions[i].y = groundHeights[i] / 0.2f;
+    }
+
+    // marks the snowmen the terrain hides from the camera the culler was built for, or none without a culler
+    void Cull(const HorizonCuller* culler)
+    {
+        PROFILE_SCOPE("SnowmanCrowd::Cull");
+        VisibleCount = 0;
+        for (size_t i = 0; i < Count(); i++)
+        {
+            glm::vec3 position = Positions[i] * 0.2f;
+            Visible[i] = !culler || !culler->IsOccluded(position + SNOWMAN_BOUNDS_LOW, position + SNOWMAN_BOUNDS_HIGH);
+            VisibleCount += Visible[i];
+        }
+    }
+
+    // creates the instance buffer and points the body and arm models at their parts of it
+    void InitInstances(Model& body, Model& arm)
+    {
+        glGenBuffers(1, &InstanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, InstanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, 3 * Count() * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        body.SetInstanceBuffer(InstanceVBO, 0);
+        arm.SetInstanceBuffer(InstanceVBO, Count());
+        instances.resize(3 * Count());
+    }
+
+    // fills the instance buffer with this frame's transforms of the visible snowmen. They match the ones the
+    // per-snowman path in main.cpp builds, but the parts that are the same for every snowman are worked out once
+    void UploadInstances(float armSwingDegrees, float directionRadians)
+    {
+        PROFILE_SCOPE("SnowmanCrowd::UploadInstances");
+        size_t count = Count();
+        if (VisibleCount == 0)
+            return;
+        glm::mat4 direction = glm::rotate(glm::mat4(1.0f), directionRadians, glm::vec3(0.0, 1.0, 0.0));
+        glm::mat4 body = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f, 0.2f, 0.2f)) * direction;
+        glm::mat4 swing = glm::rotate(glm::mat4(1.0f), glm::radians(armSwingDegrees), glm::vec3(1.0, 0.0, 0.0));
+        glm::mat4 leftArm = swing * glm::rotate(glm::mat4(1.0f), glm::radians(45.0f), glm::vec3(0.0, 0.0, 1.0)) * direction;
+        glm::mat4 rightArm = swing * glm::rotate(glm::mat4(1.0f), glm::radians(-45.0f), glm::vec3(0.0, 0.0, 1.0)) * direction;
+
+        size_t visible = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!Visible[i])
+                continue;
+            glm::vec3 position = Positions[i] * 0.2f;
+            InstanceData& bodyInstance = instances[visible];
+            bodyInstance.Model = body;
+            bodyInstance.Model[3] = glm::vec4(position + glm::vec3(0.0f, 0.04f, 0.0f), 1.0f);
+            bodyInstance.Material = Materials[i];
+
+            InstanceData& leftInstance = instances[count + visible];
+            leftInstance.Model = leftArm;
+            leftInstance.Model[3] = glm::vec4(position + glm::vec3(0.3f, 0.5f, 0.0f), 1.0f);
+            leftInstance.Material = Materials[i];
+
+            InstanceData& rightInstance = instances[count + VisibleCount + visible];
+            rightInstance.Model = rightArm;
+            rightInstance.Model[3] = glm::vec4(position + glm::vec3(-0.3f, 0.5f, 0.0f), 1.0f);
+            rightInstance.Material = Materials[i];
+            visible++;
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, InstanceVBO);
+        // orphaning the old storage lets the driver hand out fresh memory instead of waiting for last frame's draws
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), &instances[0]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void Destroy()
+    {
+        glDeleteBuffers(1, &InstanceVBO);
+        InstanceVBO = 0;
+    }
+
+private:
+    std::vector<InstanceData> instances;
+    // world x and z of each snowman and the ground height there, kept between frames
+    std::vector<float> groundX, groundZ, groundHeights;
+};
+#endif
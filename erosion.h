@@ -0,0 +1,334 @@
+#ifndef EROSION_H
+#define EROSION_H
+
+#include "heightmap.h"
+#include "profiler.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// droplets are started a tile of samples at a time, and the map is covered this many times with the tile grid moved
+// along a little each time, so no tile edge lasts
+const int EROSION_TILE_SIZE = 128;
+const int EROSION_PASSES = 4;
+// radius in samples a droplet erodes the ground over, and the most steps it takes
+const int EROSION_RADIUS = 3;
+const int EROSION_LIFETIME = 30;
+// how far past its tile a droplet may go, so the samples two tiles run at once can touch never meet
+const int EROSION_MARGIN = EROSION_TILE_SIZE / 2 - EROSION_RADIUS - 1;
+// droplet physics, on heights scaled to 0 to 1 over the map's range so they work the same for any height scale
+const float EROSION_INERTIA = 0.05f;
+const float EROSION_CAPACITY = 4.0f;
+const float EROSION_MIN_CAPACITY = 0.01f;
+const float EROSION_ERODE_SPEED = 0.3f;
+const float EROSION_DEPOSIT_SPEED = 0.3f;
+const float EROSION_EVAPORATION = 0.01f;
+const float EROSION_GRAVITY = 4.0f;
+// thermal erosion moves material off slopes steeper than this rise per world unit, this fraction of the excess a step
+const float EROSION_TALUS = 1.0f;
+const float EROSION_THERMAL_RATE = 0.1f;
+// fewest rows worth starting another thread for in a thermal step
+const int EROSION_ROWS_PER_THREAD = 16;
+
+struct ErosionSettings
+{
+    // the same seed always gives the same result, whatever the number of threads
+    uint32_t Seed;
+    // droplets started per sample, over all the passes
+    float Droplets;
+    // thermal steps run after the droplets
+    int ThermalIterations;
+    // threads the erosion runs on, 0 for one per hardware thread
+    unsigned int Threads;
+
+    ErosionSettings() : Seed(1), Droplets(1.0f), ThermalIterations(10), Threads(0) {}
+};
+
+// Hydraulic erosion by droplets followed by thermal erosion, run over a heightmap before the terrain is built.
+// Each droplet runs downhill, picking up sediment where it speeds up and dropping it where it slows, as in Hans
+// Beyer's and Sebastian Lague's versions. A droplet changes the heights it passes, so droplets can't simply be
+// shared out between threads. Instead the map is cut into tiles of EROSION_TILE_SIZE, and a droplet never goes more
+// than EROSION_MARGIN past the tile it started in. Tiles are run in four phases by the parity of their row and
+// column, so the tiles in a phase are a tile apart and the samples they can touch never overlap. A phase's tiles are
+// shared between threads, with droplets taken in order from a generator seeded by the seed, the pass and the tile,
+// so the result depends only on the seed. The thermal steps read one copy of the map and write the other, a band of
+// rows per thread, so they are deterministic as well.
+class HeightmapErosion
+{
+public:
+    ErosionSettings Settings;
+    // how long the last Erode took
+    double ErodeMilliseconds;
+
+    HeightmapErosion() : ErodeMilliseconds(0.0)
+    {
+        for (int row = -EROSION_RADIUS; row <= EROSION_RADIUS; row++)
+        {
+            for (int column = -EROSION_RADIUS; column <= EROSION_RADIUS; column++)
+            {
+                float weight = EROSION_RADIUS - std::sqrt((float)(row * row + column * column));
+                if (weight <= 0.0f)
+                    continue;
+                brushRows.push_back(row);
+                brushColumns.push_back(column);
+                brushWeights.push_back(weight);
+            }
+        }
+        float total = 0.0f;
+        for (size_t i = 0; i < brushWeights.size(); i++)
+            total += brushWeights[i];
+        for (size_t i = 0; i < brushWeights.size(); i++)
+            brushWeights[i] /= total;
+    }
+
+    // erodes the heights in place
+    void Erode(Heightmap& heightmap)
+    {
+        PROFILE_SCOPE("HeightmapErosion::Erode");
+        if (heightmap.Rows < 2 || heightmap.Columns < 2)
+            return;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        threadCount = (int)threadsToUse(Settings.Threads);
+
+        // the droplets work on heights from 0 to 1
+        std::vector<float>& heights = heightmap.Heights;
+        float low = *std::min_element(heights.begin(), heights.end());
+        float high = *std::max_element(heights.begin(), heights.end());
+        float span = std::max(high - low, 1e-6f);
+        for (size_t i = 0; i < heights.size(); i++)
+            heights[i] = (heights[i] - low) / span;
+        {
+            PROFILE_SCOPE("Erosion droplets");
+            for (int pass = 0; pass < EROSION_PASSES; pass++)
+                for (int phase = 0; phase < 4; phase++)
+                    runPhase(heightmap, pass, phase);
+        }
+        for (size_t i = 0; i < heights.size(); i++)
+            heights[i] = heights[i] * span + low;
+
+        {
+            PROFILE_SCOPE("Erosion thermal");
+            for (int iteration = 0; iteration < Settings.ThermalIterations; iteration++)
+                thermalStep(heightmap);
+        }
+        ErodeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Eroded a " << heightmap.Rows << " x " << heightmap.Columns << " heightmap with seed " << Settings.Seed
+            << " on " << threadCount << " threads in " << ErodeMilliseconds << " ms" << std::endl;
+    }
+
+private:
+    int threadCount;
+    // offsets and weights of the samples a droplet erodes around its cell, the weights adding up to 1
+    std::vector<int> brushRows, brushColumns;
+    std::vector<float> brushWeights;
+    // tiles of the phase being run that haven't been taken by a thread yet, and the other copy of the thermal heights
+    std::atomic<int> nextTile;
+    std::vector<float> scratch;
+
+    // a small generator whose sequence is the same on every compiler, unlike <random>'s distributions
+    struct Random
+    {
+        uint64_t state;
+
+        explicit Random(uint64_t seed) : state(seed) {}
+
+        // 0 to 1, not including 1
+        float Next()
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            z ^= z >> 31;
+            return (float)(z >> 40) * (1.0f / 16777216.0f);
+        }
+    };
+
+    // the tile grid of a pass, moved on by a fraction of a tile from the last
+    static int gridOffset(int pass)
+    {
+        return pass * EROSION_TILE_SIZE / EROSION_PASSES;
+    }
+
+    void runPhase(Heightmap& heightmap, int pass, int phase)
+    {
+        int offset = gridOffset(pass);
+        int tileRows = (heightmap.Rows + offset + EROSION_TILE_SIZE - 1) / EROSION_TILE_SIZE;
+        int tileColumns = (heightmap.Columns + offset + EROSION_TILE_SIZE - 1) / EROSION_TILE_SIZE;
+        // the tiles with this phase's row and column parity
+        int phaseRows = (tileRows - (phase >> 1) + 1) / 2, phaseColumns = (tileColumns - (phase & 1) + 1) / 2;
+        int tileCount = phaseRows * phaseColumns;
+        if (tileCount <= 0)
+            return;
+        nextTile = 0;
+        int workerCount = std::min(threadCount, tileCount);
+        std::vector<std::thread> workers;
+        for (int t = 1; t < workerCount; t++)
+            workers.push_back(std::thread(&HeightmapErosion::runTiles, this, std::ref(heightmap), pass, phase, phaseColumns, tileCount));
+        runTiles(heightmap, pass, phase, phaseColumns, tileCount);
+        for (size_t t = 0; t < workers.size(); t++)
+            workers[t].join();
+    }
+
+    // takes tiles of a phase until there are none left. Which thread runs a tile doesn't change what it does
+    void runTiles(Heightmap& heightmap, int pass, int phase, int phaseColumns, int tileCount)
+    {
+        for (int tile = nextTile++; tile < tileCount; tile = nextTile++)
+        {
+            int tileRow = (tile / phaseColumns) * 2 + (phase >> 1);
+            int tileColumn = (tile % phaseColumns) * 2 + (phase & 1);
+            runTile(heightmap, pass, tileRow * EROSION_TILE_SIZE - gridOffset(pass), tileColumn * EROSION_TILE_SIZE - gridOffset(pass));
+        }
+    }
+
+    void runTile(Heightmap& heightmap, int pass, int firstRow, int firstColumn)
+    {
+        // droplets start in the tile's part of the map, away from the last row and column so their cell is whole
+        int startRow = std::max(firstRow, 0), endRow = std::min(firstRow + EROSION_TILE_SIZE, heightmap.Rows - 1);
+        int startColumn = std::max(firstColumn, 0), endColumn = std::min(firstColumn + EROSION_TILE_SIZE, heightmap.Columns - 1);
+        if (endRow <= startRow || endColumn <= startColumn)
+            return;
+        uint64_t seed = ((uint64_t)Settings.Seed << 32) ^ ((uint64_t)pass << 48) ^ ((uint64_t)(uint32_t)firstRow << 16) ^ (uint64_t)(uint32_t)firstColumn;
+        Random random(seed * 0xD1B54A32D192ED03ull);
+        int droplets = (int)((float)(endRow - startRow) * (endColumn - startColumn) * Settings.Droplets / EROSION_PASSES + 0.5f);
+        for (int droplet = 0; droplet < droplets; droplet++)
+        {
+            float row = startRow + random.Next() * (endRow - startRow);
+            float column = startColumn + random.Next() * (endColumn - startColumn);
+            runDroplet(heightmap, row, column, firstRow - EROSION_MARGIN, firstColumn - EROSION_MARGIN,
+                firstRow + EROSION_TILE_SIZE + EROSION_MARGIN - 1, firstColumn + EROSION_TILE_SIZE + EROSION_MARGIN - 1);
+        }
+    }
+
+    // height and downhill gradient at a fractional sample position whose cell is inside the map
+    static float heightAndGradient(const Heightmap& heightmap, float row, float column, float& gradientRow, float& gradientColumn)
+    {
+        int r = (int)row, c = (int)column;
+        float fr = row - r, fc = column - c;
+        const float* top = &heightmap.Heights[(size_t)r * heightmap.Columns + c];
+        const float* bottom = top + heightmap.Columns;
+        gradientRow = (bottom[0] - top[0]) * (1.0f - fc) + (bottom[1] - top[1]) * fc;
+        gradientColumn = (top[1] - top[0]) * (1.0f - fr) + (bottom[1] - bottom[0]) * fr;
+        return (top[0] * (1.0f - fc) + top[1] * fc) * (1.0f - fr) + (bottom[0] * (1.0f - fc) + bottom[1] * fc) * fr;
+    }
+
+    // one droplet, which stops once its cell leaves the map or [firstRow, lastRow] x [firstColumn, lastColumn]
+    void runDroplet(Heightmap& heightmap, float row, float column, int firstRow, int firstColumn, int lastRow, int lastColumn)
+    {
+        firstRow = std::max(firstRow, 0);
+        firstColumn = std::max(firstColumn, 0);
+        lastRow = std::min(lastRow, heightmap.Rows - 2);
+        lastColumn = std::min(lastColumn, heightmap.Columns - 2);
+        std::vector<float>& heights = heightmap.Heights;
+        float directionRow = 0.0f, directionColumn = 0.0f;
+        float speed = 1.0f, water = 1.0f, sediment = 0.0f;
+        for (int step = 0; step < EROSION_LIFETIME; step++)
+        {
+            int cellRow = (int)row, cellColumn = (int)column;
+            float offsetRow = row - cellRow, offsetColumn = column - cellColumn;
+            float gradientRow, gradientColumn;
+            float height = heightAndGradient(heightmap, row, column, gradientRow, gradientColumn);
+
+            // turn downhill, keeping a little of the way it was going
+            directionRow = directionRow * EROSION_INERTIA - gradientRow * (1.0f - EROSION_INERTIA);
+            directionColumn = directionColumn * EROSION_INERTIA - gradientColumn * (1.0f - EROSION_INERTIA);
+            float length = std::sqrt(directionRow * directionRow + directionColumn * directionColumn);
+            if (length == 0.0f)
+                break;
+            directionRow /= length;
+            directionColumn /= length;
+            row += directionRow;
+            column += directionColumn;
+            if (row < firstRow || column < firstColumn || row >= lastRow + 1 || column >= lastColumn + 1)
+                break;
+
+            float ignored;
+            float heightChange = heightAndGradient(heightmap, row, column, ignored, ignored) - height;
+            float capacity = std::max(-heightChange * speed * water * EROSION_CAPACITY, EROSION_MIN_CAPACITY);
+            size_t cell = (size_t)cellRow * heightmap.Columns + cellColumn;
+            if (sediment > capacity || heightChange > 0.0f)
+            {
+                // uphill it fills the pit it left, otherwise it drops some of what it carries over capacity
+                float deposit = heightChange > 0.0f ? std::min(heightChange, sediment) : (sediment - capacity) * EROSION_DEPOSIT_SPEED;
+                sediment -= deposit;
+                heights[cell] += deposit * (1.0f - offsetRow) * (1.0f - offsetColumn);
+                heights[cell + 1] += deposit * (1.0f - offsetRow) * offsetColumn;
+                heights[cell + heightmap.Columns] += deposit * offsetRow * (1.0f - offsetColumn);
+                heights[cell + heightmap.Columns + 1] += deposit * offsetRow * offsetColumn;
+            }
+            else
+            {
+                // never more than the drop, so it doesn't dig a hole behind it
+                float erode = std::min((capacity - sediment) * EROSION_ERODE_SPEED, -heightChange);
+                for (size_t i = 0; i < brushWeights.size(); i++)
+                {
+                    int r = cellRow + brushRows[i], c = cellColumn + brushColumns[i];
+                    if (r < 0 || c < 0 || r >= heightmap.Rows || c >= heightmap.Columns)
+                        continue;
+                    float& sample = heights[(size_t)r * heightmap.Columns + c];
+                    float taken = std::min(sample, erode * brushWeights[i]);
+                    sample -= taken;
+                    sediment += taken;
+                }
+            }
+            speed = std::sqrt(std::max(speed * speed - heightChange * EROSION_GRAVITY, 0.0f));
+            water *= 1.0f - EROSION_EVAPORATION;
+        }
+    }
+
+    // each sample trades EROSION_THERMAL_RATE of the height over the talus with each of its four neighbours. What
+    // one sample gives the other takes, so no height is lost
+    void thermalStep(Heightmap& heightmap)
+    {
+        scratch.resize(heightmap.Heights.size());
+        inShares((size_t)heightmap.Rows, (unsigned int)threadCount, EROSION_ROWS_PER_THREAD, [&](size_t first, size_t end)
+        {
+            thermalRows(heightmap, (int)first, (int)end);
+        });
+        heightmap.Heights.swap(scratch);
+    }
+
+    void thermalRows(const Heightmap& heightmap, int firstRow, int endRow)
+    {
+        float talus = EROSION_TALUS * HEIGHTMAP_SPACING;
+        for (int row = firstRow; row < endRow; row++)
+        {
+            const float* middle = &heightmap.Heights[(size_t)row * heightmap.Columns];
+            const float* above = row > 0 ? middle - heightmap.Columns : middle;
+            const float* below = row < heightmap.Rows - 1 ? middle + heightmap.Columns : middle;
+            float* out = &scratch[(size_t)row * heightmap.Columns];
+            for (int column = 0; column < heightmap.Columns; column++)
+            {
+                float h = middle[column];
+                float left = middle[std::max(column - 1, 0)], right = middle[std::min(column + 1, heightmap.Columns - 1)];
+                float change = 0.0f;
+                const float neighbours[4] = { above[column], below[column], left, right };
+                for (int n = 0; n < 4; n++)
+                    change += std::max(neighbours[n] - h - talus, 0.0f) - std::max(h - neighbours[n] - talus, 0.0f);
+                out[column] = h + change * EROSION_THERMAL_RATE;
+            }
+        }
+    }
+};
+
+// Erodes a heightmap file and writes the result as a 16-bit .raw or .r16 (see Heightmap::Save), which --heightmap and
+// --make-tiles read back without losing the erosion's fine steps
+inline bool writeErodedHeightmap(const std::string& inputPath, const std::string& outputPath, const ErosionSettings& settings)
+{
+    PROFILE_SCOPE("writeErodedHeightmap");
+    Heightmap heightmap;
+    if (!heightmap.Load(inputPath))
+        return false;
+    HeightmapErosion erosion;
+    erosion.Settings = settings;
+    erosion.Erode(heightmap);
+    return heightmap.Save(outputPath);
+}
+#endif
@@ -0,0 +1,59 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+// The six planes of a view frustum, taken from a projection * view matrix (Gribb and Hartmann). Each plane is
+// (normal, distance) with the normal pointing inwards, so a point p is inside when dot(normal, p) + distance >= 0.
+struct Frustum
+{
+    glm::vec4 Planes[6];
+
+    void Extract(const glm::mat4& viewProjection)
+    {
+        const glm::mat4& m = viewProjection;
+        for (int i = 0; i < 3; i++)
+        {
+            // left/right, bottom/top, near/far: the fourth row plus and minus the first, second and third
+            Planes[i * 2] = glm::vec4(m[0][3] + m[0][i], m[1][3] + m[1][i], m[2][3] + m[2][i], m[3][3] + m[3][i]);
+            Planes[i * 2 + 1] = glm::vec4(m[0][3] - m[0][i], m[1][3] - m[1][i], m[2][3] - m[2][i], m[3][3] - m[3][i]);
+        }
+        for (int i = 0; i < 6; i++)
+        {
+            float length = std::sqrt(Planes[i].x * Planes[i].x + Planes[i].y * Planes[i].y + Planes[i].z * Planes[i].z);
+            Planes[i] = Planes[i] / length;
+        }
+    }
+
+    // false only if the box is entirely outside one of the planes, so boxes near a corner may pass
+    bool IntersectsBox(const glm::vec3& low, const glm::vec3& high) const
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            // the corner furthest along the plane's normal
+            glm::vec3 corner(Planes[i].x >= 0.0f ? high.x : low.x, Planes[i].y >= 0.0f ? high.y : low.y, Planes[i].z >= 0.0f ? high.z : low.z);
+            if (Planes[i].x * corner.x + Planes[i].y * corner.y + Planes[i].z * corner.z + Planes[i].w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    bool IntersectsSphere(const glm::vec3& centre, float radius) const
+    {
+        for (int i = 0; i < 6; i++)
+            if (Planes[i].x * centre.x + Planes[i].y * centre.y + Planes[i].z * centre.z + Planes[i].w < -radius)
+                return false;
+        return true;
+    }
+};
+
+// whether any point of the box [low, high] is within radius of centre
+inline bool sphereIntersectsBox(const glm::vec3& centre, float radius, const glm::vec3& low, const glm::vec3& high)
+{
+    glm::vec3 closest = glm::min(glm::max(centre, low), high);
+    glm::vec3 offset = centre - closest;
+    return offset.x * offset.x + offset.y * offset.y + offset.z * offset.z <= radius * radius;
+}
+#endif
@@ -0,0 +1,540 @@
+#ifndef GLCOUNTERS_H
+#define GLCOUNTERS_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <unordered_map>
+
+// GL work done in one frame. A call is redundant when it sets state to the value it already had
+struct GLFrameCounters {
+    uint64_t drawCalls;
+    uint64_t instancesDrawn;
+    uint64_t programSwitches;
+    uint64_t redundantProgramSwitches;
+    uint64_t textureBinds;
+    uint64_t redundantTextureBinds;
+    uint64_t activeTextureChanges;
+    uint64_t redundantActiveTextureChanges;
+    uint64_t vertexArrayBinds;
+    uint64_t redundantVertexArrayBinds;
+    uint64_t bufferBinds;
+    uint64_t redundantBufferBinds;
+    uint64_t stateChanges;
+    uint64_t redundantStateChanges;
+    uint64_t uniformLookups;
+    uint64_t uniformUploads;
+    uint64_t redundantUniformUploads;
+    uint64_t ignoredUniformUploads;    // to location -1, i.e. a name the program doesn't use
+    uint64_t bufferUploads;
+    uint64_t bufferUploadBytes;
+    uint64_t textureUploads;
+};
+
+// Optional interception layer over glad's function pointers. Install() swaps the pointers for the calls below
+// with wrappers that count them (and compare them against the state they change) before forwarding to the
+// driver. Everything else goes straight to the driver, and nothing is intercepted until Install() is called.
+class GLCounters
+{
+public:
+    static GLCounters& Get()
+    {
+        static GLCounters instance;
+        return instance;
+    }
+
+    bool Installed() const
+    {
+        return installed;
+    }
+
+    // call once after gladLoadGL
+    void Install()
+    {
+        if (installed)
+            return;
+        installed = true;
+
+        hook(glad_glDrawArrays, real.DrawArrays, drawArrays);
+        hook(glad_glDrawElements, real.DrawElements, drawElements);
+        hook(glad_glDrawArraysInstanced, real.DrawArraysInstanced, drawArraysInstanced);
+        hook(glad_glDrawElementsInstanced, real.DrawElementsInstanced, drawElementsInstanced);
+        hook(glad_glMultiDrawArrays, real.MultiDrawArrays, multiDrawArrays);
+        hook(glad_glUseProgram, real.UseProgram, useProgram);
+        hook(glad_glDeleteProgram, real.DeleteProgram, deleteProgram);
+        hook(glad_glActiveTexture, real.ActiveTexture, activeTexture);
+        hook(glad_glBindTexture, real.BindTexture, bindTexture);
+        hook(glad_glBindVertexArray, real.BindVertexArray, bindVertexArray);
+        hook(glad_glBindBuffer, real.BindBuffer, bindBuffer);
+        hook(glad_glEnable, real.Enable, enable);
+        hook(glad_glDisable, real.Disable, disable);
+        hook(glad_glDepthFunc, real.DepthFunc, depthFunc);
+        hook(glad_glBlendFunc, real.BlendFunc, blendFunc);
+        hook(glad_glGetUniformLocation, real.GetUniformLocation, getUniformLocation);
+        hook(glad_glUniform1i, real.Uniform1i, uniform1i);
+        hook(glad_glUniform1f, real.Uniform1f, uniform1f);
+        hook(glad_glUniform2f, real.Uniform2f, uniform2f);
+        hook(glad_glUniform3f, real.Uniform3f, uniform3f);
+        hook(glad_glUniform4f, real.Uniform4f, uniform4f);
+        hook(glad_glUniform1iv, real.Uniform1iv, uniform1iv);
+        hook(glad_glUniform1fv, real.Uniform1fv, uniform1fv);
+        hook(glad_glUniform2fv, real.Uniform2fv, uniform2fv);
+        hook(glad_glUniform3fv, real.Uniform3fv, uniform3fv);
+        hook(glad_glUniform4fv, real.Uniform4fv, uniform4fv);
+        hook(glad_glUniformMatrix2fv, real.UniformMatrix2fv, uniformMatrix2fv);
+        hook(glad_glUniformMatrix3fv, real.UniformMatrix3fv, uniformMatrix3fv);
+        hook(glad_glUniformMatrix4fv, real.UniformMatrix4fv, uniformMatrix4fv);
+        hook(glad_glBufferData, real.BufferData, bufferData);
+        hook(glad_glBufferSubData, real.BufferSubData, bufferSubData);
+        hook(glad_glTexImage2D, real.TexImage2D, texImage2D);
+        hook(glad_glTexSubImage2D, real.TexSubImage2D, texSubImage2D);
+        hook(glad_glTexImage3D, real.TexImage3D, texImage3D);
+        hook(glad_glTexSubImage3D, real.TexSubImage3D, texSubImage3D);
+        hook(glad_glMapBufferRange, real.MapBufferRange, mapBufferRange);
+        hook(glad_glUnmapBuffer, real.UnmapBuffer, unmapBuffer);
+    }
+
+    void BeginFrame()
+    {
+        if (!installed)
+            return;
+        std::memset(&current, 0, sizeof(current));
+    }
+
+    void EndFrame()
+    {
+        if (!installed)
+            return;
+        history.push_back(current);
+    }
+
+    // counts so far this frame
+    const GLFrameCounters& Current() const
+    {
+        return current;
+    }
+
+    // counts for the last finished frame
+    const GLFrameCounters& Last() const
+    {
+        return history.empty() ? current : history.back();
+    }
+
+    // JSON object with the mean and max of each counter per frame
+    std::string ReportJson() const
+    {
+        std::ostringstream json;
+        json << "{\n";
+        for (size_t i = 0; i < COUNTER_COUNT; i++)
+        {
+            double mean = 0.0;
+            uint64_t max = 0;
+            for (size_t f = 0; f < history.size(); f++)
+            {
+                uint64_t value = field(history[f], i);
+                mean += (double)value;
+                if (value > max)
+                    max = value;
+            }
+            if (!history.empty())
+                mean /= history.size();
+            json << "    \"" << names()[i] << "\": { \"mean\": " << mean << ", \"max\": " << max << " }" << (i + 1 < COUNTER_COUNT ? ",\n" : "\n");
+        }
+        json << "  }";
+        return json.str();
+    }
+
+private:
+    static const size_t COUNTER_COUNT = sizeof(GLFrameCounters) / sizeof(uint64_t);
+    static_assert(sizeof(GLFrameCounters) == 21 * sizeof(uint64_t), "update names() when adding counters");
+
+    struct RealFunctions {
+        PFNGLDRAWARRAYSPROC DrawArrays;
+        PFNGLDRAWELEMENTSPROC DrawElements;
+        PFNGLDRAWARRAYSINSTANCEDPROC DrawArraysInstanced;
+        PFNGLDRAWELEMENTSINSTANCEDPROC DrawElementsInstanced;
+        PFNGLMULTIDRAWARRAYSPROC MultiDrawArrays;
+        PFNGLUSEPROGRAMPROC UseProgram;
+        PFNGLDELETEPROGRAMPROC DeleteProgram;
+        PFNGLACTIVETEXTUREPROC ActiveTexture;
+        PFNGLBINDTEXTUREPROC BindTexture;
+        PFNGLBINDVERTEXARRAYPROC BindVertexArray;
+        PFNGLBINDBUFFERPROC BindBuffer;
+        PFNGLENABLEPROC Enable;
+        PFNGLDISABLEPROC Disable;
+        PFNGLDEPTHFUNCPROC DepthFunc;
+        PFNGLBLENDFUNCPROC BlendFunc;
+        PFNGLGETUNIFORMLOCATIONPROC GetUniformLocation;
+        PFNGLUNIFORM1IPROC Uniform1i;
+        PFNGLUNIFORM1FPROC Uniform1f;
+        PFNGLUNIFORM2FPROC Uniform2f;
+        PFNGLUNIFORM3FPROC Uniform3f;
+        PFNGLUNIFORM4FPROC Uniform4f;
+        PFNGLUNIFORM1IVPROC Uniform1iv;
+        PFNGLUNIFORM1FVPROC Uniform1fv;
+        PFNGLUNIFORM2FVPROC Uniform2fv;
+        PFNGLUNIFORM3FVPROC Uniform3fv;
+        PFNGLUNIFORM4FVPROC Uniform4fv;
+        PFNGLUNIFORMMATRIX2FVPROC UniformMatrix2fv;
+        PFNGLUNIFORMMATRIX3FVPROC UniformMatrix3fv;
+        PFNGLUNIFORMMATRIX4FVPROC UniformMatrix4fv;
+        PFNGLBUFFERDATAPROC BufferData;
+        PFNGLBUFFERSUBDATAPROC BufferSubData;
+        PFNGLTEXIMAGE2DPROC TexImage2D;
+        PFNGLTEXSUBIMAGE2DPROC TexSubImage2D;
+        PFNGLTEXIMAGE3DPROC TexImage3D;
+        PFNGLTEXSUBIMAGE3DPROC TexSubImage3D;
+        PFNGLMAPBUFFERRANGEPROC MapBufferRange;
+        PFNGLUNMAPBUFFERPROC UnmapBuffer;
+    };
+
+    static const int MAX_TEXTURE_UNITS = 32;
+
+    bool installed;
+    RealFunctions real;
+    GLFrameCounters current;
+    std::vector<GLFrameCounters> history;
+
+    // the state the counted calls last set. ~0 means unknown, so the first call is never counted as redundant
+    GLuint program;
+    GLenum activeUnit;
+    GLuint boundTextures[MAX_TEXTURE_UNITS][4];
+    GLuint vertexArray;
+    GLuint arrayBuffer, elementArrayBuffer;
+    std::unordered_map<GLenum, bool> capabilities;
+    GLenum depthFunction;
+    GLenum blendSource, blendDestination;
+    // last uploaded bytes per location of each program, dropped when the program is deleted so a new program given
+    // the same name starts unknown
+    std::unordered_map<GLuint, std::unordered_map<GLint, std::string>> uniformValues;
+    // bytes mapped for writing per buffer target, counted as an upload when the target is unmapped
+    std::unordered_map<GLenum, GLsizeiptr> mappedBytes;
+
+    GLCounters() : installed(false), program(~0u), activeUnit(GL_TEXTURE0), vertexArray(~0u), arrayBuffer(~0u), elementArrayBuffer(~0u),
+        depthFunction(~0u), blendSource(~0u), blendDestination(~0u)
+    {
+        std::memset(&real, 0, sizeof(real));
+        std::memset(&current, 0, sizeof(current));
+        std::memset(boundTextures, 0xff, sizeof(boundTextures));
+    }
+
+    template <typename T>
+    static void hook(T& gladPointer, T& realPointer, T wrapper)
+    {
+        realPointer = gladPointer;
+        gladPointer = wrapper;
+    }
+
+    static uint64_t field(const GLFrameCounters& counters, size_t index)
+    {
+        return ((const uint64_t*)&counters)[index];
+    }
+
+    static const char* const* names()
+    {
+        static const char* const counterNames[COUNTER_COUNT] = {
+            "draw_calls", "instances_drawn", "program_switches", "redundant_program_switches",
+            "texture_binds", "redundant_texture_binds", "active_texture_changes", "redundant_active_texture_changes",
+            "vertex_array_binds", "redundant_vertex_array_binds", "buffer_binds", "redundant_buffer_binds",
+            "state_changes", "redundant_state_changes", "uniform_lookups", "uniform_uploads",
+            "redundant_uniform_uploads", "ignored_uniform_uploads", "buffer_uploads", "buffer_upload_bytes", "texture_uploads"
+        };
+        return counterNames;
+    }
+
+    // counts a uniform upload and whether it repeats the value already held at that location
+    void countUniform(GLint location, const void* data, size_t size)
+    {
+        current.uniformUploads++;
+        if (location < 0)
+        {
+            current.ignoredUniformUploads++;
+            return;
+        }
+        std::string& last = uniformValues[program][location];
+        if (last.size() == size && std::memcmp(last.data(), data, size) == 0)
+            current.redundantUniformUploads++;
+        else
+            last.assign((const char*)data, size);
+    }
+
+    // slot in boundTextures for the targets this project uses, -1 for others (which aren't checked for redundancy)
+    static int textureTargetIndex(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_CUBE_MAP: return 1;
+        case GL_TEXTURE_2D_ARRAY: return 2;
+        case GL_TEXTURE_BUFFER: return 3;
+        default: return -1;
+        }
+    }
+
+    // wrappers installed in place of glad's pointers
+    static void APIENTRY drawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        Get().current.drawCalls++;
+        Get().current.instancesDrawn++;
+        Get().real.DrawArrays(mode, first, count);
+    }
+    static void APIENTRY drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+    {
+        Get().current.drawCalls++;
+        Get().current.instancesDrawn++;
+        Get().real.DrawElements(mode, count, type, indices);
+    }
+    static void APIENTRY drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount)
+    {
+        Get().current.drawCalls++;
+        Get().current.instancesDrawn += instancecount;
+        Get().real.DrawArraysInstanced(mode, first, count, instancecount);
+    }
+    static void APIENTRY drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount)
+    {
+        Get().current.drawCalls++;
+        Get().current.instancesDrawn += instancecount;
+        Get().real.DrawElementsInstanced(mode, count, type, indices, instancecount);
+    }
+    // one call that draws drawcount ranges, counted as a single draw
+    static void APIENTRY multiDrawArrays(GLenum mode, const GLint* first, const GLsizei* count, GLsizei drawcount)
+    {
+        Get().current.drawCalls++;
+        Get().current.instancesDrawn += drawcount;
+        Get().real.MultiDrawArrays(mode, first, count, drawcount);
+    }
+    static void APIENTRY useProgram(GLuint program)
+    {
+        GLCounters& counters = Get();
+        counters.current.programSwitches++;
+        if (counters.program == program)
+            counters.current.redundantProgramSwitches++;
+        counters.program = program;
+        counters.real.UseProgram(program);
+    }
+    static void APIENTRY deleteProgram(GLuint program)
+    {
+        GLCounters& counters = Get();
+        counters.uniformValues.erase(program);
+        // the name can come back for another program, which using isn't redundant
+        if (counters.program == program)
+            counters.program = ~0u;
+        counters.real.DeleteProgram(program);
+    }
+    static void APIENTRY activeTexture(GLenum texture)
+    {
+        GLCounters& counters = Get();
+        counters.current.activeTextureChanges++;
+        if (counters.activeUnit == texture)
+            counters.current.redundantActiveTextureChanges++;
+        counters.activeUnit = texture;
+        counters.real.ActiveTexture(texture);
+    }
+    static void APIENTRY bindTexture(GLenum target, GLuint texture)
+    {
+        GLCounters& counters = Get();
+        counters.current.textureBinds++;
+        unsigned int unit = counters.activeUnit - GL_TEXTURE0;
+        int targetIndex = textureTargetIndex(target);
+        if (unit < MAX_TEXTURE_UNITS && targetIndex >= 0)
+        {
+            GLuint& bound = counters.boundTextures[unit][targetIndex];
+            if (bound == texture)
+                counters.current.redundantTextureBinds++;
+            bound = texture;
+        }
+        counters.real.BindTexture(target, texture);
+    }
+    static void APIENTRY bindVertexArray(GLuint array)
+    {
+        GLCounters& counters = Get();
+        counters.current.vertexArrayBinds++;
+        if (counters.vertexArray == array)
+            counters.current.redundantVertexArrayBinds++;
+        counters.vertexArray = array;
+        // the element buffer binding belongs to the vertex array
+        counters.elementArrayBuffer = ~0u;
+        counters.real.BindVertexArray(array);
+    }
+    static void APIENTRY bindBuffer(GLenum target, GLuint buffer)
+    {
+        GLCounters& counters = Get();
+        counters.current.bufferBinds++;
+        GLuint* bound = target == GL_ARRAY_BUFFER ? &counters.arrayBuffer : target == GL_ELEMENT_ARRAY_BUFFER ? &counters.elementArrayBuffer : NULL;
+        if (bound)
+        {
+            if (*bound == buffer)
+                counters.current.redundantBufferBinds++;
+            *bound = buffer;
+        }
+        counters.real.BindBuffer(target, buffer);
+    }
+    static void setCapability(GLenum cap, bool enabled)
+    {
+        GLCounters& counters = Get();
+        counters.current.stateChanges++;
+        std::unordered_map<GLenum, bool>::iterator it = counters.capabilities.find(cap);
+        if (it != counters.capabilities.end() && it->second == enabled)
+            counters.current.redundantStateChanges++;
+        counters.capabilities[cap] = enabled;
+    }
+    static void APIENTRY enable(GLenum cap)
+    {
+        setCapability(cap, true);
+        Get().real.Enable(cap);
+    }
+    static void APIENTRY disable(GLenum cap)
+    {
+        setCapability(cap, false);
+        Get().real.Disable(cap);
+    }
+    static void APIENTRY depthFunc(GLenum func)
+    {
+        GLCounters& counters = Get();
+        counters.current.stateChanges++;
+        if (counters.depthFunction == func)
+            counters.current.redundantStateChanges++;
+        counters.depthFunction = func;
+        counters.real.DepthFunc(func);
+    }
+    static void APIENTRY blendFunc(GLenum sfactor, GLenum dfactor)
+    {
+        GLCounters& counters = Get();
+        counters.current.stateChanges++;
+        if (counters.blendSource == sfactor && counters.blendDestination == dfactor)
+            counters.current.redundantStateChanges++;
+        counters.blendSource = sfactor;
+        counters.blendDestination = dfactor;
+        counters.real.BlendFunc(sfactor, dfactor);
+    }
+    static GLint APIENTRY getUniformLocation(GLuint program, const GLchar* name)
+    {
+        Get().current.uniformLookups++;
+        return Get().real.GetUniformLocation(program, name);
+    }
+    static void APIENTRY uniform1i(GLint location, GLint v0)
+    {
+        Get().countUniform(location, &v0, sizeof(v0));
+        Get().real.Uniform1i(location, v0);
+    }
+    static void APIENTRY uniform1f(GLint location, GLfloat v0)
+    {
+        Get().countUniform(location, &v0, sizeof(v0));
+        Get().real.Uniform1f(location, v0);
+    }
+    static void APIENTRY uniform2f(GLint location, GLfloat v0, GLfloat v1)
+    {
+        GLfloat v[2] = { v0, v1 };
+        Get().countUniform(location, v, sizeof(v));
+        Get().real.Uniform2f(location, v0, v1);
+    }
+    static void APIENTRY uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+    {
+        GLfloat v[3] = { v0, v1, v2 };
+        Get().countUniform(location, v, sizeof(v));
+        Get().real.Uniform3f(location, v0, v1, v2);
+    }
+    static void APIENTRY uniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+    {
+        GLfloat v[4] = { v0, v1, v2, v3 };
+        Get().countUniform(location, v, sizeof(v));
+        Get().real.Uniform4f(location, v0, v1, v2, v3);
+    }
+    static void APIENTRY uniform1iv(GLint location, GLsizei count, const GLint* value)
+    {
+        Get().countUniform(location, value, count * sizeof(GLint));
+        Get().real.Uniform1iv(location, count, value);
+    }
+    static void APIENTRY uniform1fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        Get().countUniform(location, value, count * sizeof(GLfloat));
+        Get().real.Uniform1fv(location, count, value);
+    }
+    static void APIENTRY uniform2fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        Get().countUniform(location, value, count * 2 * sizeof(GLfloat));
+        Get().real.Uniform2fv(location, count, value);
+    }
+    static void APIENTRY uniform3fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        Get().countUniform(location, value, count * 3 * sizeof(GLfloat));
+        Get().real.Uniform3fv(location, count, value);
+    }
+    static void APIENTRY uniform4fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        Get().countUniform(location, value, count * 4 * sizeof(GLfloat));
+        Get().real.Uniform4fv(location, count, value);
+    }
+    static void APIENTRY uniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        Get().countUniform(location, value, count * 4 * sizeof(GLfloat));
+        Get().real.UniformMatrix2fv(location, count, transpose, value);
+    }
+    static void APIENTRY uniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        Get().countUniform(location, value, count * 9 * sizeof(GLfloat));
+        Get().real.UniformMatrix3fv(location, count, transpose, value);
+    }
+    static void APIENTRY uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        Get().countUniform(location, value, count * 16 * sizeof(GLfloat));
+        Get().real.UniformMatrix4fv(location, count, transpose, value);
+    }
+    static void APIENTRY bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+    {
+        Get().current.bufferUploads++;
+        Get().current.bufferUploadBytes += data ? size : 0;
+        Get().real.BufferData(target, size, data, usage);
+    }
+    static void APIENTRY bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+    {
+        Get().current.bufferUploads++;
+        Get().current.bufferUploadBytes += size;
+        Get().real.BufferSubData(target, offset, size, data);
+    }
+    static void APIENTRY texImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+    {
+        Get().current.textureUploads++;
+        Get().real.TexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+    }
+    static void APIENTRY texSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels)
+    {
+        Get().current.textureUploads++;
+        Get().real.TexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+    }
+    static void APIENTRY texImage3D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels)
+    {
+        Get().current.textureUploads++;
+        Get().real.TexImage3D(target, level, internalformat, width, height, depth, border, format, type, pixels);
+    }
+    static void APIENTRY texSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+    {
+        Get().current.textureUploads++;
+        Get().real.TexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels);
+    }
+    // a buffer filled through a mapping is one upload of the mapped range, counted when it's unmapped
+    static void* APIENTRY mapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+    {
+        void* data = Get().real.MapBufferRange(target, offset, length, access);
+        if (data && (access & GL_MAP_WRITE_BIT))
+            Get().mappedBytes[target] = length;
+        return data;
+    }
+    static GLboolean APIENTRY unmapBuffer(GLenum target)
+    {
+        GLCounters& counters = Get();
+        std::unordered_map<GLenum, GLsizeiptr>::iterator it = counters.mappedBytes.find(target);
+        if (it != counters.mappedBytes.end())
+        {
+            counters.current.bufferUploads++;
+            counters.current.bufferUploadBytes += it->second;
+            counters.mappedBytes.erase(it);
+        }
+        return counters.real.UnmapBuffer(target);
+    }
+};
+#endif
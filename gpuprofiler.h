@@ -0,0 +1,220 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <glad/glad.h>
+
+#include "benchmark.h"
+#include "profiler.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+// Measures how long each render pass takes on the GPU with GL_TIMESTAMP queries (core since GL 3.3).
+// Results are read back FRAME_LATENCY frames later, by which time the GPU has normally finished them, so the
+// profiler doesn't stall the pipeline. Passes must not overlap.
+//
+// Mesa's software rasterisers (llvmpipe, softpipe) take timestamps when commands are recorded rather than when
+// they are rasterised, so every pass would read as ~0 ms. On those the profiler instead finishes the pipeline
+// around each pass and times it on the CPU clock, which is where a software renderer does its work anyway.
+class GpuProfiler
+{
+public:
+    static const int FRAME_LATENCY = 4;
+
+    bool Enabled;
+
+    GpuProfiler() : Enabled(false), synchronous(false), frameIndex(0), openPass(-1), gpuEpoch(0), cpuEpoch(0), track(NULL) {}
+
+    void Init()
+    {
+        if (!Enabled)
+            return;
+        const char* renderer = (const char*)glGetString(GL_RENDERER);
+        synchronous = renderer && (std::strstr(renderer, "llvmpipe") || std::strstr(renderer, "softpipe"));
+
+        // pair a GPU timestamp with a CPU one so GPU passes can be placed on the CPU profiler's timeline
+        glGetInteger64v(GL_TIMESTAMP, &gpuEpoch);
+        cpuEpoch = Profiler::Now();
+#if PROFILER_ENABLED
+        if (Profiler::Get().Enabled)
+            track = &Profiler::Get().AddTrack("GPU");
+#endif
+    }
+
+    // how pass times are measured, for reports
+    const char* Method() const
+    {
+        return synchronous ? "finish" : "timestamp_query";
+    }
+
+    void BeginFrame()
+    {
+        if (!Enabled)
+            return;
+        // the slot for this frame was last used FRAME_LATENCY frames ago, so collect its results before reusing it
+        collect(frames[frameIndex]);
+    }
+
+    void BeginPass(const char* name)
+    {
+        if (!Enabled)
+            return;
+        FrameQueries& frame = frames[frameIndex];
+        if (frame.used == frame.passes.size())
+        {
+            PassQueries pass;
+            glGenQueries(2, pass.queries);
+            frame.passes.push_back(pass);
+        }
+        openPass = (int)frame.used++;
+        frame.passes[openPass].name = name;
+        if (synchronous)
+        {
+            glFinish();
+            frame.passes[openPass].cpuTimes[0] = Profiler::Now();
+        }
+        else
+            glQueryCounter(frame.passes[openPass].queries[0], GL_TIMESTAMP);
+    }
+
+    void EndPass()
+    {
+        if (!Enabled || openPass < 0)
+            return;
+        if (synchronous)
+        {
+            glFinish();
+            frames[frameIndex].passes[openPass].cpuTimes[1] = Profiler::Now();
+        }
+        else
+            glQueryCounter(frames[frameIndex].passes[openPass].queries[1], GL_TIMESTAMP);
+        openPass = -1;
+    }
+
+    void EndFrame()
+    {
+        if (!Enabled)
+            return;
+        frameIndex = (frameIndex + 1) % FRAME_LATENCY;
+    }
+
+    // reads back every frame still in flight, call once rendering is finished
+    void Flush()
+    {
+        if (!Enabled)
+            return;
+        for (int i = 1; i <= FRAME_LATENCY; i++)
+            collect(frames[(frameIndex + i) % FRAME_LATENCY]);
+    }
+
+    // JSON object of per-pass GPU milliseconds, plus "frame" for all passes of a frame
+    std::string ReportJson() const
+    {
+        std::ostringstream json;
+        json << "{\n";
+        for (size_t i = 0; i < passNames.size(); i++)
+            json << "    \"" << passNames[i] << "\": " << summariseTimes(passTimes[i]) << ",\n";
+        json << "    \"frame\": " << summariseTimes(frameTimes) << "\n  }";
+        return json.str();
+    }
+
+    void PrintSummary() const
+    {
+        std::cout << "GPU time per pass over " << frameTimes.size() << " frames (mean ms):" << std::endl;
+        for (size_t i = 0; i < passNames.size(); i++)
+        {
+            double total = 0.0;
+            for (size_t j = 0; j < passTimes[i].size(); j++)
+                total += passTimes[i][j];
+            std::cout << "  " << passNames[i] << ": " << (passTimes[i].empty() ? 0.0 : total / passTimes[i].size()) << std::endl;
+        }
+    }
+
+    void Destroy()
+    {
+        for (int i = 0; i < FRAME_LATENCY; i++)
+        {
+            for (size_t j = 0; j < frames[i].passes.size(); j++)
+                glDeleteQueries(2, frames[i].passes[j].queries);
+            frames[i].passes.clear();
+            frames[i].used = 0;
+        }
+    }
+
+private:
+    struct PassQueries {
+        const char* name;
+        GLuint queries[2];
+        // begin and end on the profiler's clock, used instead of the queries when synchronous
+        int64_t cpuTimes[2];
+    };
+
+    struct FrameQueries {
+        std::vector<PassQueries> passes;
+        size_t used;
+        FrameQueries() : used(0) {}
+    };
+
+    bool synchronous;
+    FrameQueries frames[FRAME_LATENCY];
+    int frameIndex;
+    int openPass;
+    GLint64 gpuEpoch;
+    int64_t cpuEpoch;
+    Profiler::Track* track;
+
+    // results by pass name, in the order passes were first seen
+    std::vector<std::string> passNames;
+    std::vector<std::vector<double> > passTimes;
+    std::vector<double> frameTimes;
+
+    void collect(FrameQueries& frame)
+    {
+        if (frame.used == 0)
+            return;
+        double frameMs = 0.0;
+        for (size_t i = 0; i < frame.used; i++)
+        {
+            int64_t begin, end;
+            if (synchronous)
+            {
+                begin = frame.passes[i].cpuTimes[0];
+                end = frame.passes[i].cpuTimes[1];
+            }
+            else
+            {
+                // blocks only if the GPU is more than FRAME_LATENCY frames behind
+                GLuint64 gpuBegin, gpuEnd;
+                glGetQueryObjectui64v(frame.passes[i].queries[0], GL_QUERY_RESULT, &gpuBegin);
+                glGetQueryObjectui64v(frame.passes[i].queries[1], GL_QUERY_RESULT, &gpuEnd);
+                begin = (int64_t)(gpuBegin - gpuEpoch) + cpuEpoch;
+                end = (int64_t)(gpuEnd - gpuEpoch) + cpuEpoch;
+            }
+            double ms = (end - begin) / 1000000.0;
+            frameMs += ms;
+            passTimesFor(frame.passes[i].name).push_back(ms);
+
+            if (track)
+            {
+                ProfileEvent event = { frame.passes[i].name, begin, end - begin };
+                track->events.push_back(event);
+            }
+        }
+        frameTimes.push_back(frameMs);
+        frame.used = 0;
+    }
+
+    std::vector<double>& passTimesFor(const char* name)
+    {
+        for (size_t i = 0; i < passNames.size(); i++)
+            if (passNames[i] == name)
+                return passTimes[i];
+        passNames.push_back(name);
+        passTimes.push_back(std::vector<double>());
+        return passTimes.back();
+    }
+};
+#endif
@@ -0,0 +1,186 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <glad/glad.h>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+// An offscreen OpenGL core context with no window, used to run the scene on machines without a display or GPU.
+// On Linux this uses an EGL surfaceless display, which Mesa backs with llvmpipe when no GPU is present
+// (set LIBGL_ALWAYS_SOFTWARE=1 to force it). Since there is no default framebuffer, the scene renders into an FBO.
+class HeadlessContext
+{
+public:
+    unsigned int Width;
+    unsigned int Height;
+    unsigned int FBO;
+
+    HeadlessContext() : Width(0), Height(0), FBO(0), colourRBO(0), depthRBO(0)
+    {
+#ifdef __linux__
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+#endif
+    }
+
+    // creates the context and makes it current. GL function pointers must be loaded (with GetProcAddress) before calling CreateFramebuffer
+    bool Init(int majorVersion = 3, int minorVersion = 3)
+    {
+#ifdef __linux__
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+        EGLint major, minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+        {
+            std::cout << "ERROR::HEADLESS::EGL_INITIALIZE_FAILED: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            std::cout << "ERROR::HEADLESS::EGL_OPENGL_API_UNAVAILABLE" << std::endl;
+            return false;
+        }
+
+        // surfaceless contexts don't need a config, but drivers without EGL_KHR_no_config_context still want one
+        const EGLint configAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLConfig config = NULL;
+        EGLint numConfigs = 0;
+        eglChooseConfig(display, configAttribs, &config, 1, &numConfigs);
+
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, majorVersion,
+            EGL_CONTEXT_MINOR_VERSION, minorVersion,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, numConfigs > 0 ? config : NULL, EGL_NO_CONTEXT, contextAttribs);
+        if (context == EGL_NO_CONTEXT)
+        {
+            std::cout << "ERROR::HEADLESS::EGL_CREATE_CONTEXT_FAILED: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            return false;
+        }
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+        {
+            std::cout << "ERROR::HEADLESS::EGL_MAKE_CURRENT_FAILED: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            return false;
+        }
+        return true;
+#else
+        std::cout << "ERROR::HEADLESS::UNSUPPORTED_PLATFORM: headless rendering needs EGL, which is only used on Linux" << std::endl;
+        return false;
+#endif
+    }
+
+    // loader for gladLoadGLLoader
+    static void* GetProcAddress(const char* name)
+    {
+#ifdef __linux__
+        return (void*)eglGetProcAddress(name);
+#else
+        return NULL;
+#endif
+    }
+
+    // creates the colour and depth attachments the scene renders into in place of the window's framebuffer
+    bool CreateFramebuffer(unsigned int width, unsigned int height)
+    {
+        Width = width;
+        Height = height;
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+        glGenRenderbuffers(1, &colourRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, colourRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colourRBO);
+
+        glGenRenderbuffers(1, &depthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+            return false;
+        }
+        glViewport(0, 0, width, height);
+        return true;
+    }
+
+    // stands in for swapping buffers: waits for the frame to finish so each frame costs what it would on screen
+    void EndFrame()
+    {
+        glFinish();
+    }
+
+    // writes the current contents of the framebuffer as a binary PPM
+    bool SaveImage(const std::string& path)
+    {
+        std::vector<unsigned char> pixels(Width * Height * 3);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, Width, Height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+        std::ofstream file(path.c_str(), std::ios::binary);
+        if (!file)
+        {
+            std::cout << "ERROR::HEADLESS::IMAGE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        file << "P6\n" << Width << " " << Height << "\n255\n";
+        // GL rows start at the bottom of the image
+        for (int row = Height - 1; row >= 0; row--)
+            file.write((const char*)&pixels[row * Width * 3], Width * 3);
+        file.flush();
+        if (!file)
+        {
+            std::cout << "ERROR::HEADLESS::IMAGE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void Destroy()
+    {
+        if (FBO)
+        {
+            glDeleteRenderbuffers(1, &colourRBO);
+            glDeleteRenderbuffers(1, &depthRBO);
+            glDeleteFramebuffers(1, &FBO);
+            FBO = 0;
+        }
+#ifdef __linux__
+        if (display != EGL_NO_DISPLAY)
+        {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (context != EGL_NO_CONTEXT)
+                eglDestroyContext(display, context);
+            eglTerminate(display);
+            display = EGL_NO_DISPLAY;
+            context = EGL_NO_CONTEXT;
+        }
+#endif
+    }
+
+private:
+    unsigned int colourRBO, depthRBO;
+#ifdef __linux__
+    EGLDisplay display;
+    EGLContext context;
+#endif
+};
+#endif
@@ -4,6 +4,37 @@ out vec4 FragColor;
 in float distance;
 
 in float Height;
+in vec2 WorldXZ;
+
+// see uniformblocks.h
+struct FogSettings {
+    vec4 colour;
+    float distance;
+};
+
+layout (std140) uniform Fog
+{
+    FogSettings objectFog;
+    FogSettings terrainFog;
+};
+
+// normals and ambient occlusion baked from the heightmap, see terrainlighting.h
+uniform sampler2D terrainNormals;
+uniform sampler2D terrainOcclusion;
+layout (std140) uniform TerrainLighting
+{
+    // scale and offset from world (z, x) to the baked textures' coordinates
+    vec4 mapTransform;
+    // towards the sun, and 1 if the terrain is lit or 0 if it's shaded by height alone
+    vec4 sunDirection;
+};
+
+// a normal from the upper half of an octahedron, stored as its (x, z) in 0 to 1
+vec3 decodeNormal(vec2 texel)
+{
+    vec2 xz = texel * 2.0 - 1.0;
+    return normalize(vec3(xz.x, 1.0 - abs(xz.x) - abs(xz.y), xz.y));
+}
 
 // adapted from https://learnopengl.com/Guest-Articles/2021/Tessellation/Height-map
 
@@ -11,9 +42,15 @@ void main()
 {
     float h = (((Height + 1) * 0.05) + 0.85);	// shift and scale the height in to a grayscale value
 
+    // sunlight and sky from the bake, a fetch from each texture and a dot product
+    vec2 mapCoord = WorldXZ.yx * mapTransform.xy + mapTransform.zw;
+    float diffuse = max(dot(decodeNormal(texture(terrainNormals, mapCoord).rg), sunDirection.xyz), 0.0);
+    float light = texture(terrainOcclusion, mapCoord).r * (0.6 + 0.4 * diffuse);
+    h *= mix(1.0, light, sunDirection.w);
+
     //add fog
-    vec4 fogColour = vec4(0.8, 0.8, 0.8, 1.0);
-    float fogWeighting = 1 - (1/(distance / 10));
+    vec4 fogColour = terrainFog.colour;
+    float fogWeighting = 1 - (1/(distance / terrainFog.distance));
 
     vec4 addedFog = (vec4(h,h,h,1.0) * (1 - fogWeighting)) + (fogColour * fogWeighting);
     FragColor = addedFog;//vec4(h,h,h,1.0);
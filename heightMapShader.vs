@@ -6,19 +6,33 @@ layout (location = 0) in vec3 aPos;
 out float Height;
 out vec3 Position;
 out float distance;
+// world x and z, where the fragment shader reads the baked lighting
+out vec2 WorldXZ;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform vec3 userPos;
+
+// per-frame camera state, see uniformblocks.h
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 terrainProjection;
+    vec3 cameraPos;
+};
+
+// the Snow block and snowDepth() come from snowDepth.glsl, inserted after #version by the terrain
 
 // adapted from https://learnopengl.com/Guest-Articles/2021/Tessellation/Height-map
 
 void main()
 {
-    Height = aPos.y;
-    Position = (view * model * vec4(aPos, 1.0)).xyz;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec3 pos = aPos;
+    pos.y -= snowDepth(aPos.xz);
+
+    Height = pos.y;
+    WorldXZ = pos.xz;
+    Position = (view * model * vec4(pos, 1.0)).xyz;
+    gl_Position = terrainProjection * view * model * vec4(pos, 1.0);
 
-    distance = length(userPos - aPos);
+    distance = length(cameraPos - pos);
 }
\ No newline at end of file
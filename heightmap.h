@@ -0,0 +1,273 @@
+#ifndef HEIGHTMAP_H
+#define HEIGHTMAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "stb_image.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <iostream>
+
+// Texture unit the heightmap texture stays bound to for the terrain shaders
+#define HEIGHTMAP_TEXTURE_UNIT 14
+
+// distance between samples, and the height of a channel value v, v * HEIGHTMAP_HEIGHT_SCALE - HEIGHTMAP_HEIGHT_SHIFT
+const float HEIGHTMAP_SPACING = 0.5f;
+const float HEIGHTMAP_HEIGHT_SCALE = 8.0f / 256.0f;
+const float HEIGHTMAP_HEIGHT_SHIFT = 5.0f;
+// fraction of the height span added above and below a texture's range when an edit leaves it, so the next edits fit
+const float HEIGHTMAP_EDIT_HEADROOM = 0.25f;
+
+// An inclusive rectangle of samples, such as the ones an edit changed. Empty when either last is before its first
+struct HeightmapRect
+{
+    int FirstRow, FirstColumn, LastRow, LastColumn;
+
+    HeightmapRect() : FirstRow(0), FirstColumn(0), LastRow(-1), LastColumn(-1) {}
+    HeightmapRect(int firstRow, int firstColumn, int lastRow, int lastColumn)
+        : FirstRow(firstRow), FirstColumn(firstColumn), LastRow(lastRow), LastColumn(lastColumn) {}
+
+    bool Empty() const
+    {
+        return LastRow < FirstRow || LastColumn < FirstColumn;
+    }
+};
+
+// A greyscale heightmap converted to world-space heights. Sample (row, column) sits at
+// x = (row - Rows / 2) * HEIGHTMAP_SPACING, z = (column - Columns / 2) * HEIGHTMAP_SPACING, so rows run along x and
+// columns along z and the map is centred on the origin. Heights come from the first channel of an image, read at 16
+// bits so 16-bit images keep their finer steps (an 8-bit value v reads as v * 257, the same height either way), or
+// from a square .raw or .r16 of 16-bit samples as --make-tiles takes.
+class Heightmap
+{
+public:
+    int Rows;
+    int Columns;
+    // Rows * Columns heights, row by row
+    std::vector<float> Heights;
+
+    Heightmap() : Rows(0), Columns(0) {}
+
+    bool Load(const std::string& path)
+    {
+        PROFILE_SCOPE("Heightmap::Load");
+        if (isRaw(path))
+            return loadRaw(path);
+        stbi_set_flip_vertically_on_load(true);
+        int width, height, nrChannels;
+        unsigned short* data = stbi_load_16(path.c_str(), &width, &height, &nrChannels, 0);
+        if (!data)
+        {
+            std::cout << "ERROR::HEIGHTMAP::FILE_NOT_LOADED: " << path << std::endl;
+            return false;
+        }
+        Rows = height;
+        Columns = width;
+        Heights.resize((size_t)Rows * Columns);
+        for (int i = 0; i < Rows; i++)
+            for (int j = 0; j < Columns; j++)
+                Heights[(size_t)i * Columns + j] = texelHeight(data[((size_t)i * Columns + j) * nrChannels]);
+        stbi_image_free(data);
+        std::cout << "Loaded heightmap of size " << Rows << " x " << Columns << std::endl;
+        return true;
+    }
+
+    // Writes the heights as a square headerless file of little-endian 16-bit samples (.raw or .r16), row 0 first,
+    // which Load and --make-tiles read back. Heights are clamped to the range an 8-bit image covers
+    bool Save(const std::string& path) const
+    {
+        PROFILE_SCOPE("Heightmap::Save");
+        if (!isRaw(path) || Rows != Columns)
+        {
+            std::cout << "ERROR::HEIGHTMAP::NOT_SAVED: " << path << " needs to be a .raw or .r16 and the map square" << std::endl;
+            return false;
+        }
+        std::ofstream out(path.c_str(), std::ios::binary);
+        std::vector<unsigned char> line((size_t)Columns * 2);
+        for (int i = 0; i < Rows && out; i++)
+        {
+            for (int j = 0; j < Columns; j++)
+            {
+                float texel = (Heights[(size_t)i * Columns + j] + HEIGHTMAP_HEIGHT_SHIFT) / HEIGHTMAP_HEIGHT_SCALE * 257.0f + 0.5f;
+                unsigned short value = (unsigned short)std::min(std::max(texel, 0.0f), 65535.0f);
+                line[j * 2] = (unsigned char)(value & 255);
+                line[j * 2 + 1] = (unsigned char)(value >> 8);
+            }
+            out.write((const char*)&line[0], line.size());
+        }
+        if (!out)
+        {
+            std::cout << "ERROR::HEIGHTMAP::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        std::cout << "Saved heightmap of size " << Rows << " x " << Columns << " to " << path << std::endl;
+        return true;
+    }
+
+    // height of a sample, clamped to the edge of the map
+    float At(int row, int column) const
+    {
+        row = std::min(std::max(row, 0), Rows - 1);
+        column = std::min(std::max(column, 0), Columns - 1);
+        return Heights[(size_t)row * Columns + column];
+    }
+
+    glm::vec3 Position(int row, int column) const
+    {
+        return glm::vec3((row - Rows / 2.0f) * HEIGHTMAP_SPACING, At(row, column), (column - Columns / 2.0f) * HEIGHTMAP_SPACING);
+    }
+
+    // world x and z of a (fractional) sample position, and back
+    float RowToX(float row) const
+    {
+        return (row - Rows / 2.0f) * HEIGHTMAP_SPACING;
+    }
+    float ColumnToZ(float column) const
+    {
+        return (column - Columns / 2.0f) * HEIGHTMAP_SPACING;
+    }
+    float XToRow(float x) const
+    {
+        return x / HEIGHTMAP_SPACING + Rows / 2.0f;
+    }
+    float ZToColumn(float z) const
+    {
+        return z / HEIGHTMAP_SPACING + Columns / 2.0f;
+    }
+
+    // bilinearly interpolated height at a world position, clamped to the map
+    float HeightAt(float x, float z) const
+    {
+        float row = std::min(std::max(XToRow(x), 0.0f), (float)(Rows - 1));
+        float column = std::min(std::max(ZToColumn(z), 0.0f), (float)(Columns - 1));
+        int r = std::min((int)row, Rows - 2 < 0 ? 0 : Rows - 2);
+        int c = std::min((int)column, Columns - 2 < 0 ? 0 : Columns - 2);
+        float fr = row - r, fc = column - c;
+        float top = At(r, c) * (1.0f - fc) + At(r, c + 1) * fc;
+        float bottom = At(r + 1, c) * (1.0f - fc) + At(r + 1, c + 1) * fc;
+        return top * (1.0f - fr) + bottom * fr;
+    }
+
+    // lowest and highest height of the samples in [row0, row1] x [column0, column1], clamped to the map
+    void MinMax(int row0, int column0, int row1, int column1, float& low, float& high) const
+    {
+        row0 = std::max(row0, 0);
+        column0 = std::max(column0, 0);
+        row1 = std::min(row1, Rows - 1);
+        column1 = std::min(column1, Columns - 1);
+        low = 1e30f;
+        high = -1e30f;
+        for (int i = row0; i <= row1; i++)
+        {
+            for (int j = column0; j <= column1; j++)
+            {
+                float h = Heights[(size_t)i * Columns + j];
+                low = std::min(low, h);
+                high = std::max(high, h);
+            }
+        }
+    }
+
+    // A single channel 16-bit texture of the heights, texel (column, row), each quantised between the lowest and
+    // highest height, which are returned in range. Shaders get a height back as mix(range.x, range.y, texel), so a
+    // sample costs 2 bytes of GPU memory where a vertex with its position would cost 12
+    unsigned int CreateTexture(glm::vec2& range) const
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, Columns, Rows, 0, GL_RED, GL_UNSIGNED_SHORT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        UpdateTexture(texture, range);
+        return texture;
+    }
+
+    // Uploads the heights again to a texture made by CreateTexture for a heightmap of the same size. headroom widens
+    // the range by that fraction of the height span above and below, for heights that are being edited
+    void UpdateTexture(unsigned int texture, glm::vec2& range, float headroom = 0.0f) const
+    {
+        MinMax(0, 0, Rows - 1, Columns - 1, range.x, range.y);
+        float margin = (range.y - range.x) * headroom;
+        range += glm::vec2(-margin, margin);
+        if (range.y <= range.x)
+            range.y = range.x + 65535.0f;
+        uploadTexels(texture, range, HeightmapRect(0, 0, Rows - 1, Columns - 1));
+    }
+
+    // Uploads just the samples in rect to a texture made by CreateTexture, quantised to the range it already has.
+    // False, uploading nothing, if any of them is outside that range, when the whole texture needs UpdateTexture
+    bool UpdateTextureRegion(unsigned int texture, const glm::vec2& range, const HeightmapRect& rect) const
+    {
+        float low, high;
+        MinMax(rect.FirstRow, rect.FirstColumn, rect.LastRow, rect.LastColumn, low, high);
+        if (low < range.x || high > range.y)
+            return false;
+        uploadTexels(texture, range, rect);
+        return true;
+    }
+
+private:
+    void uploadTexels(unsigned int texture, const glm::vec2& range, const HeightmapRect& rect) const
+    {
+        int width = rect.LastColumn - rect.FirstColumn + 1, height = rect.LastRow - rect.FirstRow + 1;
+        float step = (range.y - range.x) / 65535.0f;
+        std::vector<unsigned short> texels((size_t)width * height);
+        for (int i = 0; i < height; i++)
+        {
+            const float* row = &Heights[(size_t)(rect.FirstRow + i) * Columns + rect.FirstColumn];
+            unsigned short* out = &texels[(size_t)i * width];
+            for (int j = 0; j < width; j++)
+                out[j] = (unsigned short)((row[j] - range.x) / step + 0.5f);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.FirstColumn, rect.FirstRow, width, height, GL_RED, GL_UNSIGNED_SHORT, &texels[0]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    static bool isRaw(const std::string& path)
+    {
+        std::string extension = path.substr(path.find_last_of('.') + 1);
+        return extension == "raw" || extension == "r16";
+    }
+
+    // 16-bit texel t is the height of 8-bit value t / 257
+    static float texelHeight(unsigned short texel)
+    {
+        return texel / 257.0f * HEIGHTMAP_HEIGHT_SCALE - HEIGHTMAP_HEIGHT_SHIFT;
+    }
+
+    bool loadRaw(const std::string& path)
+    {
+        std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+        size_t size = in ? (size_t)in.tellg() : 0;
+        int side = (int)std::sqrt((double)(size / 2));
+        if (size == 0 || (size_t)side * side * 2 != size)
+        {
+            std::cout << "ERROR::HEIGHTMAP::RAW_NOT_SQUARE: " << path << std::endl;
+            return false;
+        }
+        std::vector<unsigned char> data(size);
+        in.seekg(0);
+        in.read((char*)&data[0], size);
+        Rows = Columns = side;
+        Heights.resize((size_t)side * side);
+        for (size_t i = 0; i < Heights.size(); i++)
+            Heights[i] = texelHeight((unsigned short)(data[i * 2] | data[i * 2 + 1] << 8));
+        std::cout << "Loaded heightmap of size " << Rows << " x " << Columns << std::endl;
+        return true;
+    }
+};
+#endif
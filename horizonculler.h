@@ -0,0 +1,245 @@
+#ifndef HORIZON_CULLER_H
+#define HORIZON_CULLER_H
+
+#include <glm/glm.hpp>
+
+#include "heightmap.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// samples along each side of the blocks the terrain's silhouette is made of
+const int HORIZON_BLOCK_SIZE = 8;
+// directions around the camera the horizon is kept for
+const int HORIZON_BINS = 1024;
+// distances from the camera the horizon is kept at: the first, then each HORIZON_BAND_RATIO times the last
+const int HORIZON_BANDS = 24;
+const float HORIZON_FIRST_BAND = 1.0f;
+const float HORIZON_BAND_RATIO = 1.25f;
+
+// CPU horizon culling. Once per heightmap the terrain is cut into HORIZON_BLOCK_SIZE sample blocks, each kept as its
+// footprint and its lowest height: the ground is at least that high everywhere over the block, so a sight line that
+// crosses the footprint below it is blocked. Each frame Build rasterises every block into a horizon around the
+// camera, HORIZON_BINS directions wide, holding the steepest slope (height over horizontal distance) below which the
+// blocks hide everything behind them. A box is then hidden if, in every direction it covers, its top is below the
+// horizon made only of blocks nearer than the box, so it can't be hidden by terrain behind it. To keep that cheap
+// without sorting, the horizon is kept at HORIZON_BANDS distances, each holding the blocks that end before it.
+//
+// Every test is conservative: blocks count only in the directions they cover completely, boxes in every direction
+// they touch, and both use the distances that favour the box being seen. A box that could be seen is never culled,
+// and a hidden box may sometimes still be drawn. IsOccluded is const and can be called from any thread once Build
+// returns.
+class HorizonCuller
+{
+public:
+    // how far below the heightmap the drawn ground can be, such as the deepest snow trail, which the blocks' lowest
+    // heights are lowered by. Set before Update
+    float Sink;
+
+    HorizonCuller() : Sink(0.0f), rows(0), columns(0), blockColumns(0), eye(0.0f)
+    {
+        for (int band = 0; band < HORIZON_BANDS; band++)
+            bandDistances[band] = HORIZON_FIRST_BAND * std::pow(HORIZON_BAND_RATIO, (float)band);
+    }
+
+    // cuts a heightmap into blocks. An empty heightmap (as with the paged terrain) has none and hides nothing
+    void Update(const Heightmap& heightmap)
+    {
+        PROFILE_SCOPE("HorizonCuller::Update");
+        rows = heightmap.Rows;
+        columns = heightmap.Columns;
+        blocks.clear();
+        blockColumns = columns > 1 ? (columns - 2) / HORIZON_BLOCK_SIZE + 1 : 0;
+        for (int row = 0; row + 1 < rows; row += HORIZON_BLOCK_SIZE)
+        {
+            for (int column = 0; column + 1 < columns; column += HORIZON_BLOCK_SIZE)
+            {
+                int endRow = std::min(row + HORIZON_BLOCK_SIZE, rows - 1), endColumn = std::min(column + HORIZON_BLOCK_SIZE, columns - 1);
+                Block block;
+                float high;
+                heightmap.MinMax(row, column, endRow, endColumn, block.lowest, high);
+                block.lowest -= Sink;
+                block.low = glm::vec2((row - rows / 2.0f) * HEIGHTMAP_SPACING, (column - columns / 2.0f) * HEIGHTMAP_SPACING);
+                block.high = glm::vec2((endRow - rows / 2.0f) * HEIGHTMAP_SPACING, (endColumn - columns / 2.0f) * HEIGHTMAP_SPACING);
+                blocks.push_back(block);
+            }
+        }
+        horizon.assign((size_t)HORIZON_BANDS * HORIZON_BINS, -1e30f);
+    }
+
+    // the lowest heights of the blocks over an edited rect of a heightmap of the same size
+    void UpdateRegion(const Heightmap& heightmap, const HeightmapRect& rect)
+    {
+        if (heightmap.Rows != rows || heightmap.Columns != columns)
+        {
+            Update(heightmap);
+            return;
+        }
+        int blockRows = blockColumns > 0 ? (int)blocks.size() / blockColumns : 0;
+        // a sample on the edge between two blocks is in both
+        for (int row = std::max(rect.FirstRow - 1, 0) / HORIZON_BLOCK_SIZE; row <= std::min(rect.LastRow / HORIZON_BLOCK_SIZE, blockRows - 1); row++)
+        {
+            for (int column = std::max(rect.FirstColumn - 1, 0) / HORIZON_BLOCK_SIZE; column <= std::min(rect.LastColumn / HORIZON_BLOCK_SIZE, blockColumns - 1); column++)
+            {
+                float high;
+                float& lowest = blocks[(size_t)row * blockColumns + column].lowest;
+                heightmap.MinMax(row * HORIZON_BLOCK_SIZE, column * HORIZON_BLOCK_SIZE, (row + 1) * HORIZON_BLOCK_SIZE, (column + 1) * HORIZON_BLOCK_SIZE, lowest, high);
+                lowest -= Sink;
+            }
+        }
+    }
+
+    // the horizon around the camera, once a frame before any IsOccluded
+    void Build(const glm::vec3& cameraPos)
+    {
+        PROFILE_SCOPE("HorizonCuller::Build");
+        eye = cameraPos;
+        std::fill(horizon.begin(), horizon.end(), -1e30f);
+        // a block is only part of a band if its far side is nearer than the band, so only the window of blocks
+        // within the farthest band of the camera is visited, whatever the size of the map
+        float reach = bandDistances[HORIZON_BANDS - 1];
+        int blockRows = blockColumns > 0 ? (int)blocks.size() / blockColumns : 0;
+        int firstRow, lastRow, firstColumn, lastColumn;
+        blockWindow(eye.x, reach, rows, blockRows, firstRow, lastRow);
+        blockWindow(eye.z, reach, columns, blockColumns, firstColumn, lastColumn);
+        glm::vec2 camera(eye.x, eye.z);
+        for (int row = firstRow; row <= lastRow; row++)
+        {
+            for (int column = firstColumn; column <= lastColumn; column++)
+            {
+                const Block& block = blocks[(size_t)row * blockColumns + column];
+                // the farthest corner, before the angles footprint works out
+                glm::vec2 farCorner = glm::max(glm::abs(block.low - camera), glm::abs(block.high - camera));
+                if (glm::dot(farCorner, farCorner) > reach * reach)
+                    continue;
+                addBlock(block);
+            }
+        }
+        // each band also holds the blocks of every nearer band
+        for (int band = 1; band < HORIZON_BANDS; band++)
+        {
+            float* bins = &horizon[(size_t)band * HORIZON_BINS];
+            const float* nearer = &horizon[(size_t)(band - 1) * HORIZON_BINS];
+            for (int bin = 0; bin < HORIZON_BINS; bin++)
+                bins[bin] = std::max(bins[bin], nearer[bin]);
+        }
+    }
+
+    // whether the terrain hides the whole of the world-space box [low, high] from the camera given to Build
+    bool IsOccluded(const glm::vec3& low, const glm::vec3& high) const
+    {
+        if (blocks.empty())
+            return false;
+        float nearest, farthest;
+        int firstBin, lastBin;
+        if (!footprint(glm::vec2(low.x, low.z), glm::vec2(high.x, high.z), nearest, farthest, firstBin, lastBin))
+            return false;
+        // the farthest band wholly in front of the box
+        int band = -1;
+        while (band + 1 < HORIZON_BANDS && bandDistances[band + 1] <= nearest)
+            band++;
+        if (band < 0)
+            return false;
+        // the steepest slope of a sight line to the top of the box
+        float rise = high.y - eye.y;
+        float slope = rise / (rise > 0.0f ? nearest : farthest);
+        const float* bins = &horizon[(size_t)band * HORIZON_BINS];
+        for (int bin = firstBin; bin <= lastBin; bin++)
+            if (slope >= bins[wrapBin(bin)])
+                return false;
+        return true;
+    }
+
+private:
+    struct Block
+    {
+        // footprint in world x and z, and the lowest height over it
+        glm::vec2 low, high;
+        float lowest;
+    };
+    int rows, columns;
+    // blocks row by row, blockColumns to a row
+    std::vector<Block> blocks;
+    int blockColumns;
+    glm::vec3 eye;
+    float bandDistances[HORIZON_BANDS];
+    // HORIZON_BINS slopes for each band
+    std::vector<float> horizon;
+
+    // The blocks along one axis of the map (samples long, count blocks) that come within reach of the world
+    // coordinate centre, one block wider each side for rounding. last < first when there are none
+    static void blockWindow(float centre, float reach, int samples, int count, int& first, int& last)
+    {
+        float low = ((centre - reach) / HEIGHTMAP_SPACING + samples / 2.0f) / HORIZON_BLOCK_SIZE - 1.0f;
+        float high = ((centre + reach) / HEIGHTMAP_SPACING + samples / 2.0f) / HORIZON_BLOCK_SIZE + 1.0f;
+        // clamped before the conversion, which a camera far off the map would overflow
+        first = (int)std::min(std::max(std::floor(low), 0.0f), (float)count);
+        last = (int)std::max(std::min(std::floor(high), (float)count - 1.0f), -1.0f);
+    }
+
+    // draws a block into the band its far side is nearer than
+    void addBlock(const Block& block)
+    {
+        float nearest, farthest;
+        int firstBin, lastBin;
+        if (!footprint(block.low, block.high, nearest, farthest, firstBin, lastBin))
+            return;
+        // the band of the blocks nearer than the band's distance, which the block is only part of past its far side
+        int band = 0;
+        while (band < HORIZON_BANDS && bandDistances[band] < farthest)
+            band++;
+        if (band == HORIZON_BANDS)
+            return;
+        // the shallowest slope of a sight line under the block's lowest height anywhere over it
+        float rise = block.lowest - eye.y;
+        float slope = rise / (rise > 0.0f ? farthest : nearest);
+        // only the directions the block covers from side to side
+        float* bins = &horizon[(size_t)band * HORIZON_BINS];
+        for (int bin = firstBin + 1; bin < lastBin; bin++)
+        {
+            float& value = bins[wrapBin(bin)];
+            value = std::max(value, slope);
+        }
+    }
+
+    static int wrapBin(int bin)
+    {
+        return (bin % HORIZON_BINS + HORIZON_BINS) % HORIZON_BINS;
+    }
+
+    // The nearest and farthest horizontal distance from the camera to the rectangle [low, high] of world x and z,
+    // and the bins of the directions its corners are in, lastBin not wrapped so firstBin <= lastBin. False if the
+    // camera is over the rectangle, when it's in every direction
+    bool footprint(const glm::vec2& low, const glm::vec2& high, float& nearest, float& farthest, int& firstBin, int& lastBin) const
+    {
+        glm::vec2 camera(eye.x, eye.z);
+        glm::vec2 closest = glm::min(glm::max(camera, low), high);
+        nearest = glm::length(closest - camera);
+        if (nearest <= 0.0f)
+            return false;
+        glm::vec2 centre = (low + high) * 0.5f - camera;
+        float centreAngle = std::atan2(centre.y, centre.x);
+        float lowest = 0.0f, highest = 0.0f;
+        farthest = 0.0f;
+        for (int corner = 0; corner < 4; corner++)
+        {
+            glm::vec2 offset = glm::vec2(corner & 1 ? high.x : low.x, corner & 2 ? high.y : low.y) - camera;
+            farthest = std::max(farthest, glm::length(offset));
+            // relative to the centre's direction, which a rectangle the camera isn't over spans less than half a turn either side of
+            float angle = std::atan2(offset.y, offset.x) - centreAngle;
+            if (angle > 3.14159265f)
+                angle -= 6.28318531f;
+            else if (angle < -3.14159265f)
+                angle += 6.28318531f;
+            lowest = std::min(lowest, angle);
+            highest = std::max(highest, angle);
+        }
+        const float binsPerRadian = HORIZON_BINS / 6.28318531f;
+        firstBin = (int)std::floor((centreAngle + lowest) * binsPerRadian);
+        lastBin = (int)std::floor((centreAngle + highest) * binsPerRadian);
+        return true;
+    }
+};
+#endif
@@ -12,25 +12,72 @@
 #include "stb_image.h"
 
 #include "model.h"
+#include "headless.h"
+#include "options.h"
+#include "benchmark.h"
+#include "camerapath.h"
+#include "profiler.h"
+#include "gpuprofiler.h"
+#include "glcounters.h"
+#include "uniformblocks.h"
+#include "crowd.h"
+#include "materials.h"
+#include "terrain.h"
+#include "pulledterrain.h"
+#include "cdlodterrain.h"
+#include "pagedterrain.h"
+#include "proceduraltiles.h"
+#include "tessellatedterrain.h"
+#include "clipmapterrain.h"
+#include "rtinterrain.h"
+#include "terrainquery.h"
+#include "horizonculler.h"
+#include "terrainedit.h"
+#include "erosion.h"
+#include "snowtrails.h"
+#include "terrainlighting.h"
 
 #include <iostream>
+#include <chrono>
 
 //adapted from https://learnopengl.com/Getting-started/Camera
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void processInput(GLFWwindow* window);
 
-// settings
-const unsigned int SCR_WIDTH = 800;
-const unsigned int SCR_HEIGHT = 600;
+// settings (overridden by --width and --height)
+unsigned int SCR_WIDTH = 800;
+unsigned int SCR_HEIGHT = 600;
 
 int useWireframe = 0;
 int displayGrayscale = 0;
 
+// set by F5, reloads the heightmap file into the terrain at the start of the next frame
+bool reloadHeightmap = false;
+// set by F6, swaps between the chosen terrain mode and strips at the start of the next frame
+bool switchTerrain = false;
+// set by F7 and F8 to halve or double the terrain's error tolerance at the start of the next frame
+float terrainErrorChange = 1.0f;
+// set by F9, prints where the centre of the view meets the terrain at the start of the next frame
+bool pickTerrain = false;
+// the brush held down with 1 to 4 (raise, lower, smooth, flatten, see terrainedit.h), or -1 for none
+int heldBrush = -1;
+
 // camera
 Camera camera(glm::vec3(0.0f, 1.0f, 3.0f));
+// how far above the terrain the camera is kept while flying with the keyboard and mouse
+const float CAMERA_GROUND_CLEARANCE = 0.5f;
+// farthest the F9 pick looks along the view
+const float TERRAIN_PICK_DISTANCE = 1000.0f;
+// world units across the middle of the editing brush, and how fast it works
+const float TERRAIN_BRUSH_RADIUS = 3.0f;
+const float TERRAIN_BRUSH_STRENGTH = 2.0f;
+// a generous world-space box around the tree, for horizon culling
+const glm::vec3 TREE_BOUNDS_LOW(-3.0f, -0.5f, -3.0f);
+const glm::vec3 TREE_BOUNDS_HIGH(3.0f, 6.0f, 3.0f);
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
@@ -47,6 +94,7 @@ glm::vec3 snowman1Pos(0.0f, 0.0f, 0.0f);
 glm::vec3 snowman1Direction(0.0f, 0.0f, 0.0f);
 float snowman1DirectionRadians = 0;
 
+// where the first five snowmen start, the rest of a larger crowd stands around them (see SnowmanCrowd::Populate)
 glm::vec3 snowmanStartPositions[] = {
       glm::vec3(-8.0f, 0.0f, -16.0f),
       glm::vec3(8.0f, 0.0f, -16.0f),
@@ -55,17 +103,11 @@ glm::vec3 snowmanStartPositions[] = {
       glm::vec3(8.0f, 0.0f, 16.0f),
 };
 
-glm::vec3 snowmanPositions[] = {
-      glm::vec3(-8.0f, 0.0f, -16.0f),
-      glm::vec3(8.0f, 0.0f, -16.0f),
-      glm::vec3(-8.0f, 0.0f, 16.0f),
-      glm::vec3(0.0f, 0.0f, 16.0f),
-      glm::vec3(8.0f, 0.0f, 16.0f),
-};
-
 //material data adapted from http://devernay.free.fr/cours/opengl/materials.html
 
-float snowmanMaterials[5][10] = {
+const int SNOWMAN_MATERIAL_COUNT = 5;
+
+float snowmanMaterials[SNOWMAN_MATERIAL_COUNT][10] = {
     {0.1f, 0.18725f, 0.1745f, 0.396f, 0.74151f, 0.69102f, 0.297254f, 0.30829f, 0.306678f, 0.1f}, //turquoise
     {0.329412f, 0.223529f, 0.027451f, 0.780392f, 0.568627f, 0.113725f, 0.992157f,	0.941176f, 0.807843f, 0.21794872f}, //brass
     {0.19225f, 0.19225f, 0.19225f, 0.50754f, 0.50754f, 0.50754f, 0.508273f,	0.508273f, 0.508273f, 0.4f}, //silver
@@ -107,6 +149,58 @@ unsigned int loadCubemap(vector<std::string> faces)
     return textureID;
 }
 
+// the erosion settings the options ask for
+ErosionSettings erosionSettings(const AppOptions& options)
+{
+    ErosionSettings settings;
+    settings.Seed = options.seed;
+    settings.Droplets = options.erosionDroplets;
+    settings.Threads = (unsigned int)options.erosionThreads;
+    return settings;
+}
+
+// loads the heightmap the options name, eroded first if they ask for it
+bool loadHeightmap(Heightmap& heightmap, const AppOptions& options)
+{
+    if (!heightmap.Load(options.heightmapPath))
+        return false;
+    if (options.erode)
+    {
+        HeightmapErosion erosion;
+        erosion.Settings = erosionSettings(options);
+        erosion.Erode(heightmap);
+    }
+    return true;
+}
+
+// the exit code of a tool run from the command line instead of the scene (--make-tiles and the like), once the trace
+// of what it did is written for --trace
+int toolExitCode(bool succeeded, const AppOptions& options)
+{
+#if PROFILER_ENABLED
+    if (!options.tracePath.empty())
+        Profiler::Get().WriteTrace(options.tracePath);
+#endif
+    return succeeded ? 0 : -1;
+}
+
+// a terrain renderer of the given mode, Init still to be called. loader is what glad was loaded with
+TerrainRenderer* createTerrain(Terrain_Mode mode, const AppOptions& options, GLADloadproc loader)
+{
+    switch (mode)
+    {
+    case TERRAIN_PAGED: return new PagedTerrain(new TiledHeightmap(options.heightmapPath), (size_t)options.tileCacheMB << 20, (size_t)options.tileGpuMB << 20);
+    case TERRAIN_PROCEDURAL: return new PagedTerrain(new ProceduralTiles(options.seed), (size_t)options.tileCacheMB << 20, (size_t)options.tileGpuMB << 20);
+    case TERRAIN_CDLOD: return new CdlodTerrain();
+    case TERRAIN_PULLED: return new PulledTerrain();
+    case TERRAIN_TESSELLATED: return new TessellatedTerrain(loader, (float)SCR_HEIGHT, options.tessPixels);
+    case TERRAIN_CLIPMAP: return new ClipmapTerrain();
+    case TERRAIN_RTIN: return new RtinTerrain(options.rtinError);
+    default: break;
+    }
+    return new StripTerrain();
+}
+
 float skyboxVertices[] = {
     // positions          
     -1.0f,  1.0f, -1.0f,
@@ -152,39 +246,120 @@ float skyboxVertices[] = {
      1.0f, -1.0f,  1.0f
 };
 
-int main()
+int main(int argc, char* argv[])
 {
+    // constructed first so startup time covers context creation and loading
+    FrameBenchmark benchmark;
+
+    AppOptions options;
+    if (!parseOptions(argc, argv, options))
+        return options.help ? 0 : -1;
+    Terrain_Mode terrainMode;
+    if (!parseTerrainMode(options.terrain, terrainMode))
+    {
+        std::cout << "Unknown terrain mode: " << options.terrain << std::endl;
+        printUsage(argv[0]);
+        return -1;
+    }
+    // before the tools, so --trace times them too
+    if (!options.tracePath.empty())
+    {
+#if PROFILER_ENABLED
+        Profiler::Get().Enabled = true;
+#else
+        std::cout << "Profiler is compiled out of this build, --trace ignored (define PROFILER_ENABLED=1)" << std::endl;
+#endif
+    }
+
+    if (options.terrainBuildBenchmark > 0)
+        return toolExitCode(runTerrainBuildBenchmark(options.terrainBuildBenchmark, options.benchmarkOutputPath), options);
+    if (!options.makeTilesPath.empty())
+        return toolExitCode(writeTiledHeightmap(options.heightmapPath, options.makeTilesPath), options);
+    if (!options.erodeOutputPath.empty())
+        return toolExitCode(writeErodedHeightmap(options.heightmapPath, options.erodeOutputPath, erosionSettings(options)), options);
+    benchmark.Enabled = options.benchmark;
+
+    SCR_WIDTH = options.width;
+    SCR_HEIGHT = options.height;
+
+    GLFWwindow* window = NULL;
+    HeadlessContext headless;
+    // ends the context when main returns, after the shaders and everything else that deletes GL objects as it goes
+    struct ContextGuard
+    {
+        HeadlessContext& Headless;
+        bool Windowed;
+        ~ContextGuard()
+        {
+            if (Windowed)
+                glfwTerminate();
+            else
+                Headless.Destroy();
+        }
+    } contextGuard = { headless, !options.headless };
 
-    //adapted from https://learnopengl.com/Getting-started/Hello-Window
+    PROFILE_BEGIN(contextZone, "Create context");
 
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (options.headless)
+    {
+        // tessellation shaders are core from GL 4.0
+        if (terrainMode == TERRAIN_TESSELLATED ? !headless.Init(4, 0) : !headless.Init())
+            return -1;
+
+        if (!gladLoadGLLoader((GLADloadproc)HeadlessContext::GetProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
+
+        if (!headless.CreateFramebuffer(SCR_WIDTH, SCR_HEIGHT))
+            return -1;
+
+        std::cout << "Rendering headless at " << SCR_WIDTH << " x " << SCR_HEIGHT << " with " << glGetString(GL_RENDERER) << std::endl;
+    }
+    else
+    {
+        //adapted from https://learnopengl.com/Getting-started/Hello-Window
+
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, terrainMode == TERRAIN_TESSELLATED ? 4 : 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, terrainMode == TERRAIN_TESSELLATED ? 0 : 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Winter Wonderland", NULL, NULL);
-    if (window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Winter Wonderland", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-    {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
+
+        // don't let vsync cap the benchmark
+        if (options.benchmark)
+            glfwSwapInterval(0);
     }
+    PROFILE_END(contextZone);
+
+    // installed before anything else touches GL so the counters see the whole program's state
+    if (options.glCounters)
+        GLCounters::Get().Install();
 
 
     stbi_set_flip_vertically_on_load(true);
@@ -196,6 +371,7 @@ int main()
     //adapted from https://learnopengl.com/Advanced-OpenGL/Cubemaps
 
 
+    PROFILE_BEGIN(skyboxZone, "Load skybox");
     unsigned int skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
@@ -215,23 +391,71 @@ int main()
             "back.jpg"
     };
     unsigned int cubemapTexture = loadCubemap(faces);
+    PROFILE_END(skyboxZone);
 
     //adapted from https://learnopengl.com/Getting-started/Shaders
 
+    PROFILE_BEGIN(shaderZone, "Compile shaders");
     Shader ourShader("shader.vs", "shader.fs");
     Shader lightShader("lightshader.vs", "lightshader.fs");
     Shader colouredLightShader("colouredlightshader.vs", "colouredlightshader.fs");
     Shader skyboxShader("skyboxshader.vs", "skyboxshader.fs");
-    Shader heightMapShader("heightMapShader.vs", "heightMapShader.fs");
+    // ourShader's variant for the instanced crowd, which takes each snowman's model matrix and material from its instance data
+    Shader instancedShader("shader.vs", "shader.fs", "#define INSTANCED\n");
+
+    // camera, lights and fog are shared by every program through uniform blocks, written once per frame
+    Shader* blockShaders[] = { &ourShader, &lightShader, &colouredLightShader, &skyboxShader, &instancedShader };
+    for (int i = 0; i < 5; i++)
+    {
+        blockShaders[i]->bindBlock("Camera", CAMERA_BLOCK_BINDING);
+        blockShaders[i]->bindBlock("Lights", LIGHTS_BLOCK_BINDING);
+        blockShaders[i]->bindBlock("Fog", FOG_BLOCK_BINDING);
+    }
+    UniformBlock<CameraBlock> cameraBlock;
+    UniformBlock<LightsBlock> lightsBlock;
+    UniformBlock<FogBlock> fogBlock;
+    cameraBlock.Init(CAMERA_BLOCK_BINDING);
+    lightsBlock.Init(LIGHTS_BLOCK_BINDING);
+    fogBlock.Init(FOG_BLOCK_BINDING);
+
+    // uniform handles for per-draw state, resolved once here so the render loop doesn't look names up
+    const Uniform<int> ourMaterialIndex = ourShader.uniform<int>("materialIndex");
+    const Uniform<float> ourAlpha = ourShader.uniform<float>("alpha");
+    const Uniform<glm::mat4> ourModelMatrix = ourShader.uniform<glm::mat4>("model");
+    const Uniform<glm::mat4> lightModel = lightShader.uniform<glm::mat4>("model");
+    const Uniform<int> skyboxSampler = skyboxShader.uniform<int>("skybox");
+
+    // all materials live in one table that draws and instances index into, see materials.h
+    MaterialTable materialTable;
+    materialTable.Init();
+    std::vector<int> snowmanMaterialIndices;
+    for (int i = 0; i < SNOWMAN_MATERIAL_COUNT; i++)
+        snowmanMaterialIndices.push_back(materialTable.Add(snowmanMaterials[i]));
+    materialTable.Upload();
+
+    ourShader.use();
+    ourShader.setInt("materialTable", MATERIAL_TEXTURE_UNIT);
+    // the instanced shader's alpha never changes, so it is set once
+    instancedShader.use();
+    instancedShader.setInt("materialTable", MATERIAL_TEXTURE_UNIT);
+    instancedShader.setFloat("alpha", 1.0f);
+    PROFILE_END(shaderZone);
 
     //adapted from https://learnopengl.com/Model-Loading/Model
 
+    PROFILE_BEGIN(modelZone, "Load models");
     Model ourModel("C:/Users/david/source/repos/GraphicsProject/objects/snowman/snowman.obj");
     Model stick1("C:/Users/david/source/repos/GraphicsProject/objects/snowman/stick.obj");
 
     Model lightball("C:/Users/david/source/repos/GraphicsProject/objects/snowman/stick.obj");
 
     Model tree("C:/Users/david/source/repos/GraphicsProject/objects/tree/tree.obj");
+    PROFILE_END(modelZone);
+
+    SnowmanCrowd crowd;
+    crowd.Populate(snowmanStartPositions, 5, options.snowmen, snowmanMaterialIndices);
+    if (options.instancing)
+        crowd.InitInstances(ourModel, stick1);
 
 
     float arm_swing = 0.0f;
@@ -241,85 +465,193 @@ int main()
 
     //adapted from https://learnopengl.com/Guest-Articles/2021/Tessellation/Height-map
 
-    stbi_set_flip_vertically_on_load(true);
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load("heightmap.png", &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        std::cout << "Loaded heightmap of size " << height << " x " << width << std::endl;
-    }
+    // the paged terrains read their own tiles, so the whole map is never loaded
+    Heightmap heightmap;
+    if (!isPagedTerrain(terrainMode) && !loadHeightmap(heightmap, options))
+        return -1;
+    GLADloadproc loader = options.headless ? (GLADloadproc)HeadlessContext::GetProcAddress : (GLADloadproc)glfwGetProcAddress;
+    std::unique_ptr<TerrainRenderer> terrain(createTerrain(terrainMode, options, loader));
+    if (!terrain->Init(heightmap))
+        return -1;
+    // F6 compares the chosen mode with strips on the same view, and reports on whichever is drawn at the end
+    Terrain_Mode drawnTerrainMode = terrainMode;
+    float terrainError = options.rtinError;
+
+    // ground heights for the snowmen and the camera, in the same place as the terrain drawn. The paged terrains'
+    // come from their tile source
+    TerrainQuery terrainQuery;
+    if (isPagedTerrain(terrainMode))
+        terrainQuery.UpdateTiles(terrain->Tiles());
     else
+        terrainQuery.Update(heightmap);
+    crowd.Ground(terrainQuery);
+
+    // the horizon and the baked lighting are built from the whole heightmap, which the paged terrains never load
+    bool wholeHeightmap = !isPagedTerrain(terrainMode);
+    if (!wholeHeightmap && (options.horizonCulling || options.terrainLighting))
+        std::cout << "Horizon culling and baked lighting aren't available with " << terrainModeName(terrainMode) << " terrain, turning them off" << std::endl;
+
+    // the terrain's silhouette, which the snowmen, the tree and the terrain's chunks hidden behind hills are dropped with
+    HorizonCuller horizon;
+    horizon.Sink = SNOW_TRAIL_DEPTH;
+    horizon.Update(heightmap);
+    const HorizonCuller* occlusion = options.horizonCulling && wholeHeightmap ? &horizon : NULL;
+    terrain->SetOcclusion(occlusion);
+
+    // normals and ambient occlusion baked from the heights, which every terrain mode is lit with
+    TerrainLighting terrainLighting;
+    terrainLighting.Enabled = options.terrainLighting && wholeHeightmap;
+    terrainLighting.Threads = (unsigned int)options.bakeThreads;
+    terrainLighting.Init();
+    terrainLighting.Update(heightmap);
+
+    // terrain editing: each frame the brush's edits go to the renderer, the horizon, the lighting and the ground queries
+    TerrainEditor terrainEditor;
+    TerrainBrush brush = { BRUSH_RAISE, TERRAIN_BRUSH_RADIUS, TERRAIN_BRUSH_STRENGTH, 0.0f };
+    bool stroking = false;
+
+    // the snowmen tread trails into the snow, which the terrain shaders sink the ground by
+    SnowTrails snowTrails;
+    snowTrails.Enabled = options.snowTrails;
+    snowTrails.Init();
+
+    GpuProfiler gpuProfiler;
+    gpuProfiler.Enabled = options.gpuProfile;
+    gpuProfiler.Init();
+
+    CameraPath recordedPath, replayPath;
+    if (!options.replayCameraPath.empty())
     {
-        std::cout << "Failed to load texture" << std::endl;
+        if (!replayPath.Load(options.replayCameraPath))
+            return -1;
+        std::cout << "Replaying " << replayPath.Samples.size() << " camera samples from " << options.replayCameraPath << std::endl;
+        if (options.frames <= 0 && options.headless)
+            options.frames = (int)replayPath.Samples.size();
     }
 
+    // headless mode has no GLFW timer, so it measures time from here instead
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    int frameCount = 0;
 
+    benchmark.EndStartup();
 
-    std::vector<float> vertices;
-    
-    float yScale = 8.0f / 256.0f, yShift = 5.0f;
-
-    int rez = 1;
-    unsigned bytePerPixel = nrChannels;
-    for (int i = 0; i < height; i++)
+    while (options.headless ? frameCount < options.frames : !glfwWindowShouldClose(window))
     {
-        for (int j = 0; j < width; j++)
+        PROFILE_SCOPE("Frame");
+        benchmark.BeginFrame();
+        gpuProfiler.BeginFrame();
+        GLCounters::Get().BeginFrame();
+        benchmark.BeginStage(STAGE_UPDATE);
+        PROFILE_BEGIN(updateZone, "Update");
+
+        //adapted from https://learnopengl.com/Getting-started/Camera
+
+        if (options.benchmark)
         {
-            unsigned char* pixelOffset = data + (j + width * i) * bytePerPixel;
-            unsigned char y = pixelOffset[0];
+            // a fixed timestep makes every benchmark run simulate the same frames
+            deltaTime = options.timestep;
+        }
+        else
+        {
+            float currentFrame = options.headless
+                ? std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count()
+                : static_cast<float>(glfwGetTime());
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+        }
 
-            // vertex
-            vertices.push_back((-height / 2.0f + height * i / (float)height) / 2.0f);
-            vertices.push_back((int)y * yScale - yShift);
-            vertices.push_back((-width / 2.0f + width * j / (float)width) / 2.0f);
+        if (!options.headless)
+        {
+            processInput(window);
+            camera.Position.y = std::max(camera.Position.y, terrainQuery.HeightAt(camera.Position.x, camera.Position.z) + CAMERA_GROUND_CLEARANCE);
         }
-    }
-    std::cout << "Loaded " << vertices.size() / 3 << " vertices" << std::endl;
-    stbi_image_free(data);
 
-    std::vector<unsigned> indices;
-    for (unsigned i = 0; i < height - 1; i += rez)
-    {
-        for (unsigned j = 0; j < width; j += rez)
+        if (reloadHeightmap)
         {
-            for (unsigned k = 0; k < 2; k++)
+            // a failed load keeps the old terrain, the paged terrains reopen their tile source
+            reloadHeightmap = false;
+            if (isPagedTerrain(terrainMode) || loadHeightmap(heightmap, options))
             {
-                indices.push_back(j + width * (i + k * rez));
+                terrain->UpdateHeights(heightmap);
+                if (isPagedTerrain(terrainMode))
+                    terrainQuery.UpdateTiles(terrain->Tiles());
+                else
+                    terrainQuery.Update(heightmap);
+                horizon.Update(heightmap);
+                terrainLighting.Update(heightmap);
             }
         }
-    }
-    std::cout << "Loaded " << indices.size() << " indices" << std::endl;
-
-    const int numStrips = (height - 1) / rez;
-    const int numTrisPerStrip = (width / rez) * 2 - 2;
-    std::cout << "Created lattice of " << numStrips << " strips with " << numTrisPerStrip << " triangles each" << std::endl;
-    std::cout << "Created " << numStrips * numTrisPerStrip << " triangles total" << std::endl;
-
-    unsigned int terrainVAO, terrainVBO, terrainIBO;
-    glGenVertexArrays(1, &terrainVAO);
-    glBindVertexArray(terrainVAO);
 
-    glGenBuffers(1, &terrainVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, terrainVBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+        // the paged terrains have no heightmap in memory for strips to be built from
+        if (switchTerrain && !isPagedTerrain(terrainMode))
+        {
+            Terrain_Mode nextMode = drawnTerrainMode == terrainMode ? TERRAIN_STRIPS : terrainMode;
+            std::unique_ptr<TerrainRenderer> next(createTerrain(nextMode, options, loader));
+            next->SetOcclusion(occlusion);
+            if (next->Init(heightmap))
+            {
+                terrain->Destroy();
+                terrain.swap(next);
+                drawnTerrainMode = nextMode;
+                std::cout << "Drawing terrain as " << terrainModeName(drawnTerrainMode) << std::endl;
+            }
+        }
+        switchTerrain = false;
 
-    glGenBuffers(1, &terrainIBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrainIBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned), &indices[0], GL_STATIC_DRAW);
+        if (terrainErrorChange != 1.0f)
+        {
+            if (terrain->SetErrorTolerance(terrainError * terrainErrorChange))
+                terrainError *= terrainErrorChange;
+            terrainErrorChange = 1.0f;
+        }
 
+        if (pickTerrain)
+        {
+            pickTerrain = false;
+            TerrainRay ray = { camera.Position, camera.Front, TERRAIN_PICK_DISTANCE };
+            TerrainHit hit;
+            if (terrainQuery.Raycast(ray, hit))
+                std::cout << "Terrain at (" << hit.Position.x << ", " << hit.Position.y << ", " << hit.Position.z << "), " << hit.Distance << " away" << std::endl;
+            else
+                std::cout << "No terrain in view" << std::endl;
+        }
 
-    while (!glfwWindowShouldClose(window))
-    {
-        //adapted from https://learnopengl.com/Getting-started/Camera
+        // the paged terrains have no heightmap in memory to edit
+        if (heldBrush >= 0 && !isPagedTerrain(terrainMode))
+        {
+            TerrainRay ray = { camera.Position, camera.Front, TERRAIN_PICK_DISTANCE };
+            TerrainHit hit;
+            if (terrainQuery.Raycast(ray, hit))
+            {
+                // flatten levels the ground to where the stroke started
+                if (!stroking)
+                    brush.Height = hit.Position.y;
+                stroking = true;
+                brush.Mode = (Brush_Mode)heldBrush;
+                HeightmapRect rect = terrainEditor.Apply(heightmap, brush, hit.Position.x, hit.Position.z, deltaTime);
+                if (!rect.Empty())
+                {
+                    terrain->UpdateRegion(heightmap, rect);
+                    horizon.UpdateRegion(heightmap, rect);
+                    terrainLighting.UpdateRegion(heightmap, rect);
+                    terrainQuery.UpdateRegion(heightmap, rect);
+                    crowd.Ground(terrainQuery);
+                }
+            }
+        }
+        else
+            stroking = false;
 
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        // a replayed pose overrides any live input
+        if (!replayPath.Samples.empty())
+            replayPath.Apply(camera, frameCount);
+        if (!options.recordCameraPath.empty())
+            recordedPath.Record(camera);
 
-        processInput(window);
+        PROFILE_END(updateZone);
+        benchmark.EndStage();
+        benchmark.BeginStage(STAGE_SUBMIT);
+        PROFILE_BEGIN(frameSetupZone, "Frame setup");
 
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -327,60 +659,92 @@ int main()
         //adapted from https://learnopengl.com/Getting-started/Shaders
 
         //light
-        ourShader.use();
-        ourShader.setVec3("light.ambient", 1.0f, 1.0f, 1.0f);
-        ourShader.setVec3("light.diffuse", 0.5f, 0.5f, 0.5f);
-        ourShader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
-
-        ourShader.setVec3("light.position", lightPos);
-
-        ourShader.setVec3("viewPos", camera.Position);
-        ourShader.setFloat("light.constant", 1.0f);
-        ourShader.setFloat("light.linear", 0.09f);
-        ourShader.setFloat("light.quadratic", 0.032f);
-
-        ourShader.setFloat("alpha", 1.0f);
+        LightStd140& light = lightsBlock.Data.light;
+        light.ambient = glm::vec3(1.0f, 1.0f, 1.0f);
+        light.diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
+        light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+        light.position = lightPos;
+        light.constant = 1.0f;
+        light.linear = 0.09f;
+        light.quadratic = 0.032f;
 
         //coloured light
-        ourShader.setVec3("colouredLight.ambient", 0.0f, 0.0f, 0.0f);
-        ourShader.setVec3("colouredLight.diffuse", 1.0f, 0.75f, 0.0f);
-        ourShader.setVec3("colouredLight.specular", 1.0f, 1.0f, 1.0f);
+        LightStd140& colouredLight = lightsBlock.Data.colouredLight;
+        colouredLight.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+        colouredLight.diffuse = glm::vec3(1.0f, 0.75f, 0.0f);
+        colouredLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+        colouredLight.position = colouredLightPos;
+        colouredLight.constant = 1.0f;
+        colouredLight.linear = 0.09f;
+        colouredLight.quadratic = 0.032f;
+
+        //fog thickens with distance from the camera, faster around objects than over the terrain
+        fogBlock.Data.objectFog.colour = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+        fogBlock.Data.objectFog.distance = 5.0f;
+        fogBlock.Data.terrainFog.colour = glm::vec4(0.8f, 0.8f, 0.8f, 1.0f);
+        fogBlock.Data.terrainFog.distance = 10.0f;
+
+        //camera, the skybox takes the rotation part of the view and the terrain a further far plane
+        cameraBlock.Data.projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        cameraBlock.Data.view = camera.GetViewMatrix();
+        cameraBlock.Data.terrainProjection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100000.0f);
+        cameraBlock.Data.cameraPos = camera.Position;
+
+        //only what changed since the last frame is sent
+        cameraBlock.Upload();
+        lightsBlock.Upload();
+        fogBlock.Upload();
 
-        ourShader.setVec3("colouredLight.position", colouredLightPos);
-
-        ourShader.setFloat("colouredLight.constant", 1.0f);
-        ourShader.setFloat("colouredLight.linear", 0.09f);
-        ourShader.setFloat("colouredLight.quadratic", 0.032f);
-
-        //set camera position as uniform to calculate fragment distance for fog
-        ourShader.setVec3("userPos", camera.Position);
+        ourShader.use();
+        ourShader.set(ourAlpha, 1.0f);
 
-        //draw skybox
+        // what the hills hide from this frame's camera
+        if (occlusion)
+            horizon.Build(camera.Position);
+        crowd.Cull(occlusion);
+        bool treeVisible = !occlusion || !occlusion->IsOccluded(TREE_BOUNDS_LOW, TREE_BOUNDS_HIGH);
 
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
+        PROFILE_END(frameSetupZone);
 
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
+        PROFILE_BEGIN(snowTrailsZone, "Snow trails");
+        gpuProfiler.BeginPass("Snow trails");
+        snowTrails.Update(camera.Position, crowd.Positions.empty() ? NULL : &crowd.Positions[0], crowd.Count(), 0.2f, deltaTime);
+        gpuProfiler.EndPass();
+        PROFILE_END(snowTrailsZone);
 
         //adapted from https://learnopengl.com/Model-Loading/Model
 
-        for (int i=0;i<5;i++)
+        PROFILE_BEGIN(snowmenZone, "Snowmen");
+        gpuProfiler.BeginPass("Snowmen");
+        if (options.instancing)
+        {
+            // every body in one draw per mesh, then every arm
+            crowd.UploadInstances(arm_swing, snowman1DirectionRadians);
+            instancedShader.use();
+            ourModel.DrawInstanced(instancedShader, (GLsizei)crowd.VisibleCount);
+            stick1.DrawInstanced(instancedShader, (GLsizei)(2 * crowd.VisibleCount));
+            ourShader.use();
+
+            // the tree is drawn with the last snowman's material, as it is after the per-snowman loop
+            if (crowd.Count() > 0)
+                ourShader.set(ourMaterialIndex, crowd.Materials.back());
+        }
+        else for (size_t i = 0; i < crowd.Count(); i++)
         {
-            //set material to material i
-            ourShader.setVec3("material.ambient", snowmanMaterials[i][0], snowmanMaterials[i][1], snowmanMaterials[i][2]);
-            ourShader.setVec3("material.diffuse", snowmanMaterials[i][3], snowmanMaterials[i][4], snowmanMaterials[i][5]);
-            ourShader.setVec3("material.specular", snowmanMaterials[i][6], snowmanMaterials[i][7], snowmanMaterials[i][8]);
-            ourShader.setFloat("material.shininess", snowmanMaterials[i][9]);
+            //set material to the snowman's material
+            ourShader.set(ourMaterialIndex, crowd.Materials[i]);
+            // hidden snowmen still set it, so the tree gets the last snowman's material either way
+            if (!crowd.Visible[i])
+                continue;
             
             // render snowman1
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));
-            model = glm::translate(model, snowmanPositions[i]); // set to snowman1Pos
+            model = glm::translate(model, crowd.Positions[i]); // set to snowman1Pos
             model = glm::translate(model, glm::vec3(0.0f, 0.2f, 0.0f));
             model = glm::rotate(model, snowman1DirectionRadians, glm::vec3(0.0, 1.0, 0.0));
 
-            ourShader.setMat4("model", model);
+            ourShader.set(ourModelMatrix, model);
             ourModel.Draw(ourShader);
 
             //render stick1
@@ -388,7 +752,7 @@ int main()
 
             //do global then do local tranformations (note: matrices are applied backwards)
             model = glm::translate(model, glm::vec3(0.3f, 0.5f, 0.0f));
-            model = glm::translate(model, snowmanPositions[i] * 0.2f); // set to snowman1Pos
+            model = glm::translate(model, crowd.Positions[i] * 0.2f); // set to snowman1Pos
             model = glm::rotate(model, glm::radians(arm_swing), glm::vec3(1.0, 0.0, 0.0)); 
             model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0, 0.0, 1.0));
 
@@ -398,7 +762,7 @@ int main()
             model = glm::rotate(model, snowman1DirectionRadians, glm::vec3(0.0, 1.0, 0.0));
             model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
 
-            ourShader.setMat4("model", model);
+            ourShader.set(ourModelMatrix, model);
             stick1.Draw(ourShader);
 
             ////render stick2
@@ -409,42 +773,26 @@ int main()
 
 
             //parent object
-            model = glm::translate(model, snowmanPositions[i] * 0.2f); // set to snowman1Pos
+            model = glm::translate(model, crowd.Positions[i] * 0.2f); // set to snowman1Pos
             model = glm::rotate(model, glm::radians(arm_swing), glm::vec3(1.0, 0.0, 0.0));
 
             model = glm::rotate(model, glm::radians(-45.0f), glm::vec3(0.0, 0.0, 1.0));
             model = glm::rotate(model, snowman1DirectionRadians, glm::vec3(0.0, 1.0, 0.0));
             model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
 
-            ourShader.setMat4("model", model);
+            ourShader.set(ourModelMatrix, model);
             stick1.Draw(ourShader);
-
-            //moving each snowman
-            if (snowman1DirectionRadians > (3.14 * 2)) snowman1DirectionRadians -= 3.14 * 2;
-
-
-            if (snowmanPositions[i].x < (0.01 + snowmanStartPositions[i].x) && snowmanPositions[i].z < (1.99 + snowmanStartPositions[i].z)) snowmanPositions[i] += glm::vec3(0.0f, 0.0f, 0.001f);
-            else if (snowmanPositions[i].x < (1.99 + snowmanStartPositions[i].x) && snowmanPositions[i].z > (1.99 + snowmanStartPositions[i].z)) snowmanPositions[i] += glm::vec3(0.001f, 0.0f, 0.0f);
-            else if (snowmanPositions[i].x > (1.99 + snowmanStartPositions[i].x) && snowmanPositions[i].z > (0.01 + snowmanStartPositions[i].z)) snowmanPositions[i] += glm::vec3(0.0f, 0.0f, -0.001f);
-            else snowmanPositions[i] += glm::vec3(-0.001f, 0.0f, 0.0f);
-        }
-
-        if (arm_swinging_forwards) {
-            arm_swing += 0.02f;
-
-            if (arm_swing > 30.0f) arm_swinging_forwards = false;
-        }
-        else {
-            arm_swing -= 0.02f;
-
-            if (arm_swing < -30.0f) arm_swinging_forwards = true;
         }
 
         //adapted from https://learnopengl.com/Model-Loading/Model
         
         //draw tree
         
-        ourShader.setFloat("alpha", 0.5f);
+        gpuProfiler.EndPass();
+        PROFILE_END(snowmenZone);
+        PROFILE_BEGIN(treeZone, "Tree");
+        gpuProfiler.BeginPass("Tree");
+        ourShader.set(ourAlpha, 0.5f);
 
         // render tree
         glm::mat4 model = glm::mat4(1.0f);
@@ -452,81 +800,63 @@ int main()
         model = glm::translate(model, glm::vec3(0.0f, -0.2f, 0.0f));
         
 
-        ourShader.setMat4("model", model);
-        tree.Draw(ourShader);
+        ourShader.set(ourModelMatrix, model);
+        if (treeVisible)
+            tree.Draw(ourShader);
 
-        ourShader.setFloat("alpha", 1.0f);
+        ourShader.set(ourAlpha, 1.0f);
+        gpuProfiler.EndPass();
+        PROFILE_END(treeZone);
 
         //draw light sources
+        PROFILE_BEGIN(lightsZone, "Lights");
+        gpuProfiler.BeginPass("Lights");
         lightShader.use();
 
-        lightShader.setMat4("projection", projection);
-        lightShader.setMat4("view", view);
-
         model = glm::mat4(1.0f);
 
         model = glm::translate(model, lightPos);
         model = glm::scale(model, glm::vec3(5.0f, 0.5f, 5.0f));	
 
-        lightShader.setMat4("model", model);
+        lightShader.set(lightModel, model);
 
         lightball.Draw(lightShader);
 
         //draw colouredLight
         colouredLightShader.use();
 
-        colouredLightShader.setMat4("projection", projection);
-        colouredLightShader.setMat4("view", view);
-
         model = glm::mat4(1.0f);
         model = glm::translate(model, colouredLightPos); 
         model = glm::scale(model, glm::vec3(3.0f, 0.2f, 3.0f));
 
-        lightShader.setMat4("model", model);
+        lightShader.set(lightModel, model);
 
         lightball.Draw(colouredLightShader);
+        gpuProfiler.EndPass();
+        PROFILE_END(lightsZone);
 
         //
         // heightmap adapted from https://learnopengl.com/Guest-Articles/2021/Tessellation/Height-map
         //
         
-        heightMapShader.use();
-
-        //set camera position as uniform to calculate fragment distance for fog
-        heightMapShader.setVec3("userPos", camera.Position);
-
-        projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100000.0f);
-        view = camera.GetViewMatrix();
-        heightMapShader.setMat4("projection", projection);
-        heightMapShader.setMat4("view", view);
-
-        model = glm::mat4(1.0f);
-        heightMapShader.setMat4("model", model);
-
-        glBindVertexArray(terrainVAO);
-
-        for (unsigned strip = 0; strip < numStrips; strip++)
-        {
-            glDrawElements(GL_TRIANGLE_STRIP,
-                numTrisPerStrip + 2,
-                GL_UNSIGNED_INT,
-                (void*)(sizeof(unsigned) * (numTrisPerStrip + 2) * strip));
-        }
+        PROFILE_BEGIN(terrainZone, "Terrain");
+        gpuProfiler.BeginPass("Terrain");
+        terrain->SetViewportHeight((float)SCR_HEIGHT);
+        terrain->Draw(camera.Position, cameraBlock.Data.terrainProjection * cameraBlock.Data.view);
+        terrain->EndFrame();
+        gpuProfiler.EndPass();
+        PROFILE_END(terrainZone);
 
         //
         // skybox adapted from https://learnopengl.com/Advanced-OpenGL/Cubemaps
         //
 
+        PROFILE_BEGIN(skyboxDrawZone, "Skybox");
+        gpuProfiler.BeginPass("Skybox");
         skyboxShader.use();
-        skyboxShader.setInt("skybox", 0);
+        skyboxShader.set(skyboxSampler, 0);
 
-        projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f); 
         glDepthFunc(GL_LEQUAL);
-        
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(camera.GetViewMatrix()));
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
 
         glBindVertexArray(skyboxVAO);
         glActiveTexture(GL_TEXTURE0);
@@ -534,18 +864,121 @@ int main()
         glDrawArrays(GL_TRIANGLES, 0, 36);
         glBindVertexArray(0);
         glDepthFunc(GL_LESS);
+        gpuProfiler.EndPass();
+        PROFILE_END(skyboxDrawZone);
+
+        benchmark.EndStage();
+        benchmark.BeginStage(STAGE_UPDATE);
+        PROFILE_BEGIN(animateZone, "Animate");
+
+        //moving each snowman, after drawing so that this frame shows the positions from the last one
+        if (snowman1DirectionRadians > (3.14 * 2)) snowman1DirectionRadians -= 3.14 * 2;
+        crowd.Walk();
+        crowd.Ground(terrainQuery);
+
+        if (arm_swinging_forwards) {
+            arm_swing += 0.02f;
+
+            if (arm_swing > 30.0f) arm_swinging_forwards = false;
+        }
+        else {
+            arm_swing -= 0.02f;
+
+            if (arm_swing < -30.0f) arm_swinging_forwards = true;
+        }
 
+        PROFILE_END(animateZone);
+        benchmark.EndStage();
+        benchmark.BeginStage(STAGE_SWAP);
+        PROFILE_BEGIN(swapZone, "Swap");
 
         //adapted from https://learnopengl.com/Getting-started/Hello-Window
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (options.headless)
+        {
+            headless.EndFrame();
+        }
+        else
+        {
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
 
+        PROFILE_END(swapZone);
+        benchmark.EndStage();
+        benchmark.EndFrame();
+        gpuProfiler.EndFrame();
+        GLCounters::Get().EndFrame();
 
+        frameCount++;
+        if (options.frames > 0 && frameCount >= options.frames && !options.headless)
+            glfwSetWindowShouldClose(window, true);
     }
 
-    glfwTerminate();
-    return 0;
+    if (options.glCounters)
+    {
+        const GLFrameCounters& last = GLCounters::Get().Last();
+        std::cout << "GL calls in the last frame: " << last.drawCalls << " draws, " << last.programSwitches << " program switches, "
+            << last.textureBinds << " texture binds (" << last.redundantTextureBinds << " redundant), "
+            << last.uniformUploads << " uniform uploads (" << last.redundantUniformUploads << " redundant), "
+            << last.uniformLookups << " uniform lookups" << std::endl;
+        if (options.benchmark)
+            benchmark.AddSection("gl_counters_per_frame", GLCounters::Get().ReportJson());
+    }
+
+    if (options.gpuProfile)
+    {
+        gpuProfiler.Flush();
+        if (options.benchmark)
+            benchmark.AddSection("gpu_passes_ms", gpuProfiler.ReportJson());
+        else
+            gpuProfiler.PrintSummary();
+        gpuProfiler.Destroy();
+    }
+
+    if (options.benchmark)
+        benchmark.AddSection("terrain", terrain->ReportJson(drawnTerrainMode));
+
+    crowd.Destroy();
+    snowTrails.Destroy();
+    terrainLighting.Destroy();
+    terrain->Destroy();
+    materialTable.Destroy();
+    cameraBlock.Destroy();
+    lightsBlock.Destroy();
+    fogBlock.Destroy();
+
+#if PROFILER_ENABLED
+    if (!options.tracePath.empty())
+        Profiler::Get().WriteTrace(options.tracePath);
+#endif
+
+    if (!options.recordCameraPath.empty() && recordedPath.Save(options.recordCameraPath))
+        std::cout << "Recorded " << recordedPath.Samples.size() << " camera samples to " << options.recordCameraPath << std::endl;
+
+    // an output that wasn't written fails the run, so scripts don't take it for a good one
+    int exitCode = 0;
+    if (options.benchmark)
+    {
+        std::ostringstream context;
+        context << "{ \"renderer\": \"" << glGetString(GL_RENDERER) << "\", \"headless\": " << (options.headless ? "true" : "false")
+            << ", \"width\": " << SCR_WIDTH << ", \"height\": " << SCR_HEIGHT << ", \"timestep\": " << options.timestep
+            << ", \"snowmen\": " << crowd.Count() << ", \"instancing\": " << (options.instancing ? "true" : "false");
+        if (options.gpuProfile)
+            context << ", \"gpu_timing\": \"" << gpuProfiler.Method() << "\"";
+        context << " }";
+        benchmark.AddSection("context", context.str());
+        if (!benchmark.WriteReport(options.benchmarkOutputPath))
+            exitCode = -1;
+    }
+
+    if (options.headless)
+    {
+        std::cout << "Rendered " << frameCount << " frames" << std::endl;
+        if (!options.outputPath.empty() && !headless.SaveImage(options.outputPath))
+            exitCode = -1;
+    }
+    return exitCode;
 }
 
 //adapted from https://learnopengl.com/Getting-started/Camera
@@ -563,6 +996,12 @@ void processInput(GLFWwindow* window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    heldBrush = -1;
+    const int brushKeys[BRUSH_MODE_COUNT] = { GLFW_KEY_1, GLFW_KEY_2, GLFW_KEY_3, GLFW_KEY_4 };
+    for (int mode = 0; mode < BRUSH_MODE_COUNT; mode++)
+        if (glfwGetKey(window, brushKeys[mode]) == GLFW_PRESS)
+            heldBrush = mode;
 }
 
 //adapted from https://learnopengl.com/Getting-started/Camera
@@ -570,6 +1009,12 @@ void processInput(GLFWwindow* window)
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
+    // the projections and the tessellated terrain's triangle sizes follow the new size. A minimised window is 0 x 0
+    if (width > 0 && height > 0)
+    {
+        SCR_WIDTH = width;
+        SCR_HEIGHT = height;
+    }
 }
 
 //adapted from https://learnopengl.com/Getting-started/Camera
@@ -601,3 +1046,17 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (key == GLFW_KEY_F5 && action == GLFW_PRESS)
+        reloadHeightmap = true;
+    if (key == GLFW_KEY_F6 && action == GLFW_PRESS)
+        switchTerrain = true;
+    if (key == GLFW_KEY_F7 && action == GLFW_PRESS)
+        terrainErrorChange *= 0.5f;
+    if (key == GLFW_KEY_F8 && action == GLFW_PRESS)
+        terrainErrorChange *= 2.0f;
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS)
+        pickTerrain = true;
+}
@@ -0,0 +1,91 @@
+#ifndef MATERIALS_H
+#define MATERIALS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Texture unit the material table stays bound to. Model textures use the units from 0 up
+#define MATERIAL_TEXTURE_UNIT 15
+
+// Every material in one buffer texture (GL_TEXTURE_BUFFER, core since GL 3.1), which shaders read with texelFetch
+// by material index, so a draw or instance picks its material with a single int. Each material is three RGBA32F
+// texels: ambient and shininess, diffuse, specular. A buffer texture holds at least 65536 texels, so the table can
+// grow to over 20000 materials, where a uniform block would stop at a few hundred.
+class MaterialTable
+{
+public:
+    static const int TEXELS_PER_MATERIAL = 3;
+
+    unsigned int Buffer;
+    unsigned int Texture;
+
+    MaterialTable() : Buffer(0), Texture(0), dirty(false) {}
+
+    void Init()
+    {
+        glGenBuffers(1, &Buffer);
+        glGenTextures(1, &Texture);
+        glActiveTexture(GL_TEXTURE0 + MATERIAL_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, Texture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    int Count() const
+    {
+        return (int)(texels.size() / TEXELS_PER_MATERIAL);
+    }
+
+    // returns the new material's index
+    int Add(const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular, float shininess)
+    {
+        texels.resize(texels.size() + TEXELS_PER_MATERIAL);
+        int index = Count() - 1;
+        Set(index, ambient, diffuse, specular, shininess);
+        return index;
+    }
+
+    // from a row of ambient, diffuse and specular colours followed by shininess, as in snowmanMaterials
+    int Add(const float* material)
+    {
+        return Add(glm::vec3(material[0], material[1], material[2]), glm::vec3(material[3], material[4], material[5]),
+            glm::vec3(material[6], material[7], material[8]), material[9]);
+    }
+
+    void Set(int index, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular, float shininess)
+    {
+        texels[index * TEXELS_PER_MATERIAL + 0] = glm::vec4(ambient, shininess);
+        texels[index * TEXELS_PER_MATERIAL + 1] = glm::vec4(diffuse, 0.0f);
+        texels[index * TEXELS_PER_MATERIAL + 2] = glm::vec4(specular, 0.0f);
+        dirty = true;
+    }
+
+    // sends the table to the GPU if a material was added or changed since the last upload
+    void Upload()
+    {
+        if (!dirty || texels.empty())
+            return;
+        glBindBuffer(GL_TEXTURE_BUFFER, Buffer);
+        glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(glm::vec4), &texels[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        // attach again, as the buffer's storage was replaced
+        glActiveTexture(GL_TEXTURE0 + MATERIAL_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, Texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, Buffer);
+        glActiveTexture(GL_TEXTURE0);
+        dirty = false;
+    }
+
+    void Destroy()
+    {
+        glDeleteTextures(1, &Texture);
+        glDeleteBuffers(1, &Buffer);
+        Texture = Buffer = 0;
+    }
+
+private:
+    std::vector<glm::vec4> texels;
+    bool dirty;
+};
+#endif
@@ -7,6 +7,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader_s.h"
+#include "profiler.h"
 
 #include <string>
 #include <vector>
@@ -31,6 +32,16 @@ struct Vertex {
 	float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// per-instance data for instanced drawing, read from the buffer given to Mesh::SetInstanceBuffer
+struct InstanceData {
+    // model matrix, attribute locations 7-10 (one per column)
+    glm::mat4 Model;
+    // index into the material table, attribute location 11
+    int Material;
+};
+
+#define INSTANCE_ATTRIBUTE_LOCATION 7
+
 struct Texture {
     unsigned int id;
     string type;
@@ -51,6 +62,7 @@ public:
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        nameSamplers();
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
@@ -59,15 +71,75 @@ public:
     // render the mesh
     void Draw(Shader &shader) 
     {
-        // bind appropriate textures
+        PROFILE_SCOPE("Mesh::Draw");
+        bindTextures(shader);
+        
+        // draw mesh
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // render count instances of the mesh in one draw call, taking the per-instance data from the buffer set with SetInstanceBuffer
+    void DrawInstanced(Shader &shader, GLsizei count)
+    {
+        PROFILE_SCOPE("Mesh::DrawInstanced");
+        bindTextures(shader);
+
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0, count);
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // point the instance attributes at a buffer of InstanceData, starting at firstInstance. Only needs redoing
+    // when the buffer or the offset changes, not when the buffer's contents do
+    void SetInstanceBuffer(unsigned int buffer, size_t firstInstance)
+    {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        size_t base = firstInstance * sizeof(InstanceData);
+        // a mat4 attribute takes four locations, one vec4 column each
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            GLuint location = INSTANCE_ATTRIBUTE_LOCATION + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + offsetof(InstanceData, Model) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(location, 1);
+        }
+        glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION + 4);
+        glVertexAttribIPointer(INSTANCE_ATTRIBUTE_LOCATION + 4, 1, GL_INT, sizeof(InstanceData), (void*)(base + offsetof(InstanceData, Material)));
+        glVertexAttribDivisor(INSTANCE_ATTRIBUTE_LOCATION + 4, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+private:
+    // render data 
+    unsigned int VBO, EBO;
+    // the sampler each texture goes to (e.g. texture_diffuse1), and their locations in each program the mesh has
+    // been drawn with, so a draw does no string building or name lookups
+    struct SamplerLocations {
+        unsigned int program;
+        vector<GLint> locations;
+    };
+    vector<string> samplerNames;
+    vector<SamplerLocations> samplerLocations;
+
+    // names the samplers once, numbering the textures of each type (the N in texture_diffuseN)
+    void nameSamplers()
+    {
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
+        samplerNames.clear();
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
             if(name == "texture_diffuse")
@@ -78,29 +150,42 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to string
              else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to string
+            samplerNames.push_back(name + number);
+        }
+    }
+
+    // the sampler locations in a program, looked up the first time the mesh is drawn with it
+    const vector<GLint>& resolveSamplers(const Shader &shader)
+    {
+        for(size_t i = 0; i < samplerLocations.size(); i++)
+            if(samplerLocations[i].program == shader.ID)
+                return samplerLocations[i].locations;
+        SamplerLocations resolved;
+        resolved.program = shader.ID;
+        for(size_t i = 0; i < samplerNames.size(); i++)
+            resolved.locations.push_back(shader.getLocation(samplerNames[i]));
+        samplerLocations.push_back(resolved);
+        return samplerLocations.back().locations;
+    }
 
+    void bindTextures(Shader &shader)
+    {
+        // bind appropriate textures
+        const vector<GLint>& locations = resolveSamplers(shader);
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+            glUniform1i(locations[i], i);
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
+        PROFILE_SCOPE("Mesh::setupMesh");
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -14,6 +14,7 @@
 
 #include "mesh.h"
 #include "shader_s.h"
+#include "profiler.h"
 
 #include <string>
 #include <fstream>
@@ -46,14 +47,31 @@ public:
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
+
+    // draws count instances of every mesh, see Mesh::DrawInstanced
+    void DrawInstanced(Shader &shader, GLsizei count)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, count);
+    }
+
+    // takes per-instance data from buffer, starting at firstInstance, see Mesh::SetInstanceBuffer
+    void SetInstanceBuffer(unsigned int buffer, size_t firstInstance)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].SetInstanceBuffer(buffer, firstInstance);
+    }
     
 private:
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
+        PROFILE_SCOPE("Model::loadModel");
         // read file via ASSIMP
         Assimp::Importer importer;
+        PROFILE_BEGIN(importZone, "Assimp import");
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        PROFILE_END(importZone);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
@@ -207,6 +225,7 @@ private:
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
+    PROFILE_SCOPE("TextureFromFile");
     string filename = string(path);
     filename = directory + '/' + filename;
 
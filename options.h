@@ -0,0 +1,252 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Settings that can be changed from the command line. The terrain is drawn as the original strips by default;
+// --no-instancing, --no-horizon-cull, --no-snow-trails and --no-terrain-lighting turn off the rest that's new, to
+// draw the original scene.
+struct AppOptions
+{
+    // --help was asked for, so exiting without running isn't an error
+    bool help = false;
+    // render offscreen without a window, for machines with no display
+    bool headless = false;
+    unsigned int width = 800;
+    unsigned int height = 600;
+    // number of frames to render before exiting, 0 runs until the window is closed
+    int frames = 0;
+    // image of the final frame, only written in headless mode
+    std::string outputPath;
+    // run a fixed number of frames with a fixed timestep and report frame times
+    bool benchmark = false;
+    float timestep = 1.0f / 60.0f;
+    // JSON report, printed to stdout when empty
+    std::string benchmarkOutputPath;
+    // camera path files, see camerapath.h
+    std::string recordCameraPath;
+    std::string replayCameraPath;
+    // Chrome trace of the profiler's timing zones, see profiler.h
+    std::string tracePath;
+    // time each render pass on the GPU, see gpuprofiler.h
+    bool gpuProfile = false;
+    // count GL calls and redundant state changes per frame, see glcounters.h
+    bool glCounters = false;
+    // size of the snowman crowd, and whether it's drawn with one instanced draw per mesh or a draw per snowman
+    int snowmen = 5;
+    bool instancing = true;
+    // drop snowmen, the tree and terrain chunks the hills hide from the camera, see horizonculler.h
+    bool horizonCulling = true;
+    // snowmen tread trails into the terrain, see snowtrails.h
+    bool snowTrails = true;
+    // light the terrain with normals and ambient occlusion baked at load, see terrainlighting.h, and the threads the
+    // bake runs on (0 for one per hardware thread)
+    bool terrainLighting = true;
+    int bakeThreads = 0;
+    // how the terrain is drawn, see terrain.h, and the greyscale image it's made from
+    std::string terrain = "strips";
+    std::string heightmapPath = "heightmap.png";
+    // time the terrain mesh builder on heightmaps up to this size and exit, see terrainbuilder.h
+    int terrainBuildBenchmark = 0;
+    // cut the heightmap into a tile file for the paged terrain and exit, see tiledheightmap.h
+    std::string makeTilesPath;
+    // memory the paged terrain keeps tiles in, in megabytes
+    int tileCacheMB = 64;
+    int tileGpuMB = 64;
+    // length in pixels the tessellated terrain aims for along each triangle edge
+    float tessPixels = 8.0f;
+    // largest height error of the RTIN terrain's mesh, in world units
+    float rtinError = 0.1f;
+    // seed of the procedural terrain's noise, see proceduraltiles.h, and of the erosion's droplets
+    unsigned int seed = 1;
+    // erode the heightmap before the terrain is built, or erode it into this file and exit, see erosion.h. Droplets
+    // per sample, and the threads it runs on (0 for one per hardware thread)
+    bool erode = false;
+    std::string erodeOutputPath;
+    float erosionDroplets = 1.0f;
+    int erosionThreads = 0;
+};
+
+inline void printUsage(const char* program)
+{
+    std::cout << "usage: " << program << " [options]\n"
+        << "  --headless            render offscreen (EGL surfaceless) instead of opening a window\n"
+        << "  --width <pixels>      framebuffer width (default 800)\n"
+        << "  --height <pixels>     framebuffer height (default 600)\n"
+        << "  --frames <count>      exit after this many frames (default 100 when headless)\n"
+        << "  --output <file.ppm>   save the final headless frame as a PPM image\n"
+        << "  --benchmark <frames>  render a fixed number of frames with a fixed timestep and report frame times\n"
+        << "  --timestep <seconds>  simulated time per benchmark frame (default 1/60)\n"
+        << "  --benchmark-output <file.json>  write the benchmark report here instead of stdout\n"
+        << "  --record-camera <file>  save the camera's pose every frame to a camera path file\n"
+        << "  --replay-camera <file>  drive the camera from a recorded path (headless runs default to its length)\n"
+        << "  --trace <file.json>   record CPU timing zones and write them as a Chrome/Perfetto trace\n"
+        << "  --gpu-profile         measure GPU time per render pass with timer queries\n"
+        << "  --gl-counters         count GL calls and redundant state changes per frame\n"
+        << "  --snowmen <count>     number of snowmen in the crowd (default 5)\n"
+        << "  --no-instancing       draw the crowd one snowman at a time instead of instanced\n"
+        << "  --no-horizon-cull     draw everything in view, even what the hills hide\n"
+        << "  --no-snow-trails      leave the snow untrodden\n"
+        << "  --no-terrain-lighting shade the terrain by height alone, without baked normals and occlusion\n"
+        << "  --bake-threads <n>    threads the terrain lighting bake runs on (default one per hardware thread)\n"
+        << "  --terrain <mode>      terrain renderer: strips (default), pulled, cdlod, paged, tessellated (needs GL 4.0), clipmap, rtin or procedural\n"
+        << "  --heightmap <file>    greyscale image or square 16-bit .raw/.r16 the terrain is made from (default heightmap.png), or a tile file for paged\n"
+        << "  --terrain-build-benchmark <max size>  time the terrain mesh builder on heightmaps from 256 up to this size, then exit\n"
+        << "  --make-tiles <file>   cut the heightmap (an image, or a square 16-bit .raw/.r16) into a tile file for paged, then exit\n"
+        << "  --tile-cache-mb <MB>  CPU memory the paged terrain caches tiles in (default 64)\n"
+        << "  --tile-gpu-mb <MB>    GPU memory the paged terrain keeps tiles in (default 64)\n"
+        << "  --tess-pixels <n>     screen length in pixels of a triangle edge on the tessellated terrain (default 8)\n"
+        << "  --rtin-error <h>      largest height error of the rtin terrain's mesh, in world units (default 0.1)\n"
+        << "  --seed <n>            seed of the procedural terrain's noise and the erosion's droplets (default 1)\n"
+        << "  --erode               erode the heightmap before the terrain is built\n"
+        << "  --erode-output <file> erode the heightmap into a square 16-bit .raw/.r16, then exit\n"
+        << "  --erosion-droplets <n>  droplets per heightmap sample (default 1)\n"
+        << "  --erosion-threads <n> threads the erosion runs on (default one per hardware thread)\n"
+        << "  --help                show this message" << std::endl;
+}
+
+// returns false if the program should exit instead of running, which is an error unless options.help is set
+inline bool parseOptions(int argc, char* argv[], AppOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--headless")
+            options.headless = true;
+        else if (arg == "--width" && hasValue)
+            options.width = (unsigned int)std::atoi(argv[++i]);
+        else if (arg == "--height" && hasValue)
+            options.height = (unsigned int)std::atoi(argv[++i]);
+        else if (arg == "--frames" && hasValue)
+            options.frames = std::atoi(argv[++i]);
+        else if (arg == "--output" && hasValue)
+            options.outputPath = argv[++i];
+        else if (arg == "--benchmark" && hasValue)
+        {
+            options.benchmark = true;
+            options.frames = std::atoi(argv[++i]);
+        }
+        else if (arg == "--timestep" && hasValue)
+            options.timestep = (float)std::atof(argv[++i]);
+        else if (arg == "--benchmark-output" && hasValue)
+            options.benchmarkOutputPath = argv[++i];
+        else if (arg == "--record-camera" && hasValue)
+            options.recordCameraPath = argv[++i];
+        else if (arg == "--replay-camera" && hasValue)
+            options.replayCameraPath = argv[++i];
+        else if (arg == "--trace" && hasValue)
+            options.tracePath = argv[++i];
+        else if (arg == "--gpu-profile")
+            options.gpuProfile = true;
+        else if (arg == "--gl-counters")
+            options.glCounters = true;
+        else if (arg == "--snowmen" && hasValue)
+            options.snowmen = std::atoi(argv[++i]);
+        else if (arg == "--no-instancing")
+            options.instancing = false;
+        else if (arg == "--no-horizon-cull")
+            options.horizonCulling = false;
+        else if (arg == "--no-snow-trails")
+            options.snowTrails = false;
+        else if (arg == "--no-terrain-lighting")
+            options.terrainLighting = false;
+        else if (arg == "--seed" && hasValue)
+            options.seed = (unsigned int)std::strtoul(argv[++i], NULL, 10);
+        else if (arg == "--erode")
+            options.erode = true;
+        else if (arg == "--erode-output" && hasValue)
+            options.erodeOutputPath = argv[++i];
+        else if (arg == "--erosion-droplets" && hasValue)
+            options.erosionDroplets = (float)std::atof(argv[++i]);
+        else if (arg == "--erosion-threads" && hasValue)
+            options.erosionThreads = std::atoi(argv[++i]);
+        else if (arg == "--bake-threads" && hasValue)
+            options.bakeThreads = std::atoi(argv[++i]);
+        else if (arg == "--terrain" && hasValue)
+            options.terrain = argv[++i];
+        else if (arg == "--heightmap" && hasValue)
+            options.heightmapPath = argv[++i];
+        else if (arg == "--terrain-build-benchmark" && hasValue)
+            options.terrainBuildBenchmark = std::atoi(argv[++i]);
+        else if (arg == "--make-tiles" && hasValue)
+            options.makeTilesPath = argv[++i];
+        else if (arg == "--tile-cache-mb" && hasValue)
+            options.tileCacheMB = std::atoi(argv[++i]);
+        else if (arg == "--tile-gpu-mb" && hasValue)
+            options.tileGpuMB = std::atoi(argv[++i]);
+        else if (arg == "--tess-pixels" && hasValue)
+            options.tessPixels = (float)std::atof(argv[++i]);
+        else if (arg == "--rtin-error" && hasValue)
+            options.rtinError = (float)std::atof(argv[++i]);
+        else
+        {
+            options.help = arg == "--help";
+            if (!options.help)
+                std::cout << "Unknown or incomplete option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+
+    if (options.width == 0 || options.height == 0)
+    {
+        std::cout << "Framebuffer size must be non-zero" << std::endl;
+        return false;
+    }
+    if (options.benchmark && (options.frames <= 0 || options.timestep <= 0.0f))
+    {
+        std::cout << "--benchmark needs a positive frame count and timestep" << std::endl;
+        return false;
+    }
+    if (options.snowmen < 0)
+    {
+        std::cout << "--snowmen can't be negative" << std::endl;
+        return false;
+    }
+    if (options.bakeThreads < 0)
+    {
+        std::cout << "--bake-threads can't be negative" << std::endl;
+        return false;
+    }
+    if (options.erosionDroplets < 0.0f || options.erosionThreads < 0)
+    {
+        std::cout << "--erosion-droplets and --erosion-threads can't be negative" << std::endl;
+        return false;
+    }
+    if (options.terrainBuildBenchmark != 0 && options.terrainBuildBenchmark < 256)
+    {
+        std::cout << "--terrain-build-benchmark needs a size of at least 256" << std::endl;
+        return false;
+    }
+    if (options.tileCacheMB <= 0 || options.tileGpuMB <= 0)
+    {
+        std::cout << "--tile-cache-mb and --tile-gpu-mb need a positive size" << std::endl;
+        return false;
+    }
+    if (options.tessPixels <= 0.0f)
+    {
+        std::cout << "--tess-pixels needs a positive length" << std::endl;
+        return false;
+    }
+    if (options.rtinError < 0.0f)
+    {
+        std::cout << "--rtin-error can't be negative" << std::endl;
+        return false;
+    }
+    // tiles are cut from a mapped file without loading the map, which erosion needs whole
+    if (!options.makeTilesPath.empty() && (options.erode || !options.erodeOutputPath.empty()))
+    {
+        std::cout << "--make-tiles can't erode: write the eroded heightmap with --erode-output, then cut that into tiles" << std::endl;
+        return false;
+    }
+    // a replayed path sets its own length once loaded
+    if (options.headless && options.frames <= 0 && options.replayCameraPath.empty())
+        options.frames = 100;
+    return true;
+}
+#endif
@@ -0,0 +1,529 @@
+#ifndef PAGED_TERRAIN_H
+#define PAGED_TERRAIN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "terrain.h"
+#include "tiledheightmap.h"
+#include "frustum.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// level 0 tiles are drawn within this distance of the camera, and each level after covers twice the distance
+const float PAGED_LOD_DISTANCE = 1.5f * TILED_HEIGHTMAP_TILE_SIZE * HEIGHTMAP_SPACING;
+// children are asked for from this far beyond the distance they're drawn at, so they're usually in by the time they're needed
+const float PAGED_PREFETCH = 1.5f;
+// tiles uploaded to the GPU per frame at most, which bounds the frame time paging can add
+const int PAGED_UPLOADS_PER_FRAME = 8;
+// tiles waiting for or being read by the loader threads at most, so a fast camera doesn't queue tiles it has left behind
+const int PAGED_MAX_PENDING_LOADS = 32;
+// skirts hang this many quads below a tile's edges to hide the cracks where levels meet
+const float PAGED_SKIRT_DEPTH = 4.0f;
+
+// Terrain paged in from a tile source (see tiledheightmap.h) around the camera, for maps far bigger than memory: a
+// tile file, or tiles generated as they're needed (see proceduraltiles.h). The source is a mip pyramid of tiles, and every frame a quadtree over the pyramid is walked from the coarsest level,
+// which stays loaded: a tile is replaced by its four children when the camera is close enough and all four are on
+// the GPU, and otherwise drawn itself while the missing children are asked for. Loader threads, as many as the
+// source can keep busy, read asked-for tiles into a CPU cache, and the render thread uploads a few each frame into slots of
+// a texture array. Both caches have a fixed number of slots, set by the CPU and GPU budgets, and evict the least
+// recently used tile, so memory doesn't grow with the size of the map. Every tile is the same grid mesh with skirts,
+// lifted by terrainPaged.vs from its slot, and all of them are drawn with one instanced draw.
+class PagedTerrain : public TerrainRenderer
+{
+public:
+    // takes ownership of the source. Budgets are in bytes for the CPU tile cache and the GPU texture array
+    PagedTerrain(TileSource* source, size_t cpuBudget, size_t gpuBudget)
+        : source(source), cpuBudget(cpuBudget), gpuBudget(gpuBudget), VAO(0), gridVBO(0), gridIBO(0), instanceVBO(0), tileTexture(0),
+        indexCount(0), levelCount(0), frame(0), pendingLoads(0), stopping(false), tilesRead(0), tilesUploaded(0) {}
+
+    // the loader threads have to be joined whether or not Destroy was called, or ending the program terminates it
+    ~PagedTerrain()
+    {
+        Destroy();
+    }
+
+    // the heightmap isn't used, the heights come from the tile source. The loader threads are started last, so a
+    // failed Init leaves none running
+    bool Init(const Heightmap& heightmap) override
+    {
+        PROFILE_SCOPE("PagedTerrain::Init");
+        if (!source->Open())
+            return false;
+        levelCount = source->Levels();
+        for (int level = 0; level < levelCount; level++)
+            ranges[level] = level == levelCount - 1 ? 1e30f : PAGED_LOD_DISTANCE * (float)(1 << level);
+
+        // the coarsest level is always loaded, so the walk has somewhere to start
+        int top = levelCount - 1;
+        size_t roots = (size_t)source->TileRows(top) * source->TileColumns(top);
+        GLint maxLayers = 0;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        size_t gpuSlotCount = std::min(gpuBudget / TILED_HEIGHTMAP_TILE_BYTES, (size_t)maxLayers);
+        size_t cpuSlotCount = cpuBudget / TILED_HEIGHTMAP_TILE_BYTES;
+        // every load in flight holds a CPU slot until it's uploaded
+        if (cpuSlotCount < (size_t)PAGED_MAX_PENDING_LOADS)
+        {
+            std::cout << "ERROR::PAGED_TERRAIN::BUDGET_TOO_SMALL: " << cpuSlotCount << " CPU tiles can't hold the " << PAGED_MAX_PENDING_LOADS << " loads in flight" << std::endl;
+            source->Close();
+            levelCount = 0;
+            return false;
+        }
+        if (gpuSlotCount < roots + 4)
+        {
+            std::cout << "ERROR::PAGED_TERRAIN::BUDGET_TOO_SMALL: " << gpuSlotCount << " GPU tiles can't hold the " << roots << " coarsest ones" << std::endl;
+            source->Close();
+            levelCount = 0;
+            return false;
+        }
+
+        std::ostringstream defines;
+        defines << "#define TILE_SIZE " << TILED_HEIGHTMAP_TILE_SIZE << ".0\n#define SKIRT_DEPTH " << PAGED_SKIRT_DEPTH << "\n";
+        shader.reset(new Shader("terrainPaged.vs", "heightMapShader.fs", shaderDefines(defines.str())));
+        setUpShader(*shader);
+        shader->setVec2("heightRange", glm::vec2(source->Header.heightLow, source->Header.heightHigh));
+        shader->setVec2("heightmapSize", glm::vec2((float)source->Header.rows, (float)source->Header.columns));
+        shader->setFloat("spacing", source->Header.spacing);
+
+        PROFILE_BEGIN(terrainUploadZone, "Upload terrain buffers");
+        buildGrid();
+        glGenTextures(1, &tileTexture);
+        glActiveTexture(GL_TEXTURE0 + HEIGHTMAP_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, tileTexture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R16, TILED_HEIGHTMAP_TILE_SIZE + 1, TILED_HEIGHTMAP_TILE_SIZE + 1, (GLsizei)gpuSlotCount, 0, GL_RED, GL_UNSIGNED_SHORT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glActiveTexture(GL_TEXTURE0);
+
+        gpuSlots.assign(gpuSlotCount, GpuSlot());
+        cpuSlots.assign(cpuSlotCount, CpuSlot());
+        cpuTexels.resize(cpuSlotCount * TILED_HEIGHTMAP_TILE_SAMPLES);
+        std::vector<unsigned short> texels(TILED_HEIGHTMAP_TILE_SAMPLES);
+        for (int row = 0; row < source->TileRows(top); row++)
+        {
+            for (int column = 0; column < source->TileColumns(top); column++)
+            {
+                source->ReadTile(top, row, column, &texels[0]);
+                int slot = uploadTile(tileKey(top, row, column), &texels[0]);
+                gpuSlots[slot].pinned = true;
+            }
+        }
+        GpuBytes = gpuSlotCount * TILED_HEIGHTMAP_TILE_BYTES + (TILED_HEIGHTMAP_TILE_SIZE + 3) * (TILED_HEIGHTMAP_TILE_SIZE + 3) * sizeof(glm::vec3)
+            + indexCount * sizeof(unsigned short);
+        CpuBytes = cpuSlotCount * TILED_HEIGHTMAP_TILE_BYTES;
+        PROFILE_END(terrainUploadZone);
+
+        stopping = false;
+        for (unsigned int i = 0; i < std::max(source->LoaderThreads(), 1u); i++)
+            loaders.push_back(std::thread(&PagedTerrain::loadTiles, this));
+        std::cout << "Paging terrain tiles through " << cpuSlotCount << " CPU and " << gpuSlotCount << " GPU slots on "
+            << loaders.size() << " loader threads" << std::endl;
+        return true;
+    }
+
+    void Draw(const glm::vec3& cameraPos, const glm::mat4& viewProjection) override
+    {
+        frame++;
+        receiveTiles();
+        {
+            PROFILE_SCOPE("PagedTerrain::Select");
+            frustum.Extract(viewProjection);
+            instances.clear();
+            requests.clear();
+            int top = levelCount - 1;
+            for (int row = 0; row < source->TileRows(top); row++)
+                for (int column = 0; column < source->TileColumns(top); column++)
+                    selectTile(top, row, column, cameraPos);
+        }
+        requestTiles();
+
+        NodesDrawn = TrianglesDrawn = DrawCalls = 0;
+        if (instances.empty())
+            return;
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(glm::vec4), &instances[0]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        shader->use();
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_SHORT, (void*)0, (GLsizei)instances.size());
+        glBindVertexArray(0);
+
+        NodesDrawn = instances.size();
+        TrianglesDrawn = instances.size() * indexCount / 3;
+        DrawCalls = 1;
+    }
+
+    const TileSource* Tiles() const override
+    {
+        return levelCount > 0 ? source.get() : NULL;
+    }
+
+    // safe to call more than once, and on a terrain whose Init failed
+    void Destroy() override
+    {
+        if (!loaders.empty())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (size_t i = 0; i < loaders.size(); i++)
+                loaders[i].join();
+            loaders.clear();
+            std::cout << "Paged terrain read " << tilesRead << " tiles from its source and uploaded " << tilesUploaded << " to the GPU" << std::endl;
+        }
+        jobs.clear();
+        finished.clear();
+        pendingLoads = 0;
+        gpuSlots.clear();
+        cpuSlots.clear();
+        gpuSlotOf.clear();
+        cpuSlotOf.clear();
+        std::vector<unsigned short>().swap(cpuTexels);
+        source->Close();
+        levelCount = 0;
+
+        if (VAO)
+        {
+            glDeleteVertexArrays(1, &VAO);
+            glDeleteBuffers(1, &gridVBO);
+            glDeleteBuffers(1, &gridIBO);
+            glDeleteBuffers(1, &instanceVBO);
+            VAO = gridVBO = gridIBO = instanceVBO = 0;
+        }
+        if (tileTexture)
+        {
+            glDeleteTextures(1, &tileTexture);
+            tileTexture = 0;
+        }
+    }
+
+private:
+    // a layer of the texture array, and the tile in it
+    struct GpuSlot {
+        uint64_t key;
+        uint64_t lastUsed;
+        bool pinned;
+        GpuSlot() : key(EMPTY_SLOT), lastUsed(0), pinned(false) {}
+    };
+    // a tile's worth of cpuTexels. Loading slots belong to the loader threads until one hands them back
+    struct CpuSlot {
+        uint64_t key;
+        uint64_t lastUsed;
+        bool loading;
+        CpuSlot() : key(EMPTY_SLOT), lastUsed(0), loading(false) {}
+    };
+    struct LoadJob {
+        uint64_t key;
+        int slot;
+    };
+    struct Request {
+        uint64_t key;
+        float priority;
+        bool operator<(const Request& other) const
+        {
+            return priority < other.priority;
+        }
+    };
+    static const uint64_t EMPTY_SLOT = ~(uint64_t)0;
+
+    std::unique_ptr<TileSource> source;
+    size_t cpuBudget, gpuBudget;
+
+    unsigned int VAO, gridVBO, gridIBO, instanceVBO;
+    unsigned int tileTexture;
+    size_t indexCount;
+    std::unique_ptr<Shader> shader;
+
+    int levelCount;
+    float ranges[TILED_HEIGHTMAP_MAX_LEVELS];
+    Frustum frustum;
+    uint64_t frame;
+    // this frame's tiles as (first row, first column, size in samples, texture layer), and the ones it wanted but didn't have
+    std::vector<glm::vec4> instances;
+    std::vector<Request> requests;
+
+    std::vector<GpuSlot> gpuSlots;
+    std::unordered_map<uint64_t, int> gpuSlotOf;
+    std::vector<CpuSlot> cpuSlots;
+    std::unordered_map<uint64_t, int> cpuSlotOf;
+    std::vector<unsigned short> cpuTexels;
+    int pendingLoads;
+
+    // shared with the loader threads
+    std::vector<std::thread> loaders;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<LoadJob> jobs;
+    std::vector<int> finished;
+    bool stopping;
+
+    size_t tilesRead, tilesUploaded;
+
+    static uint64_t tileKey(int level, int row, int column)
+    {
+        return ((uint64_t)level << 48) | ((uint64_t)row << 24) | (uint64_t)column;
+    }
+
+    static void splitKey(uint64_t key, int& level, int& row, int& column)
+    {
+        level = (int)(key >> 48);
+        row = (int)((key >> 24) & 0xFFFFFF);
+        column = (int)(key & 0xFFFFFF);
+    }
+
+    // a loader thread: reads tiles into the CPU slots they were given until the terrain is destroyed
+    void loadTiles()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            LoadJob job = jobs.front();
+            jobs.pop_front();
+            lock.unlock();
+            {
+                PROFILE_SCOPE("PagedTerrain::loadTile");
+                int level, row, column;
+                splitKey(job.key, level, row, column);
+                source->ReadTile(level, row, column, &cpuTexels[(size_t)job.slot * TILED_HEIGHTMAP_TILE_SAMPLES]);
+            }
+            lock.lock();
+            finished.push_back(job.slot);
+        }
+    }
+
+    // takes back the CPU slots the loaders have filled since last frame
+    void receiveTiles()
+    {
+        std::vector<int> done;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.swap(finished);
+        }
+        for (size_t i = 0; i < done.size(); i++)
+            cpuSlots[done[i]].loading = false;
+        pendingLoads -= (int)done.size();
+        tilesRead += done.size();
+    }
+
+    // puts a tile in the least recently used GPU slot that wasn't drawn this frame, -1 if there is none
+    int uploadTile(uint64_t key, const unsigned short* texels)
+    {
+        int slot = -1;
+        for (int i = 0; i < (int)gpuSlots.size(); i++)
+        {
+            const GpuSlot& candidate = gpuSlots[i];
+            if (candidate.key == EMPTY_SLOT)
+            {
+                slot = i;
+                break;
+            }
+            if (!candidate.pinned && candidate.lastUsed < frame && (slot < 0 || candidate.lastUsed < gpuSlots[slot].lastUsed))
+                slot = i;
+        }
+        if (slot < 0)
+            return -1;
+        if (gpuSlots[slot].key != EMPTY_SLOT)
+            gpuSlotOf.erase(gpuSlots[slot].key);
+        gpuSlots[slot].key = key;
+        gpuSlots[slot].lastUsed = frame;
+        gpuSlotOf[key] = slot;
+
+        glActiveTexture(GL_TEXTURE0 + HEIGHTMAP_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, tileTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, slot, TILED_HEIGHTMAP_TILE_SIZE + 1, TILED_HEIGHTMAP_TILE_SIZE + 1, 1, GL_RED, GL_UNSIGNED_SHORT, texels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glActiveTexture(GL_TEXTURE0);
+        tilesUploaded++;
+        return slot;
+    }
+
+    // the least recently used CPU slot that isn't being loaded, -1 if they all are
+    int freeCpuSlot() const
+    {
+        int slot = -1;
+        for (int i = 0; i < (int)cpuSlots.size(); i++)
+        {
+            const CpuSlot& candidate = cpuSlots[i];
+            if (candidate.key == EMPTY_SLOT)
+                return i;
+            if (!candidate.loading && (slot < 0 || candidate.lastUsed < cpuSlots[slot].lastUsed))
+                slot = i;
+        }
+        return slot;
+    }
+
+    // Uploads the wanted tiles that are in the CPU cache and asks the loaders for the rest, the most urgent first
+    void requestTiles()
+    {
+        PROFILE_SCOPE("PagedTerrain::requestTiles");
+        std::sort(requests.begin(), requests.end());
+        int uploads = 0;
+        bool queued = false;
+        for (size_t i = 0; i < requests.size(); i++)
+        {
+            uint64_t key = requests[i].key;
+            std::unordered_map<uint64_t, int>::iterator cached = cpuSlotOf.find(key);
+            if (cached != cpuSlotOf.end())
+            {
+                CpuSlot& slot = cpuSlots[cached->second];
+                slot.lastUsed = frame;
+                if (!slot.loading && uploads < PAGED_UPLOADS_PER_FRAME && uploadTile(key, &cpuTexels[(size_t)cached->second * TILED_HEIGHTMAP_TILE_SAMPLES]) >= 0)
+                    uploads++;
+                continue;
+            }
+            if (pendingLoads >= PAGED_MAX_PENDING_LOADS)
+                continue;
+            int slot = freeCpuSlot();
+            if (slot < 0)
+                break;
+            if (cpuSlots[slot].key != EMPTY_SLOT)
+                cpuSlotOf.erase(cpuSlots[slot].key);
+            cpuSlots[slot].key = key;
+            cpuSlots[slot].lastUsed = frame;
+            cpuSlots[slot].loading = true;
+            cpuSlotOf[key] = slot;
+            LoadJob job = { key, slot };
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs.push_back(job);
+            }
+            pendingLoads++;
+            queued = true;
+        }
+        if (queued)
+            wake.notify_all();
+    }
+
+    // the world-space box around a tile's samples, cut off at the edge of the map
+    void tileBox(int level, int row, int column, glm::vec3& low, glm::vec3& high) const
+    {
+        int span = TILED_HEIGHTMAP_TILE_SIZE << level;
+        float rows = (float)source->Header.rows, columns = (float)source->Header.columns, spacing = source->Header.spacing;
+        glm::vec2 bound = source->TileBounds(level, row, column);
+        low = glm::vec3(((float)row * span - rows / 2.0f) * spacing, bound.x, ((float)column * span - columns / 2.0f) * spacing);
+        high = glm::vec3((std::min((float)(row + 1) * span, rows - 1.0f) - rows / 2.0f) * spacing, bound.y,
+            (std::min((float)(column + 1) * span, columns - 1.0f) - columns / 2.0f) * spacing);
+    }
+
+    // Draws a tile that is on the GPU, or its children if they're all there and the camera is close enough for them.
+    // Children that are nearly or already needed but not on the GPU are asked for
+    void selectTile(int level, int row, int column, const glm::vec3& cameraPos)
+    {
+        glm::vec3 low, high;
+        tileBox(level, row, column, low, high);
+        if (!frustum.IntersectsBox(low, high))
+            return;
+        int slot = gpuSlotOf[tileKey(level, row, column)];
+        gpuSlots[slot].lastUsed = frame;
+
+        if (level > 0 && sphereIntersectsBox(cameraPos, ranges[level - 1] * PAGED_PREFETCH, low, high))
+        {
+            bool allResident = true;
+            float distance = glm::length(glm::max(glm::max(low - cameraPos, cameraPos - high), glm::vec3(0.0f)));
+            for (int child = 0; child < 4; child++)
+            {
+                int childRow = row * 2 + child / 2, childColumn = column * 2 + child % 2;
+                if (childRow >= source->TileRows(level - 1) || childColumn >= source->TileColumns(level - 1))
+                    continue;
+                uint64_t key = tileKey(level - 1, childRow, childColumn);
+                if (gpuSlotOf.find(key) == gpuSlotOf.end())
+                {
+                    allResident = false;
+                    // closer and coarser tiles first
+                    Request request = { key, distance / (float)(TILED_HEIGHTMAP_TILE_SIZE << level) };
+                    requests.push_back(request);
+                }
+            }
+            if (allResident && sphereIntersectsBox(cameraPos, ranges[level - 1], low, high))
+            {
+                for (int child = 0; child < 4; child++)
+                {
+                    int childRow = row * 2 + child / 2, childColumn = column * 2 + child % 2;
+                    if (childRow < source->TileRows(level - 1) && childColumn < source->TileColumns(level - 1))
+                        selectTile(level - 1, childRow, childColumn, cameraPos);
+                }
+                return;
+            }
+        }
+
+        int span = TILED_HEIGHTMAP_TILE_SIZE << level;
+        instances.push_back(glm::vec4((float)row * span, (float)column * span, (float)span, (float)slot));
+    }
+
+    // One tile's grid with a ring of skirt vertices around it, as (sample row, sample column, 1 on the skirt)
+    void buildGrid()
+    {
+        const int verticesPerSide = TILED_HEIGHTMAP_TILE_SIZE + 3;
+        std::vector<glm::vec3> vertices;
+        for (int row = 0; row < verticesPerSide; row++)
+        {
+            for (int column = 0; column < verticesPerSide; column++)
+            {
+                bool skirt = row == 0 || column == 0 || row == verticesPerSide - 1 || column == verticesPerSide - 1;
+                vertices.push_back(glm::vec3((float)std::min(std::max(row - 1, 0), TILED_HEIGHTMAP_TILE_SIZE),
+                    (float)std::min(std::max(column - 1, 0), TILED_HEIGHTMAP_TILE_SIZE), skirt ? 1.0f : 0.0f));
+            }
+        }
+
+        std::vector<unsigned short> indices;
+        for (int row = 0; row < verticesPerSide - 1; row++)
+        {
+            for (int column = 0; column < verticesPerSide - 1; column++)
+            {
+                unsigned short corner = (unsigned short)(row * verticesPerSide + column);
+                indices.push_back(corner);
+                indices.push_back((unsigned short)(corner + verticesPerSide));
+                indices.push_back((unsigned short)(corner + 1));
+                indices.push_back((unsigned short)(corner + 1));
+                indices.push_back((unsigned short)(corner + verticesPerSide));
+                indices.push_back((unsigned short)(corner + verticesPerSide + 1));
+            }
+        }
+        indexCount = indices.size();
+
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+
+        glGenBuffers(1, &gridVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        glGenBuffers(1, &gridIBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridIBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
+
+        glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+#endif
@@ -0,0 +1,36 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// SSE2 is part of x86-64, so every 64-bit build gets the vector paths of the CPU-heavy headers
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SSE2_ENABLED 1
+#include <emmintrin.h>
+#else
+#define SSE2_ENABLED 0
+#endif
+
+// threads is a thread count asked for in settings, with 0 meaning one per hardware thread
+inline unsigned int threadsToUse(unsigned int threads)
+{
+    return threads > 0 ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// Runs work(first, end) over [0, count) in even shares on up to threads threads (0 for one per hardware thread), with
+// at least minShare items in each share. The calling thread takes the first share rather than waiting, and returns
+// once every share is done
+template <typename Work>
+void inShares(size_t count, unsigned int threads, size_t minShare, const Work& work)
+{
+    size_t threadCount = std::max<size_t>(std::min<size_t>(threadsToUse(threads), count / std::max<size_t>(minShare, 1)), 1);
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threadCount; t++)
+        workers.push_back(std::thread(work, count * t / threadCount, count * (t + 1) / threadCount));
+    work((size_t)0, count / threadCount);
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+}
+#endif
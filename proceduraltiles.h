@@ -0,0 +1,253 @@
+#ifndef PROCEDURAL_TILES_H
+#define PROCEDURAL_TILES_H
+
+#include <glm/glm.hpp>
+
+#include "tiledheightmap.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+// On x86 the AVX2 path, eight samples at a time, is always compiled and chosen at run time when the CPU has AVX2, so
+// builds without /arch:AVX2 or -mavx2 use it too; otherwise the scalar path runs. MSVC compiles AVX2 intrinsics in
+// any function, GCC and Clang only in functions marked PROCEDURAL_AVX2_TARGET
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PROCEDURAL_NOISE_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define PROCEDURAL_AVX2_TARGET
+#else
+#define PROCEDURAL_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#else
+#define PROCEDURAL_NOISE_AVX2 0
+#endif
+
+// the first octave's lattice cells are 2^PROCEDURAL_CELL_SHIFT samples across, and each octave after halves them
+const int PROCEDURAL_CELL_SHIFT = 10;
+const int PROCEDURAL_OCTAVES = 8;
+// height of the first octave, and how much of the last octave's height each one after has
+const float PROCEDURAL_HEIGHT = 10.0f;
+const float PROCEDURAL_GAIN = 0.5f;
+
+// Fractal value noise over the map's integer sample grid. Each octave is a lattice of random heights, one per cell
+// corner from a hash of the corner and the seed, blended with a quintic fade, and the octaves are summed with
+// heights falling by PROCEDURAL_GAIN. Cells are a power of two samples across, so every sample's cell and place in
+// it are found exactly with shifts and masks however far from the origin it is, and a sample comes out the same
+// whichever level of the pyramid asks for it.
+class FractalNoise
+{
+public:
+    explicit FractalNoise(uint32_t seed) : seed(seed) {}
+
+    // the furthest a height can be from 0
+    static float Amplitude()
+    {
+        float amplitude = 0.0f, octaveHeight = PROCEDURAL_HEIGHT;
+        for (int octave = 0; octave < PROCEDURAL_OCTAVES; octave++, octaveHeight *= PROCEDURAL_GAIN)
+            amplitude += octaveHeight;
+        return amplitude;
+    }
+
+    // whether Row runs eight samples at a time, which needs a CPU (and OS) with AVX2. Checked once
+    static bool UsesAvx2()
+    {
+#if PROCEDURAL_NOISE_AVX2
+        static const bool avx2 = cpuHasAvx2();
+        return avx2;
+#else
+        return false;
+#endif
+    }
+
+    // heights of count samples along sample row row, at columns firstColumn, firstColumn + step and so on
+    void Row(int row, int firstColumn, int step, int count, float* heights) const
+    {
+        std::fill(heights, heights + count, 0.0f);
+#if PROCEDURAL_NOISE_AVX2
+        bool avx2 = UsesAvx2();
+#endif
+        float octaveHeight = PROCEDURAL_HEIGHT;
+        for (int octave = 0; octave < PROCEDURAL_OCTAVES; octave++, octaveHeight *= PROCEDURAL_GAIN)
+        {
+            int shift = PROCEDURAL_CELL_SHIFT - octave;
+            uint32_t mask = (1u << shift) - 1;
+            float inverseCell = 1.0f / (float)(1u << shift);
+            // the row's part of the hash and its place in its cells, the same for the whole row
+            uint32_t octaveSeed = (seed + (uint32_t)octave * 0x9E3779B9u) * 0xCB1AB31Fu;
+            uint32_t cellRow = (uint32_t)row >> shift;
+            uint32_t top = cellRow * 0xD8163841u + octaveSeed, bottom = (cellRow + 1) * 0xD8163841u + octaveSeed;
+            float fadeRow = fade(((uint32_t)row & mask) * inverseCell);
+            int i = 0;
+#if PROCEDURAL_NOISE_AVX2
+            for (; avx2 && i + 8 <= count; i += 8)
+                octaveEight(firstColumn + i * step, step, shift, mask, inverseCell, top, bottom, fadeRow, octaveHeight, heights + i);
+#endif
+            for (; i < count; i++)
+            {
+                uint32_t column = (uint32_t)(firstColumn + i * step);
+                uint32_t cellColumn = column >> shift;
+                float fadeColumn = fade((column & mask) * inverseCell);
+                float a = lattice(cellColumn, top), b = lattice(cellColumn + 1, top);
+                float c = lattice(cellColumn, bottom), d = lattice(cellColumn + 1, bottom);
+                float upper = a + (b - a) * fadeColumn, lower = c + (d - c) * fadeColumn;
+                heights[i] += (upper + (lower - upper) * fadeRow) * octaveHeight;
+            }
+        }
+    }
+
+private:
+    uint32_t seed;
+
+    // 6t^5 - 15t^4 + 10t^3, flat at both ends so the octaves have no creases along cell edges
+    static float fade(float t)
+    {
+        return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+    }
+
+    // the random height, -1 to 1, at lattice column x of the row whose part of the hash is rowHash
+    static float lattice(uint32_t x, uint32_t rowHash)
+    {
+        uint32_t h = x * 0x8DA6B343u + rowHash;
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        h *= 0x297A2D39u;
+        h ^= h >> 15;
+        return (float)(h >> 8) * (2.0f / 16777215.0f) - 1.0f;
+    }
+
+#if PROCEDURAL_NOISE_AVX2
+    static bool cpuHasAvx2()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        // AVX2 is leaf 7's EBX bit 5, and the OS has to save the YMM registers (OSXSAVE, then XCR0 bits 1 and 2)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+    }
+
+    PROCEDURAL_AVX2_TARGET static __m256 fadeEight(__m256 t)
+    {
+        __m256 inner = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+        return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+    }
+
+    PROCEDURAL_AVX2_TARGET static __m256 latticeEight(__m256i x, uint32_t rowHash)
+    {
+        __m256i h = _mm256_add_epi32(_mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x8DA6B343u)), _mm256_set1_epi32((int)rowHash));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)0x2C1B3C6Du));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 12));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)0x297A2D39u));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+        return _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(h, 8)), _mm256_set1_ps(2.0f / 16777215.0f)), _mm256_set1_ps(1.0f));
+    }
+
+    // one octave of the scalar loop in Row for eight samples from column first
+    PROCEDURAL_AVX2_TARGET static void octaveEight(int first, int step, int shift, uint32_t mask, float inverseCell, uint32_t top, uint32_t bottom,
+        float fadeRow, float octaveHeight, float* heights)
+    {
+        __m256i columns = _mm256_add_epi32(_mm256_set1_epi32(first), _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(step)));
+        __m256i cellColumns = _mm256_srl_epi32(columns, _mm_cvtsi32_si128(shift));
+        __m256i nextColumns = _mm256_add_epi32(cellColumns, _mm256_set1_epi32(1));
+        __m256 fadeColumn = fadeEight(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(columns, _mm256_set1_epi32((int)mask))), _mm256_set1_ps(inverseCell)));
+        __m256 a = latticeEight(cellColumns, top), b = latticeEight(nextColumns, top);
+        __m256 c = latticeEight(cellColumns, bottom), d = latticeEight(nextColumns, bottom);
+        __m256 upper = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), fadeColumn));
+        __m256 lower = _mm256_add_ps(c, _mm256_mul_ps(_mm256_sub_ps(d, c), fadeColumn));
+        __m256 value = _mm256_add_ps(upper, _mm256_mul_ps(_mm256_sub_ps(lower, upper), _mm256_set1_ps(fadeRow)));
+        _mm256_storeu_ps(heights, _mm256_add_ps(_mm256_loadu_ps(heights), _mm256_mul_ps(value, _mm256_set1_ps(octaveHeight))));
+    }
+#endif
+};
+
+// Tiles of fractal noise made when they're asked for, for the paged terrain: a world with no heightmap to ship or
+// load, for soak-testing paging and LOD. The pyramid has every level a tile file can, so the world is
+// TILED_HEIGHTMAP_TILE_SIZE << (TILED_HEIGHTMAP_MAX_LEVELS - 1) samples across (about a million world units), and a
+// level l tile takes every 2^l-th sample as a tile file's does. Making a tile is all arithmetic, so the paged
+// terrain runs a loader thread per hardware thread and keeps what they make in its CPU cache like tiles read from
+// a file. A tile's bounds are the noise's whole range, as they aren't known until it's made.
+class ProceduralTiles : public TileSource
+{
+public:
+    explicit ProceduralTiles(uint32_t seed) : seed(seed), noise(seed) {}
+
+    bool Open() override
+    {
+        std::memcpy(Header.magic, TILED_HEIGHTMAP_MAGIC, sizeof(Header.magic));
+        Header.version = TILED_HEIGHTMAP_VERSION;
+        Header.tileSize = TILED_HEIGHTMAP_TILE_SIZE;
+        Header.levelCount = TILED_HEIGHTMAP_MAX_LEVELS;
+        // one sample more than the top tile covers, so no tile reaches past the edge
+        Header.rows = Header.columns = ((uint32_t)TILED_HEIGHTMAP_TILE_SIZE << (TILED_HEIGHTMAP_MAX_LEVELS - 1)) + 1;
+        Header.spacing = HEIGHTMAP_SPACING;
+        Header.heightLow = -FractalNoise::Amplitude();
+        Header.heightHigh = FractalNoise::Amplitude();
+        for (int level = 0; level < TILED_HEIGHTMAP_MAX_LEVELS; level++)
+            Header.tileRows[level] = Header.tileColumns[level] = 1u << (TILED_HEIGHTMAP_MAX_LEVELS - 1 - level);
+        std::cout << "Generating procedural terrain of size " << Header.rows << " x " << Header.columns << " with seed " << seed
+            << (FractalNoise::UsesAvx2() ? " using AVX2" : "") << std::endl;
+        return true;
+    }
+
+    void Close() override {}
+
+    void ReadTile(int level, int row, int column, unsigned short* texels) const override
+    {
+        PROFILE_SCOPE("ProceduralTiles::ReadTile");
+        float heights[TILED_HEIGHTMAP_TILE_SIZE + 1];
+        for (int i = 0; i <= TILED_HEIGHTMAP_TILE_SIZE; i++)
+        {
+            noise.Row((row * TILED_HEIGHTMAP_TILE_SIZE + i) << level, (column * TILED_HEIGHTMAP_TILE_SIZE) << level, 1 << level,
+                TILED_HEIGHTMAP_TILE_SIZE + 1, heights);
+            for (int j = 0; j <= TILED_HEIGHTMAP_TILE_SIZE; j++)
+                texels[i * (TILED_HEIGHTMAP_TILE_SIZE + 1) + j] = quantise(heights[j]);
+        }
+    }
+
+    // the noise at the sample, through the same 16 bits as the tiles so it matches what is drawn
+    float SampleHeight(int row, int column) const override
+    {
+        float height;
+        noise.Row(row, column, 1, 1, &height);
+        return TexelHeight(quantise(height));
+    }
+
+    glm::vec2 TileBounds(int level, int row, int column) const override
+    {
+        return glm::vec2(Header.heightLow, Header.heightHigh);
+    }
+
+    unsigned int LoaderThreads() const override
+    {
+        return std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+private:
+    uint32_t seed;
+    FractalNoise noise;
+
+    unsigned short quantise(float height) const
+    {
+        float texel = (height - Header.heightLow) * (65535.0f / (Header.heightHigh - Header.heightLow)) + 0.5f;
+        return (unsigned short)std::min(std::max(texel, 0.0f), 65535.0f);
+    }
+};
+#endif
@@ -0,0 +1,192 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+
+// The profiler is compiled in for debug builds only. Define PROFILER_ENABLED=1 to keep it in a release build (e.g. for soak runs)
+#ifndef PROFILER_ENABLED
+#ifdef NDEBUG
+#define PROFILER_ENABLED 0
+#else
+#define PROFILER_ENABLED 1
+#endif
+#endif
+
+// A finished timing zone. Names must be string literals (or otherwise outlive the profiler)
+struct ProfileEvent {
+    const char* name;
+    int64_t startNs;
+    int64_t durationNs;
+};
+
+// Collects timing zones from any thread and writes them as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+// Each thread appends to its own buffer, so recording a zone takes no lock; the lock is only taken the first
+// time a thread records something and when the trace is written.
+class Profiler
+{
+public:
+    struct Track {
+        int id;
+        std::string name;
+        std::vector<ProfileEvent> events;
+    };
+
+    bool Enabled;
+
+    static Profiler& Get()
+    {
+        static Profiler instance;
+        return instance;
+    }
+
+    static int64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Get().epoch).count();
+    }
+
+    void Record(const char* name, int64_t startNs, int64_t endNs)
+    {
+        ProfileEvent event = { name, startNs, endNs - startNs };
+        threadTrack().events.push_back(event);
+    }
+
+    // names the calling thread's track in the trace viewer
+    void SetThreadName(const std::string& name)
+    {
+        Track& track = threadTrack();
+        std::lock_guard<std::mutex> lock(mutex);
+        track.name = name;
+    }
+
+    // adds a track that isn't tied to a thread, for events recorded elsewhere (e.g. on the GPU)
+    Track& AddTrack(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return addTrack(name);
+    }
+
+    bool WriteTrace(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ofstream file(path.c_str());
+        if (!file)
+        {
+            std::cout << "ERROR::PROFILER::TRACE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+
+        size_t count = 0;
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        for (size_t t = 0; t < tracks.size(); t++)
+        {
+            const Track& track = *tracks[t];
+            file << (t > 0 ? ",\n" : "") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track.id
+                << ",\"args\":{\"name\":\"" << escape(track.name) << "\"}}";
+            for (size_t i = 0; i < track.events.size(); i++)
+            {
+                const ProfileEvent& event = track.events[i];
+                // timestamps are in microseconds
+                file << ",\n{\"name\":\"" << escape(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << track.id
+                    << ",\"ts\":" << event.startNs / 1000 << "." << pad3(event.startNs % 1000)
+                    << ",\"dur\":" << event.durationNs / 1000 << "." << pad3(event.durationNs % 1000) << "}";
+            }
+            count += track.events.size();
+        }
+        file << "\n]}" << std::endl;
+        std::cout << "Wrote " << count << " profile zones to " << path << std::endl;
+        return true;
+    }
+
+private:
+    std::chrono::steady_clock::time_point epoch;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Track> > tracks;
+
+    Profiler() : Enabled(false), epoch(std::chrono::steady_clock::now()) {}
+
+    Track& addTrack(const std::string& name)
+    {
+        tracks.push_back(std::unique_ptr<Track>(new Track()));
+        tracks.back()->id = (int)tracks.size();
+        tracks.back()->name = name;
+        return *tracks.back();
+    }
+
+    Track& threadTrack()
+    {
+        static thread_local Track* track = NULL;
+        if (!track)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // the first thread to record is the one that started the program
+            track = &addTrack(tracks.empty() ? "main" : "worker " + std::to_string(tracks.size()));
+            // reserving up front keeps reallocation out of the timed zones for a long while
+            track->events.reserve(1 << 16);
+        }
+        return *track;
+    }
+
+    static std::string escape(const std::string& text)
+    {
+        std::string result;
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            if (text[i] == '"' || text[i] == '\\')
+                result += '\\';
+            result += text[i];
+        }
+        return result;
+    }
+
+    static std::string pad3(int64_t value)
+    {
+        std::string digits = std::to_string(value);
+        return std::string(3 - digits.size(), '0') + digits;
+    }
+};
+
+// Times the enclosing scope, or the span up to End()
+class ProfileZone
+{
+public:
+    explicit ProfileZone(const char* name) : name(name), startNs(Profiler::Get().Enabled ? Profiler::Now() : -1) {}
+
+    ~ProfileZone()
+    {
+        End();
+    }
+
+    void End()
+    {
+        if (startNs >= 0)
+            Profiler::Get().Record(name, startNs, Profiler::Now());
+        startNs = -1;
+    }
+
+private:
+    const char* name;
+    int64_t startNs;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PROFILER_ENABLED
+// times the rest of the enclosing scope
+#define PROFILE_SCOPE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+// times from PROFILE_BEGIN to the matching PROFILE_END, for sections that don't have their own scope
+#define PROFILE_BEGIN(zone, name) ProfileZone zone(name)
+#define PROFILE_END(zone) zone.End()
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_BEGIN(zone, name)
+#define PROFILE_END(zone)
+#endif
+#endif
@@ -0,0 +1,98 @@
+#ifndef PULLED_TERRAIN_H
+#define PULLED_TERRAIN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "terrain.h"
+#include "profiler.h"
+
+#include <memory>
+#include <vector>
+
+// The strip terrain without vertex or index buffers. A sample's x and z follow from its row and column, so the
+// vertex shader works them out from gl_VertexID and only reads the height, from a 16-bit texture. That is 2 bytes of
+// GPU memory per sample instead of the 12 of a position and the 8 of the two indices that reference it, and loading
+// new heights of the same size is one texture upload. All the strips go in one glMultiDrawArrays call.
+class PulledTerrain : public TerrainRenderer
+{
+public:
+    PulledTerrain() : VAO(0), heightmapTexture(0), rows(0), columns(0) {}
+
+    bool Init(const Heightmap& heightmap) override
+    {
+        rows = heightmap.Rows;
+        columns = heightmap.Columns;
+
+        // strip i covers rows i and i + 1, two vertices per column
+        int numStrips = rows - 1;
+        firsts.resize(numStrips);
+        counts.resize(numStrips);
+        for (int strip = 0; strip < numStrips; strip++)
+        {
+            firsts[strip] = strip * columns * 2;
+            counts[strip] = columns * 2;
+        }
+
+        shader.reset(new Shader("terrainPulled.vs", "heightMapShader.fs", shaderDefines()));
+        setUpShader(*shader);
+
+        PROFILE_BEGIN(terrainUploadZone, "Upload terrain buffers");
+        // core profile draws need a vertex array bound, even with no attributes
+        glGenVertexArrays(1, &VAO);
+        heightmapTexture = createHeightTexture(heightmap, *shader);
+        GpuBytes = heightmap.Heights.size() * sizeof(unsigned short);
+        PROFILE_END(terrainUploadZone);
+        return true;
+    }
+
+    void Draw(const glm::vec3& cameraPos, const glm::mat4& viewProjection) override
+    {
+        NodesDrawn = TrianglesDrawn = DrawCalls = 0;
+        if (firsts.empty())
+            return;
+
+        shader->use();
+        glBindVertexArray(VAO);
+        glMultiDrawArrays(GL_TRIANGLE_STRIP, &firsts[0], &counts[0], (GLsizei)firsts.size());
+        glBindVertexArray(0);
+
+        NodesDrawn = firsts.size();
+        TrianglesDrawn = firsts.size() * (columns * 2 - 2);
+        DrawCalls = 1;
+    }
+
+    // the same size only needs the new heights uploaded
+    bool UpdateHeights(const Heightmap& heightmap) override
+    {
+        if (heightmap.Rows != rows || heightmap.Columns != columns)
+            return TerrainRenderer::UpdateHeights(heightmap);
+        updateHeightTexture(heightmap, heightmapTexture, *shader);
+        return true;
+    }
+
+    // an edit only needs its texels uploaded
+    bool UpdateRegion(const Heightmap& heightmap, const HeightmapRect& rect) override
+    {
+        if (heightmap.Rows != rows || heightmap.Columns != columns)
+            return TerrainRenderer::UpdateHeights(heightmap);
+        updateHeightTextureRegion(heightmap, rect, heightmapTexture, *shader);
+        return true;
+    }
+
+    void Destroy() override
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteTextures(1, &heightmapTexture);
+    }
+
+private:
+    unsigned int VAO;
+    unsigned int heightmapTexture;
+    int rows, columns;
+    std::unique_ptr<Shader> shader;
+    // first vertex and vertex count of each strip
+    std::vector<GLint> firsts;
+    std::vector<GLsizei> counts;
+};
+#endif
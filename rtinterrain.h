@@ -0,0 +1,300 @@
+#ifndef RTIN_TERRAIN_H
+#define RTIN_TERRAIN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "terrain.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+// Right-triangulated irregular network (Evans, Kirkpatrick and Townsend, "Right-Triangulated Irregular Networks",
+// 2001), built the way Mapbox's Martini does it. The heightmap is covered by a square grid of 2^k + 1 samples, split
+// into two right triangles which split in turn at the middle of their long side, down to single grid cells. Once,
+// at Init, each split point is given the largest error of dropping it: how far its height is from the middle of
+// the long side it splits, and the errors of every split point below it. A mesh for any tolerance is then a walk
+// down the triangles that stops wherever the split point's error is within the tolerance, which takes milliseconds
+// and can't leave cracks, since a point is only used once every point it depends on is. Flat ground stays as large
+// triangles, so the mesh has a small fraction of the strips' triangles at an error too small to see. As in Martini
+// the error is measured at the split points only, so between them the mesh can be a little further off.
+//
+// Samples past the edge of a map that isn't 2^k + 1 square repeat the edge, and vertices there are moved back onto
+// it, as the CDLOD terrain does.
+//
+// An edit only recomputes the errors of the split points whose triangles can reach the edited samples, and their
+// ancestors, then walks the mesh again into the same buffers.
+//
+// adapted from https://github.com/mapbox/martini
+class RtinTerrain : public TerrainRenderer
+{
+public:
+    // maxError is the largest height error allowed at a split point, in world units (--rtin-error)
+    explicit RtinTerrain(float maxError) : maxError(maxError), VAO(0), VBO(0), IBO(0), indexCount(0), meshMilliseconds(0.0), gridSize(0), rows(0), columns(0) {}
+
+    bool Init(const Heightmap& heightmap) override
+    {
+        buildErrors(heightmap);
+
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glEnableVertexAttribArray(0);
+        glGenBuffers(1, &IBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+        glBindVertexArray(0);
+        buildMesh();
+        reportMesh();
+
+        shader.reset(new Shader("heightMapShader.vs", "heightMapShader.fs", shaderDefines()));
+        setUpShader(*shader);
+        modelUniform = shader->uniform<glm::mat4>("model");
+        return true;
+    }
+
+    void Draw(const glm::vec3& cameraPos, const glm::mat4& viewProjection) override
+    {
+        shader->use();
+        shader->set(modelUniform, glm::mat4(1.0f));
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (void*)0);
+        glBindVertexArray(0);
+
+        NodesDrawn = 1;
+        TrianglesDrawn = indexCount / 3;
+        DrawCalls = 1;
+    }
+
+    // a new tolerance only needs a new mesh from the errors already built
+    bool SetErrorTolerance(float tolerance) override
+    {
+        maxError = tolerance;
+        buildMesh();
+        reportMesh();
+        return true;
+    }
+
+    // called every frame of a stroke, so nothing is printed
+    bool UpdateRegion(const Heightmap& heightmap, const HeightmapRect& rect) override
+    {
+        if (heightmap.Rows != rows || heightmap.Columns != columns || !VAO)
+            return UpdateHeights(heightmap);
+        PROFILE_SCOPE("RtinTerrain::UpdateRegion");
+        // the samples past the map's last row and column repeat it, so they change with it
+        dirty = rect;
+        if (dirty.LastRow == rows - 1)
+            dirty.LastRow = gridSize - 1;
+        if (dirty.LastColumn == columns - 1)
+            dirty.LastColumn = gridSize - 1;
+        for (int row = dirty.FirstRow; row <= dirty.LastRow; row++)
+            for (int column = dirty.FirstColumn; column <= dirty.LastColumn; column++)
+                heights[gridIndex(row, column)] = heightmap.At(row, column);
+
+        int last = gridSize - 1;
+        clearErrors(0, 0, last, last, last, 0);
+        clearErrors(last, last, 0, 0, 0, last);
+        buildErrorsInDirty();
+        buildMesh();
+        return true;
+    }
+
+    void Destroy() override
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &IBO);
+        VAO = VBO = IBO = 0;
+    }
+
+private:
+    float maxError;
+    unsigned int VAO, VBO, IBO;
+    GLsizei indexCount;
+    double meshMilliseconds;
+    std::unique_ptr<Shader> shader;
+    Uniform<glm::mat4> modelUniform;
+
+    // samples along each side of the grid, 2^k + 1, and the map's own size
+    int gridSize;
+    int rows, columns;
+    // gridSize^2 heights, and the error of each split point, row by row
+    std::vector<float> heights;
+    std::vector<float> errors;
+    // while a mesh is built, each grid sample's vertex number plus one, or 0 if it isn't a vertex yet
+    std::vector<unsigned> vertexOf;
+    std::vector<glm::vec3> vertices;
+    std::vector<size_t> vertexSamples;
+    std::vector<unsigned> indices;
+    // the grid samples whose heights changed since the errors were built, the whole grid at Init
+    HeightmapRect dirty;
+
+    size_t gridIndex(int row, int column) const
+    {
+        return (size_t)row * gridSize + column;
+    }
+
+    // The error of every split point, built up from the smallest triangles as Martini does, so a point's error
+    // already holds both triangles that share it before its parents read it. Triangles are (a, b, c) with a and b the
+    // ends of the long side and c the right angle
+    void buildErrors(const Heightmap& heightmap)
+    {
+        PROFILE_SCOPE("RtinTerrain::BuildErrors");
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        rows = heightmap.Rows;
+        columns = heightmap.Columns;
+        gridSize = 2;
+        while (gridSize - 1 < std::max(rows, columns) - 1)
+            gridSize = (gridSize - 1) * 2 + 1;
+
+        heights.resize((size_t)gridSize * gridSize);
+        for (int row = 0; row < gridSize; row++)
+            for (int column = 0; column < gridSize; column++)
+                heights[gridIndex(row, column)] = heightmap.At(row, column);
+        errors.assign(heights.size(), 0.0f);
+        vertexOf.assign(heights.size(), 0);
+        dirty = HeightmapRect(0, 0, gridSize - 1, gridSize - 1);
+        buildErrorsInDirty();
+        CpuBytes = (heights.size() + errors.size() + vertexOf.size()) * sizeof(float);
+
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Built RTIN errors for a " << gridSize << " x " << gridSize << " grid in " << milliseconds << " ms" << std::endl;
+    }
+
+    // the errors of every split point that reaches the dirty samples, deepest first, from errors of 0
+    void buildErrorsInDirty()
+    {
+        // the two top triangles are depth 0, and every halving of the grid takes two splits
+        int last = gridSize - 1, depth = 0;
+        for (int size = last; size > 1; size /= 2)
+            depth += 2;
+        for (int target = depth; target >= 0; target--)
+        {
+            errorsAtDepth(0, target, 0, 0, last, last, last, 0);
+            errorsAtDepth(0, target, last, last, 0, 0, 0, last);
+        }
+    }
+
+    // Whether a triangle's error can depend on a dirty sample. It reads the samples of the square its long side is
+    // the diagonal of (its own and its partner's, which share the split point), and its children's errors, which
+    // reach half a side further out and so on down. That comes to 1.5 times the long side's length along x and z
+    // around the split point when the long side is diagonal, and once its length when it runs along the grid. Both
+    // triangles sharing a split point give the same answer, and a triangle that reaches the dirty samples is inside
+    // the reach of all its ancestors
+    bool reachesDirty(int ax, int ay, int bx, int by) const
+    {
+        int mx = (ax + bx) / 2, my = (ay + by) / 2;
+        int length = std::max(std::abs(ax - bx), std::abs(ay - by));
+        int reach = ax != bx && ay != by ? length + length / 2 : length;
+        return mx + reach >= dirty.FirstRow && mx - reach <= dirty.LastRow && my + reach >= dirty.FirstColumn && my - reach <= dirty.LastColumn;
+    }
+
+    // zeroes the errors errorsAtDepth will build again, before it takes the largest of both triangles at each
+    void clearErrors(int ax, int ay, int bx, int by, int cx, int cy)
+    {
+        if (!reachesDirty(ax, ay, bx, by))
+            return;
+        int mx = (ax + bx) / 2, my = (ay + by) / 2;
+        errors[gridIndex(mx, my)] = 0.0f;
+        if ((ax + cx) % 2 == 0 && (ay + cy) % 2 == 0)
+        {
+            clearErrors(cx, cy, ax, ay, mx, my);
+            clearErrors(bx, by, cx, cy, mx, my);
+        }
+    }
+
+    void errorsAtDepth(int depth, int target, int ax, int ay, int bx, int by, int cx, int cy)
+    {
+        if (!reachesDirty(ax, ay, bx, by))
+            return;
+        // the smallest triangles here are two cells, whose children's long sides would have no sample in the middle
+        int mx = (ax + bx) / 2, my = (ay + by) / 2;
+        bool hasChildren = (ax + cx) % 2 == 0 && (ay + cy) % 2 == 0;
+        if (depth < target)
+        {
+            if (hasChildren)
+            {
+                errorsAtDepth(depth + 1, target, cx, cy, ax, ay, mx, my);
+                errorsAtDepth(depth + 1, target, bx, by, cx, cy, mx, my);
+            }
+            return;
+        }
+        size_t middle = gridIndex(mx, my);
+        float interpolated = (heights[gridIndex(ax, ay)] + heights[gridIndex(bx, by)]) * 0.5f;
+        float error = std::max(errors[middle], std::abs(interpolated - heights[middle]));
+        if (hasChildren)
+        {
+            // the split points of the two children, which lie on c's sides
+            error = std::max(error, errors[gridIndex((ax + cx) / 2, (ay + cy) / 2)]);
+            error = std::max(error, errors[gridIndex((bx + cx) / 2, (by + cy) / 2)]);
+        }
+        errors[middle] = error;
+    }
+
+    // walks the triangles for the current tolerance, and uploads the mesh into the buffers Init made
+    void buildMesh()
+    {
+        PROFILE_SCOPE("RtinTerrain::BuildMesh");
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        vertices.clear();
+        vertexSamples.clear();
+        indices.clear();
+        int last = gridSize - 1;
+        addTriangles(0, 0, last, last, last, 0);
+        addTriangles(last, last, 0, 0, 0, last);
+        // only the samples that became vertices need clearing for the next mesh
+        for (size_t i = 0; i < vertexSamples.size(); i++)
+            vertexOf[vertexSamples[i]] = 0;
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned), &indices[0], GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        indexCount = (GLsizei)indices.size();
+        GpuBytes = vertices.size() * sizeof(glm::vec3) + indices.size() * sizeof(unsigned);
+        meshMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void reportMesh() const
+    {
+        std::cout << "Built RTIN mesh at error " << maxError << ": " << vertices.size() << " vertices, " << indices.size() / 3
+            << " triangles in " << meshMilliseconds << " ms" << std::endl;
+    }
+
+    void addTriangles(int ax, int ay, int bx, int by, int cx, int cy)
+    {
+        int mx = (ax + bx) / 2, my = (ay + by) / 2;
+        if (std::abs(ax - cx) + std::abs(ay - cy) > 1 && errors[gridIndex(mx, my)] > maxError)
+        {
+            addTriangles(cx, cy, ax, ay, mx, my);
+            addTriangles(bx, by, cx, cy, mx, my);
+            return;
+        }
+        indices.push_back(vertex(ax, ay));
+        indices.push_back(vertex(bx, by));
+        indices.push_back(vertex(cx, cy));
+    }
+
+    // the vertex at grid sample (row, column), added the first time it's used
+    unsigned vertex(int row, int column)
+    {
+        size_t sample = gridIndex(row, column);
+        unsigned& slot = vertexOf[sample];
+        if (slot == 0)
+        {
+            vertexSamples.push_back(sample);
+            float x = ((float)std::min(row, rows - 1) - rows / 2.0f) * HEIGHTMAP_SPACING;
+            float z = ((float)std::min(column, columns - 1) - columns / 2.0f) * HEIGHTMAP_SPACING;
+            vertices.push_back(glm::vec3(x, heights[sample], z));
+            slot = (unsigned)vertices.size();
+        }
+        return slot - 1;
+    }
+};
+#endif
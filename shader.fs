@@ -9,11 +9,18 @@ in float distance;
 
 uniform sampler2D texture_diffuse1;
 
-uniform vec3 viewPos;
+// per-frame camera state, see uniformblocks.h
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 terrainProjection;
+    vec3 cameraPos;
+};
 
 //adapted from https://learnopengl.com/Lighting/Materials and https://learnopengl.com/Getting-started/Shaders
 
-uniform struct Light {
+struct Light {
     vec3 position;  
   
     vec3 ambient;
@@ -32,11 +39,45 @@ struct Material {
     float shininess;
 }; 
   
-uniform Material material;
+// every material, three texels each (see materials.h)
+uniform samplerBuffer materialTable;
+#ifdef INSTANCED
+// each instance picks its material from the table
+flat in int MaterialIndex;
+#else
+uniform int materialIndex;
+#endif
+
+Material fetchMaterial(int index)
+{
+    vec4 ambientShininess = texelFetch(materialTable, index * 3);
+    Material material;
+    material.ambient = ambientShininess.rgb;
+    material.diffuse = texelFetch(materialTable, index * 3 + 1).rgb;
+    material.specular = texelFetch(materialTable, index * 3 + 2).rgb;
+    material.shininess = ambientShininess.a;
+    return material;
+}
 
 uniform float alpha;
-uniform Light light;
-uniform Light colouredLight;
+
+layout (std140) uniform Lights
+{
+    Light light;
+    Light colouredLight;
+};
+
+// see uniformblocks.h
+struct FogSettings {
+    vec4 colour;
+    float distance;
+};
+
+layout (std140) uniform Fog
+{
+    FogSettings objectFog;
+    FogSettings terrainFog;
+};
 
 float weight(float a, float b, float aWeight)
 {
@@ -45,6 +86,11 @@ float weight(float a, float b, float aWeight)
 
 void main()
 {
+#ifdef INSTANCED
+    Material material = fetchMaterial(MaterialIndex);
+#else
+    Material material = fetchMaterial(materialIndex);
+#endif
 //adapted from https://learnopengl.com/Lighting/Materials
 
 // ambient
@@ -62,7 +108,7 @@ void main()
     //specular
     
     float specularStrength = 1.0;
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(cameraPos - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);  
 
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess * 128.0);
@@ -78,8 +124,8 @@ void main()
     vec4 result = vec4((ambient + diffuse + ((specular + colouredSpecular))), alpha) * texture(texture_diffuse1, TexCoords);
 
     //add fog
-    vec4 fogColour = vec4(1.0, 1.0, 1.0, result.w);
-    float fogWeighting = 1 - (1/(distance / 5));
+    vec4 fogColour = vec4(objectFog.colour.rgb, result.w);
+    float fogWeighting = 1 - (1/(distance / objectFog.distance));
 
     vec4 addedFog = (result * (1 - fogWeighting)) + (fogColour * fogWeighting);
     FragColor = addedFog;
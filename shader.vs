@@ -8,15 +8,32 @@ out vec3 FragPos;
 out vec3 Normal;
 out float distance;
 
+#ifdef INSTANCED
+// per-instance data, see InstanceData in mesh.h
+layout (location = 7) in mat4 aModel;
+layout (location = 11) in int aMaterial;
+flat out int MaterialIndex;
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform vec3 userPos;
+#endif
+
+// per-frame camera state, see uniformblocks.h
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 terrainProjection;
+    vec3 cameraPos;
+};
 
 // adapted from https://learnopengl.com/Guest-Articles/2021/Tessellation/Height-map
 
 void main()
 {
+#ifdef INSTANCED
+    mat4 model = aModel;
+    MaterialIndex = aMaterial;
+#endif
     TexCoords = aTexCoords;
 
     FragPos = vec3(model * vec4(aPos, 1.0));
@@ -24,7 +41,7 @@ void main()
 
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 
-    distance = length(userPos - aPos);
+    distance = length(cameraPos - aPos);
 
 
 }
\ No newline at end of file
@@ -6,18 +6,51 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <cstdint>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+
+// tessellation stages are core in GL 4.0, which the GL 3.3 glad loader doesn't define
+#ifndef GL_TESS_CONTROL_SHADER
+#define GL_TESS_CONTROL_SHADER 0x8E88
+#define GL_TESS_EVALUATION_SHADER 0x8E87
+#endif
+
+// 32-bit FNV-1a hash of a uniform name. constexpr, so names written as literals can be hashed at compile time
+constexpr uint32_t uniformHash(const char* name, uint32_t hash = 2166136261u)
+{
+    return *name ? uniformHash(name + 1, (hash ^ (uint8_t)*name) * 16777619u) : hash;
+}
+
+// A uniform name together with its hash, e.g. UniformName("light.position")
+struct UniformName
+{
+    const char* Text;
+    uint32_t Hash;
+    constexpr UniformName(const char* text) : Text(text), Hash(uniformHash(text)) {}
+};
+
+// Location of a uniform whose GLSL type matches T (float, int, glm::vec3, glm::mat4, ...), from Shader::uniform.
+// Setting a handle is a single glUniform call, with no name lookup
+template <typename T>
+struct Uniform
+{
+    GLint Location;
+    Uniform() : Location(-1) {}
+    explicit Uniform(GLint location) : Location(location) {}
+};
 
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly. defines (e.g. "#define INSTANCED\n") are inserted after the
+    // #version line of both stages, to build variants of one source
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "")
     {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
@@ -47,6 +80,11 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
         }
+        if (!defines.empty())
+        {
+            vertexCode = insertDefines(vertexCode, defines);
+            fragmentCode = insertDefines(fragmentCode, defines);
+        }
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
@@ -71,73 +109,257 @@ public:
         glDeleteShader(vertex);
         glDeleteShader(fragment);
 
+        reflectUniforms();
+    }
+    // the same with tessellation control and evaluation stages between the vertex and fragment ones. Needs a GL 4.0
+    // context
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* tessControlPath, const char* tessEvaluationPath, const char* fragmentPath, const std::string& defines = "")
+    {
+        const char* paths[4] = { vertexPath, tessControlPath, tessEvaluationPath, fragmentPath };
+        const GLenum types[4] = { GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_FRAGMENT_SHADER };
+        const char* names[4] = { "VERTEX", "TESS_CONTROL", "TESS_EVALUATION", "FRAGMENT" };
+        unsigned int stages[4];
+        ID = glCreateProgram();
+        for (int i = 0; i < 4; i++)
+        {
+            std::string code = insertDefines(readSource(paths[i]), defines);
+            const char* source = code.c_str();
+            stages[i] = glCreateShader(types[i]);
+            glShaderSource(stages[i], 1, &source, NULL);
+            glCompileShader(stages[i]);
+            checkCompileErrors(stages[i], names[i]);
+            glAttachShader(ID, stages[i]);
+        }
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        for (int i = 0; i < 4; i++)
+            glDeleteShader(stages[i]);
+
+        reflectUniforms();
     }
+    // the program is deleted with the shader, so a shader owns its program and can't be copied. The GL context has
+    // to still be current
+    // ------------------------------------------------------------------------
+    ~Shader()
+    {
+        glDeleteProgram(ID);
+    }
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
     // activate the shader
     // ------------------------------------------------------------------------
     void use() const
     {
         glUseProgram(ID);
     }
-    // utility uniform functions
+    // read a uniform block from a binding point. Does nothing if the program doesn't declare the block
+    // ------------------------------------------------------------------------
+    void bindBlock(const char* name, GLuint binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+    // location of an active uniform, -1 if the program doesn't use it (like glGetUniformLocation, but from the
+    // table built at link time)
+    // ------------------------------------------------------------------------
+    GLint getLocation(const UniformName& name) const
+    {
+        std::unordered_map<uint32_t, UniformInfo>::const_iterator it = uniforms.find(name.Hash);
+        if (it == uniforms.end() || it->second.name != name.Text)
+            return -1;
+        return it->second.location;
+    }
+    GLint getLocation(const char* name) const
+    {
+        return getLocation(UniformName(name));
+    }
+    GLint getLocation(const std::string& name) const
+    {
+        return getLocation(UniformName(name.c_str()));
+    }
+    // typed handle for the render loop, resolve once after the shader is built
+    // ------------------------------------------------------------------------
+    template <typename T>
+    Uniform<T> uniform(const UniformName& name) const
+    {
+        return Uniform<T>(getLocation(name));
+    }
+    // set a uniform through a handle. The program the handle came from must be in use
+    // ------------------------------------------------------------------------
+    void set(Uniform<bool> uniform, bool value) const
+    {
+        glUniform1i(uniform.Location, (int)value);
+    }
+    void set(Uniform<int> uniform, int value) const
+    {
+        glUniform1i(uniform.Location, value);
+    }
+    void set(Uniform<float> uniform, float value) const
+    {
+        glUniform1f(uniform.Location, value);
+    }
+    void set(Uniform<glm::vec2> uniform, const glm::vec2& value) const
+    {
+        glUniform2fv(uniform.Location, 1, &value[0]);
+    }
+    void set(Uniform<glm::vec3> uniform, const glm::vec3& value) const
+    {
+        glUniform3fv(uniform.Location, 1, &value[0]);
+    }
+    void set(Uniform<glm::vec4> uniform, const glm::vec4& value) const
+    {
+        glUniform4fv(uniform.Location, 1, &value[0]);
+    }
+    void set(Uniform<glm::mat2> uniform, const glm::mat2& mat) const
+    {
+        glUniformMatrix2fv(uniform.Location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform<glm::mat3> uniform, const glm::mat3& mat) const
+    {
+        glUniformMatrix3fv(uniform.Location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const
+    {
+        glUniformMatrix4fv(uniform.Location, 1, GL_FALSE, &mat[0][0]);
+    }
+    // utility uniform functions, by name
     // ------------------------------------------------------------------------
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(getLocation(name), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(getLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(getLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(getLocation(name), 1, &value[0]);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(getLocation(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(getLocation(name), 1, &value[0]);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(getLocation(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(getLocation(name), 1, &value[0]);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(getLocation(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    struct UniformInfo {
+        std::string name;
+        GLint location;
+    };
+    // active uniforms by name hash
+    std::unordered_map<uint32_t, UniformInfo> uniforms;
+
+    // fills the uniform table from the linked program. Arrays are listed under their own name, the name without
+    // "[0]", and each element's name
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(maxLength > 0 ? maxLength : 1, '\0');
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+            std::string uniformName = name.substr(0, length);
+            // members of uniform blocks have no location
+            GLint location = glGetUniformLocation(ID, uniformName.c_str());
+            if (location < 0)
+                continue;
+            addUniform(uniformName, location);
+
+            size_t bracket = uniformName.size() >= 3 ? uniformName.size() - 3 : std::string::npos;
+            if (bracket != std::string::npos && uniformName.compare(bracket, 3, "[0]") == 0)
+            {
+                std::string arrayName = uniformName.substr(0, bracket);
+                addUniform(arrayName, location);
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = arrayName + "[" + std::to_string(element) + "]";
+                    addUniform(elementName, glGetUniformLocation(ID, elementName.c_str()));
+                }
+            }
+        }
+    }
+
+    void addUniform(const std::string& name, GLint location)
+    {
+        UniformInfo info = { name, location };
+        std::pair<std::unordered_map<uint32_t, UniformInfo>::iterator, bool> result = uniforms.insert(std::make_pair(uniformHash(name.c_str()), info));
+        if (!result.second && result.first->second.name != name)
+            std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION: " << name << " and " << result.first->second.name << std::endl;
+    }
+
+    // the whole of a shader source file, empty if it can't be read
+    // ------------------------------------------------------------------------
+    static std::string readSource(const char* path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+            return "";
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        return stream.str();
+    }
+
+    // puts the defines after the #version line, which has to come first
+    // ------------------------------------------------------------------------
+    static std::string insertDefines(const std::string& code, const std::string& defines)
+    {
+        size_t lineEnd = code.compare(0, 8, "#version") == 0 ? code.find('\n') : std::string::npos;
+        if (lineEnd == std::string::npos)
+            return defines + code;
+        return code.substr(0, lineEnd + 1) + defines + code.substr(lineEnd + 1);
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
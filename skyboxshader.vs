@@ -3,14 +3,21 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+// per-frame camera state, see uniformblocks.h
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 terrainProjection;
+    vec3 cameraPos;
+};
 
 // adapted from https://learnopengl.com/Advanced-OpenGL/Cubemaps
 
 void main()
 {
     TexCoords = vec3(-aPos.x, -aPos.y, aPos.z);
-    vec4 pos = projection * view * vec4(aPos, 1.0);
+    // the skybox follows the camera, so only the view's rotation applies
+    vec4 pos = projection * mat4(mat3(view)) * vec4(aPos, 1.0);
     gl_Position = pos.xyww;
 }  
\ No newline at end of file
@@ -0,0 +1,17 @@
+// snow pressed down around the camera, see snowtrails.h. Inserted after the #version line of every terrain shader's
+// stages (see TerrainRenderer::shaderDefines), so it has no #version of its own
+uniform sampler2D snowTrails;
+layout (std140) uniform Snow
+{
+    // world x and z of the trail texture's corner, 1 / the world units it covers, and how deep a full trail sinks the ground
+    vec4 snowWindow;
+};
+
+// how far the snow at world (x, z) is pressed down, none outside the trail texture
+float snowDepth(vec2 xz)
+{
+    vec2 uv = (xz - snowWindow.xy) * snowWindow.z;
+    if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+        return 0.0;
+    return textureLod(snowTrails, uv, 0.0).r * snowWindow.w;
+}
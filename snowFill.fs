@@ -0,0 +1,10 @@
+#version 330 core
+out vec4 FragColor;
+
+// how much of a full-depth trail fills back in this frame, taken off every texel
+uniform float amount;
+
+void main()
+{
+    FragColor = vec4(amount, 0.0, 0.0, 0.0);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+// no vertex attributes: one triangle that covers the whole trail texture, from gl_VertexID
+
+void main()
+{
+    vec2 position = vec2(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1));
+    gl_Position = vec4(position, 0.0, 1.0);
+}
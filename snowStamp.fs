@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 fromCentre;
+
+void main()
+{
+    float distance = dot(fromCentre, fromCentre);
+    if (distance >= 1.0)
+        discard;
+    // (1 - d^2)^2, pressed right down in the middle and with no ridge at the edge
+    float depth = (1.0 - distance) * (1.0 - distance);
+    FragColor = vec4(depth, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,20 @@
+#version 330 core
+// a corner of the footprint's quad, from -1 to 1
+layout (location = 0) in vec2 corner;
+// world x and z of the walker making it, one per instance
+layout (location = 1) in vec2 footprint;
+
+out vec2 fromCentre;
+
+// world x and z of the trail texture's corner and 1 / the world units it covers, as in the Snow block
+uniform vec4 window;
+// world radius of a footprint
+uniform float radius;
+
+void main()
+{
+    fromCentre = corner;
+    // the trail texture's s runs along world x and its t along world z
+    vec2 uv = (footprint + corner * radius - window.xy) * window.z;
+    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,232 @@
+#ifndef SNOW_TRAILS_H
+#define SNOW_TRAILS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader_s.h"
+#include "uniformblocks.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// the terrain shaders read the trails from here, below the height texture's unit
+#define SNOW_TRAIL_TEXTURE_UNIT 13
+// texels along each side of the trail texture, and the world units they cover around the camera
+const int SNOW_TRAIL_TEXELS = 512;
+const float SNOW_TRAIL_EXTENT = 64.0f;
+// how far a fully trodden texel sinks the ground
+const float SNOW_TRAIL_DEPTH = 0.15f;
+// world radius of a footprint, and seconds for fresh snow to fill a full-depth trail back in
+const float SNOW_FOOTPRINT_RADIUS = 0.5f;
+const float SNOW_REFILL_SECONDS = 20.0f;
+
+// Deformable snow. The trails around the camera live in one R16 texture, SNOW_TRAIL_EXTENT world units across,
+// each texel holding how far the snow there is pressed down from 0 to 1. Each frame every walker stamps a round
+// footprint into it on the GPU, one instanced quad per walker blended with GL_MAX so a step never raises a deeper
+// one, and a full-screen pass takes a little off every texel as fresh snow fills the trails in. The terrain vertex
+// shaders sink each vertex by the texel under it (snowDepth in snowDepth.glsl, which every one is built with), so
+// thousands of walkers leave trails without the CPU touching a vertex or the heightmap.
+//
+// The texture's window follows the camera in whole texels. When it moves, what the two windows share is blitted
+// across into a second texture at its new place and the rest starts untrodden, so trails stay put in the world
+// and the texture never needs to wrap.
+class SnowTrails
+{
+public:
+    // whether walkers leave trails. Off, the window's depth is 0 and nothing is drawn
+    bool Enabled;
+
+    SnowTrails() : Enabled(true), current(0), origin(0), placed(false), stampVAO(0), cornerVBO(0), footprintVBO(0),
+        footprintCapacity(0), fillVAO(0)
+    {
+        textures[0] = textures[1] = 0;
+        framebuffers[0] = framebuffers[1] = 0;
+    }
+
+    void Init()
+    {
+        glGenTextures(2, textures);
+        glGenFramebuffers(2, framebuffers);
+        GLint previousFramebuffer;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        for (int i = 0; i < 2; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, SNOW_TRAIL_TEXELS, SNOW_TRAIL_TEXELS, 0, GL_RED, GL_UNSIGNED_SHORT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::SNOW_TRAILS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        glActiveTexture(GL_TEXTURE0 + SNOW_TRAIL_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, textures[current]);
+        glActiveTexture(GL_TEXTURE0);
+
+        // a footprint is a quad from -1 to 1 around its walker, one instance each
+        const float corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+        glGenVertexArrays(1, &stampVAO);
+        glBindVertexArray(stampVAO);
+        glGenBuffers(1, &cornerVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, cornerVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glGenBuffers(1, &footprintVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, footprintVBO);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+        glBindVertexArray(0);
+        // the fill pass makes its triangle from gl_VertexID, but core profile still wants a vertex array bound
+        glGenVertexArrays(1, &fillVAO);
+
+        stampShader.reset(new Shader("snowStamp.vs", "snowStamp.fs"));
+        stampWindow = stampShader->uniform<glm::vec4>("window");
+        stampShader->use();
+        stampShader->setFloat("radius", SNOW_FOOTPRINT_RADIUS);
+        fillShader.reset(new Shader("snowFill.vs", "snowFill.fs"));
+        fillAmount = fillShader->uniform<float>("amount");
+
+        block.Init(SNOW_BLOCK_BINDING);
+    }
+
+    // Moves the window to the camera, stamps a footprint at each of count positions (times scale to put them in world
+    // units, and only x and z are used) and lets the snow fill in for the given seconds, then uploads the Snow block.
+    // Once a frame before the terrain is drawn
+    void Update(const glm::vec3& cameraPos, const glm::vec3* positions, size_t count, float scale, float seconds)
+    {
+        PROFILE_SCOPE("SnowTrails::Update");
+        const float texelSize = SNOW_TRAIL_EXTENT / SNOW_TRAIL_TEXELS;
+        glm::ivec2 newOrigin((int)std::floor(cameraPos.x / texelSize) - SNOW_TRAIL_TEXELS / 2,
+            (int)std::floor(cameraPos.z / texelSize) - SNOW_TRAIL_TEXELS / 2);
+        glm::vec4 window(newOrigin.x * texelSize, newOrigin.y * texelSize, 1.0f / SNOW_TRAIL_EXTENT, Enabled ? SNOW_TRAIL_DEPTH : 0.0f);
+
+        if (Enabled)
+        {
+            GLint previousDraw, previousRead, viewport[4];
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDraw);
+            glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousRead);
+            glGetIntegerv(GL_VIEWPORT, viewport);
+
+            scroll(newOrigin);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[current]);
+            glViewport(0, 0, SNOW_TRAIL_TEXELS, SNOW_TRAIL_TEXELS);
+            glDisable(GL_DEPTH_TEST);
+
+            // fresh snow: every texel less the same amount, which the unsigned texture stops at 0
+            if (seconds > 0.0f)
+            {
+                glBlendEquation(GL_FUNC_REVERSE_SUBTRACT);
+                glBlendFunc(GL_ONE, GL_ONE);
+                fillShader->use();
+                fillShader->set(fillAmount, seconds / SNOW_REFILL_SECONDS);
+                glBindVertexArray(fillVAO);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }
+
+            // footprints, each keeping the deeper of itself and what's already there
+            if (count > 0)
+            {
+                footprints.resize(count);
+                for (size_t i = 0; i < count; i++)
+                    footprints[i] = glm::vec2(positions[i].x, positions[i].z) * scale;
+                glBindBuffer(GL_ARRAY_BUFFER, footprintVBO);
+                if (count > footprintCapacity)
+                {
+                    glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::vec2), &footprints[0], GL_STREAM_DRAW);
+                    footprintCapacity = count;
+                }
+                else
+                    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::vec2), &footprints[0]);
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+                glBlendEquation(GL_MAX);
+                stampShader->use();
+                stampShader->set(stampWindow, window);
+                glBindVertexArray(stampVAO);
+                glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)count);
+            }
+            glBindVertexArray(0);
+
+            // back to the state main.cpp draws the scene with
+            glBlendEquation(GL_FUNC_ADD);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glEnable(GL_DEPTH_TEST);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDraw);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, previousRead);
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        }
+
+        block.Data.window = window;
+        block.Upload();
+    }
+
+    void Destroy()
+    {
+        glDeleteFramebuffers(2, framebuffers);
+        glDeleteTextures(2, textures);
+        glDeleteVertexArrays(1, &stampVAO);
+        glDeleteVertexArrays(1, &fillVAO);
+        glDeleteBuffers(1, &cornerVBO);
+        glDeleteBuffers(1, &footprintVBO);
+        block.Destroy();
+    }
+
+private:
+    // the texture the terrain reads and the one the next scroll copies into
+    unsigned int textures[2];
+    unsigned int framebuffers[2];
+    int current;
+    // the window's first texel, counted in texels from the world origin
+    glm::ivec2 origin;
+    bool placed;
+    unsigned int stampVAO, cornerVBO, footprintVBO;
+    size_t footprintCapacity;
+    unsigned int fillVAO;
+    std::vector<glm::vec2> footprints;
+    std::unique_ptr<Shader> stampShader, fillShader;
+    Uniform<glm::vec4> stampWindow;
+    Uniform<float> fillAmount;
+    UniformBlock<SnowBlock> block;
+
+    // moves the window to start at newOrigin, keeping the trails the old and new windows share
+    void scroll(const glm::ivec2& newOrigin)
+    {
+        glm::ivec2 shift = newOrigin - origin;
+        bool first = !placed;
+        origin = newOrigin;
+        placed = true;
+        if (!first && shift == glm::ivec2(0))
+            return;
+
+        int next = 1 - current;
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[next]);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        // texel t of the new window is texel t + shift of the old one
+        if (!first && std::abs(shift.x) < SNOW_TRAIL_TEXELS && std::abs(shift.y) < SNOW_TRAIL_TEXELS)
+        {
+            glm::ivec2 low = glm::max(-shift, glm::ivec2(0));
+            glm::ivec2 high = glm::min(glm::ivec2(SNOW_TRAIL_TEXELS) - shift, glm::ivec2(SNOW_TRAIL_TEXELS));
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[current]);
+            glBlitFramebuffer(low.x + shift.x, low.y + shift.y, high.x + shift.x, high.y + shift.y,
+                low.x, low.y, high.x, high.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        current = next;
+        glActiveTexture(GL_TEXTURE0 + SNOW_TRAIL_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, textures[current]);
+        glActiveTexture(GL_TEXTURE0);
+    }
+};
+#endif
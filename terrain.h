@@ -0,0 +1,342 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader_s.h"
+#include "heightmap.h"
+#include "benchmark.h"
+#include "uniformblocks.h"
+#include "profiler.h"
+#include "terrainbuilder.h"
+#include "horizonculler.h"
+#include "snowtrails.h"
+#include "terrainlighting.h"
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+class TileSource;
+
+// Ways of drawing the heightmap, chosen with --terrain
+enum Terrain_Mode {
+    TERRAIN_STRIPS,     // the whole map at full resolution, one triangle strip per row
+    TERRAIN_PULLED,     // the same strips with positions rebuilt in the vertex shader from a height texture
+    TERRAIN_CDLOD,      // quadtree of chunks with distance-based LOD and frustum culling
+    TERRAIN_PAGED,      // tiles of a mip pyramid paged in from disk around the camera
+    TERRAIN_TESSELLATED,    // fixed patches split on the GPU by their size on screen, needs GL 4.0
+    TERRAIN_CLIPMAP,    // nested rings around the camera with heights in toroidally updated textures
+    TERRAIN_RTIN,       // right-triangle mesh simplified to a height error tolerance
+    TERRAIN_PROCEDURAL, // the paged tiles made from fractal noise as they're needed, with no heightmap
+    TERRAIN_MODE_COUNT
+};
+
+inline const char* terrainModeName(Terrain_Mode mode)
+{
+    switch (mode)
+    {
+    case TERRAIN_STRIPS: return "strips";
+    case TERRAIN_PULLED: return "pulled";
+    case TERRAIN_CDLOD: return "cdlod";
+    case TERRAIN_PAGED: return "paged";
+    case TERRAIN_TESSELLATED: return "tessellated";
+    case TERRAIN_CLIPMAP: return "clipmap";
+    case TERRAIN_RTIN: return "rtin";
+    case TERRAIN_PROCEDURAL: return "procedural";
+    default: break;
+    }
+    return "";
+}
+
+// whether a mode pages its tiles in from a source instead of drawing the heightmap, which isn't loaded
+inline bool isPagedTerrain(Terrain_Mode mode)
+{
+    return mode == TERRAIN_PAGED || mode == TERRAIN_PROCEDURAL;
+}
+
+// returns false if the name isn't a terrain mode
+inline bool parseTerrainMode(const std::string& name, Terrain_Mode& mode)
+{
+    for (int i = 0; i < TERRAIN_MODE_COUNT; i++)
+    {
+        if (name == terrainModeName((Terrain_Mode)i))
+        {
+            mode = (Terrain_Mode)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Draws the heightmap. The camera block (uniformblocks.h) must be uploaded before Draw
+class TerrainRenderer
+{
+public:
+    // what the last Draw did
+    size_t NodesDrawn;
+    size_t TrianglesDrawn;
+    size_t DrawCalls;
+    // GPU memory taken by the terrain's buffers and textures, and CPU memory kept for it after Init
+    size_t GpuBytes;
+    size_t CpuBytes;
+
+    TerrainRenderer() : NodesDrawn(0), TrianglesDrawn(0), DrawCalls(0), GpuBytes(0), CpuBytes(0), occlusion(NULL), heightTextureRange(0.0f) {}
+    virtual ~TerrainRenderer() {}
+
+    // creates the GL resources for a heightmap, false on failure
+    virtual bool Init(const Heightmap& heightmap) = 0;
+    // draws the terrain as seen from cameraPos through viewProjection (used for culling)
+    virtual void Draw(const glm::vec3& cameraPos, const glm::mat4& viewProjection) = 0;
+    virtual void Destroy() = 0;
+
+    // replaces the heights with a new heightmap's, by default by building everything again
+    virtual bool UpdateHeights(const Heightmap& heightmap)
+    {
+        Destroy();
+        return Init(heightmap);
+    }
+
+    // Replaces the heights in rect after an edit, which left the rest of the heightmap as it was. Modes that can send
+    // just that part to the GPU do, by default everything is updated
+    virtual bool UpdateRegion(const Heightmap& heightmap, const HeightmapRect& rect)
+    {
+        return UpdateHeights(heightmap);
+    }
+
+    // the framebuffer's current height in pixels, for modes that size their triangles on screen. Called every frame, so
+    // a resized window takes effect on the next Draw
+    virtual void SetViewportHeight(float height)
+    {
+    }
+
+    // sets the largest height error the mesh may have, for modes that simplify it to one, false for the others
+    virtual bool SetErrorTolerance(float tolerance)
+    {
+        return false;
+    }
+
+    // the source the heights are paged in from while the terrain is initialised, for modes that don't draw the
+    // heightmap, NULL for the others
+    virtual const TileSource* Tiles() const
+    {
+        return NULL;
+    }
+
+    // a horizon, built for the camera before each Draw, that modes drawn in chunks drop hidden chunks with. NULL
+    // (the default) culls against the view frustum only
+    void SetOcclusion(const HorizonCuller* culler)
+    {
+        occlusion = culler;
+    }
+
+    // keeps this frame's counts for the report
+    void EndFrame()
+    {
+        nodeCounts.push_back((double)NodesDrawn);
+        triangleCounts.push_back((double)TrianglesDrawn);
+        drawCallCounts.push_back((double)DrawCalls);
+    }
+
+    // JSON object of nodes, triangles and draw calls per frame
+    std::string ReportJson(Terrain_Mode mode) const
+    {
+        std::ostringstream json;
+        json << "{\n    \"mode\": \"" << terrainModeName(mode) << "\",\n"
+            << "    \"gpu_bytes\": " << GpuBytes << ",\n"
+            << "    \"cpu_bytes\": " << CpuBytes << ",\n"
+            << "    \"nodes\": " << summariseTimes(nodeCounts) << ",\n"
+            << "    \"triangles\": " << summariseTimes(triangleCounts) << ",\n"
+            << "    \"draw_calls\": " << summariseTimes(drawCallCounts) << "\n  }";
+        return json.str();
+    }
+
+protected:
+    const HorizonCuller* occlusion;
+    // the heights the height texture's texels span
+    glm::vec2 heightTextureRange;
+
+    // A terrain shader's defines followed by snowDepth.glsl, the Snow block and snowDepth() every mode sinks its
+    // vertices with. Shader inserts them into every stage, and the stages that don't call snowDepth compile it out
+    static std::string shaderDefines(const std::string& defines = "")
+    {
+        std::ifstream file("snowDepth.glsl");
+        std::stringstream source;
+        source << file.rdbuf();
+        if (!file)
+            std::cout << "ERROR::TERRAIN::SNOW_SOURCE_NOT_READ: snowDepth.glsl" << std::endl;
+        return defines + source.str();
+    }
+
+    // makes a terrain shader read the per-frame blocks and the heightmap, snow trail and lighting textures
+    static void setUpShader(Shader& shader)
+    {
+        shader.bindBlock("Camera", CAMERA_BLOCK_BINDING);
+        shader.bindBlock("Fog", FOG_BLOCK_BINDING);
+        shader.bindBlock("Snow", SNOW_BLOCK_BINDING);
+        shader.bindBlock("TerrainLighting", TERRAIN_LIGHTING_BLOCK_BINDING);
+        shader.use();
+        shader.setInt("heightmap", HEIGHTMAP_TEXTURE_UNIT);
+        shader.setInt("snowTrails", SNOW_TRAIL_TEXTURE_UNIT);
+        shader.setInt("terrainNormals", TERRAIN_NORMAL_TEXTURE_UNIT);
+        shader.setInt("terrainOcclusion", TERRAIN_OCCLUSION_TEXTURE_UNIT);
+    }
+
+    // creates the height texture (see Heightmap::CreateTexture), leaves it bound to HEIGHTMAP_TEXTURE_UNIT and gives
+    // its height range to the shader
+    unsigned int createHeightTexture(const Heightmap& heightmap, Shader& shader)
+    {
+        glm::vec2& range = heightTextureRange;
+        unsigned int texture = heightmap.CreateTexture(range);
+        glActiveTexture(GL_TEXTURE0 + HEIGHTMAP_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glActiveTexture(GL_TEXTURE0);
+        shader.use();
+        shader.setVec2("heightRange", range);
+        shader.setVec2("heightmapSize", glm::vec2((float)heightmap.Rows, (float)heightmap.Columns));
+        shader.setFloat("spacing", HEIGHTMAP_SPACING);
+        return texture;
+    }
+
+    // uploads new heights of the same size to the texture, a single texture upload
+    void updateHeightTexture(const Heightmap& heightmap, unsigned int texture, Shader& shader)
+    {
+        heightmap.UpdateTexture(texture, heightTextureRange);
+        shader.use();
+        shader.setVec2("heightRange", heightTextureRange);
+    }
+
+    // Uploads the texels of an edited rect. Heights edited past the texture's range need every texel quantised
+    // again, so the new range leaves HEIGHTMAP_EDIT_HEADROOM for the edits after
+    void updateHeightTextureRegion(const Heightmap& heightmap, const HeightmapRect& rect, unsigned int texture, Shader& shader)
+    {
+        if (heightmap.UpdateTextureRegion(texture, heightTextureRange, rect))
+            return;
+        heightmap.UpdateTexture(texture, heightTextureRange, HEIGHTMAP_EDIT_HEADROOM);
+        shader.use();
+        shader.setVec2("heightRange", heightTextureRange);
+    }
+
+private:
+    std::vector<double> nodeCounts, triangleCounts, drawCallCounts;
+};
+
+// The original terrain: every sample is a vertex, and each row of quads is a triangle strip drawn on its own. The mesh
+// is made by TerrainMeshBuilder
+//
+// heightmap adapted from https://learnopengl.com/Guest-Articles/2021/Tessellation/Height-map
+class StripTerrain : public TerrainRenderer
+{
+public:
+    StripTerrain() : VAO(0), VBO(0), IBO(0), numStrips(0), numTrisPerStrip(0) {}
+
+    bool Init(const Heightmap& heightmap) override
+    {
+        size_t vertexCount = TerrainMeshBuilder::VertexCount(heightmap), indexCount = TerrainMeshBuilder::IndexCount(heightmap);
+        numStrips = heightmap.Rows - 1;
+        numTrisPerStrip = heightmap.Columns * 2 - 2;
+
+        PROFILE_BEGIN(terrainBuildZone, "Build terrain mesh");
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * 3 * sizeof(float), NULL, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glGenBuffers(1, &IBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned), NULL, GL_STATIC_DRAW);
+
+        // the mesh is built straight into the buffers, falling back to a copy if the driver won't map them
+        TerrainMeshBuilder builder;
+        float* vertices = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, vertexCount * 3 * sizeof(float), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        unsigned* indices = (unsigned*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, indexCount * sizeof(unsigned), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (vertices && indices)
+            builder.Build(heightmap, vertices, NULL, indices);
+        bool unmapped = (!vertices || glUnmapBuffer(GL_ARRAY_BUFFER)) && (!indices || glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER));
+        if (!vertices || !indices || !unmapped)
+        {
+            std::cout << "ERROR::TERRAIN::BUFFER_NOT_MAPPED: building the terrain mesh in memory instead" << std::endl;
+            std::vector<float> vertexData(vertexCount * 3);
+            std::vector<unsigned> indexData(indexCount);
+            builder.Build(heightmap, &vertexData[0], NULL, &indexData[0]);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, vertexData.size() * sizeof(float), &vertexData[0]);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexData.size() * sizeof(unsigned), &indexData[0]);
+        }
+        glBindVertexArray(0);
+        GpuBytes = (vertexCount * 3 + indexCount) * sizeof(float);
+        PROFILE_END(terrainBuildZone);
+
+        std::cout << "Loaded " << vertexCount << " vertices" << std::endl;
+        std::cout << "Loaded " << indexCount << " indices" << std::endl;
+        std::cout << "Created lattice of " << numStrips << " strips with " << numTrisPerStrip << " triangles each" << std::endl;
+        std::cout << "Created " << numStrips * numTrisPerStrip << " triangles total" << std::endl;
+
+        shader.reset(new Shader("heightMapShader.vs", "heightMapShader.fs", shaderDefines()));
+        setUpShader(*shader);
+        modelUniform = shader->uniform<glm::mat4>("model");
+        return true;
+    }
+
+    void Draw(const glm::vec3& cameraPos, const glm::mat4& viewProjection) override
+    {
+        shader->use();
+        shader->set(modelUniform, glm::mat4(1.0f));
+
+        glBindVertexArray(VAO);
+        for (int strip = 0; strip < numStrips; strip++)
+        {
+            glDrawElements(GL_TRIANGLE_STRIP,
+                numTrisPerStrip + 2,
+                GL_UNSIGNED_INT,
+                (void*)(sizeof(unsigned) * (numTrisPerStrip + 2) * strip));
+        }
+        glBindVertexArray(0);
+
+        NodesDrawn = numStrips;
+        TrianglesDrawn = (size_t)numStrips * numTrisPerStrip;
+        DrawCalls = numStrips;
+    }
+
+    // the edited vertices are uploaded a row at a time, each row's part of the buffer being contiguous
+    bool UpdateRegion(const Heightmap& heightmap, const HeightmapRect& rect) override
+    {
+        PROFILE_SCOPE("StripTerrain::UpdateRegion");
+        if (heightmap.Rows - 1 != numStrips || heightmap.Columns * 2 - 2 != numTrisPerStrip)
+            return UpdateHeights(heightmap);
+        int width = rect.LastColumn - rect.FirstColumn + 1;
+        regionPositions.resize((size_t)(rect.LastRow - rect.FirstRow + 1) * width * 3);
+        TerrainMeshBuilder::BuildRegion(heightmap, rect, &regionPositions[0]);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        for (int row = rect.FirstRow; row <= rect.LastRow; row++)
+        {
+            size_t vertex = (size_t)row * heightmap.Columns + rect.FirstColumn;
+            glBufferSubData(GL_ARRAY_BUFFER, vertex * 3 * sizeof(float), width * 3 * sizeof(float),
+                &regionPositions[(size_t)(row - rect.FirstRow) * width * 3]);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return true;
+    }
+
+    void Destroy() override
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &IBO);
+    }
+
+private:
+    unsigned int VAO, VBO, IBO;
+    int numStrips;
+    int numTrisPerStrip;
+    std::unique_ptr<Shader> shader;
+    Uniform<glm::mat4> modelUniform;
+    // positions of the last edited rect, kept between edits
+    std::vector<float> regionPositions;
+};
+#endif
@@ -0,0 +1,62 @@
+#version 330 core
+layout (location = 0) in vec2 gridPos;
+// the node being drawn: first row, first column, size in samples, LOD level
+layout (location = 1) in vec4 node;
+
+out float Height;
+out vec3 Position;
+out float distance;
+// world x and z, where the fragment shader reads the baked lighting
+out vec2 WorldXZ;
+
+// MAX_LODS and GRID_SIZE are defined by cdlodterrain.h
+uniform sampler2D heightmap;
+// rows and columns, and the heights the texture's 0 and 1 stand for (see Heightmap::CreateTexture)
+uniform vec2 heightmapSize;
+uniform vec2 heightRange;
+uniform float spacing;
+// distance from the camera where each level starts and finishes morphing into the next
+uniform vec2 morphRanges[MAX_LODS];
+
+// per-frame camera state, see uniformblocks.h
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 terrainProjection;
+    vec3 cameraPos;
+};
+
+// the Snow block and snowDepth() come from snowDepth.glsl, inserted after #version by the terrain
+
+// (row, column) of a sample to a world position, with its height from the heightmap. Nodes and their morphs only
+// land on whole samples, so the texel is read directly
+vec3 samplePosition(vec2 sample)
+{
+    sample = clamp(sample, vec2(0.0), heightmapSize - 1.0);
+    float height = mix(heightRange.x, heightRange.y, texelFetch(heightmap, ivec2(sample.yx + 0.5), 0).r);
+    return vec3((sample.x - heightmapSize.x * 0.5) * spacing, height, (sample.y - heightmapSize.y * 0.5) * spacing);
+}
+
+// CDLOD vertex morphing (Strugar 2009): odd grid vertices slide onto their even neighbours, so by the end of the
+// range the node matches the next level's grid
+void main()
+{
+    vec2 origin = node.xy;
+    float size = node.z;
+    int level = int(node.w);
+
+    vec3 worldPos = samplePosition(origin + gridPos * size);
+    vec2 morphRange = morphRanges[level];
+    float morph = clamp((length(cameraPos - worldPos) - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+    vec2 morphedGrid = gridPos - fract(gridPos * GRID_SIZE * 0.5) * 2.0 / GRID_SIZE * morph;
+    worldPos = samplePosition(origin + morphedGrid * size);
+    worldPos.y -= snowDepth(worldPos.xz);
+
+    Height = worldPos.y;
+    WorldXZ = worldPos.xz;
+    Position = (view * vec4(worldPos, 1.0)).xyz;
+    gl_Position = terrainProjection * view * vec4(worldPos, 1.0);
+
+    distance = length(cameraPos - worldPos);
+}
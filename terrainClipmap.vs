@@ -0,0 +1,75 @@
+#version 330 core
+layout (location = 0) in vec2 localPos;
+// where the mesh goes: first (row, column) in samples, then the samples per local unit, negative to mirror it
+layout (location = 1) in vec4 offsetScale;
+// the clipmap level it belongs to
+layout (location = 2) in float level;
+
+out float Height;
+out vec3 Position;
+out float distance;
+// world x and z, where the fragment shader reads the baked lighting
+out vec2 WorldXZ;
+
+// MAX_LEVELS, TEXTURE_SIZE, HALF_EXTENT and TRANSITION_WIDTH are defined by clipmapterrain.h
+// one layer per level, each level's heights wrapped round it
+uniform sampler2DArray heightmap;
+// rows and columns, and the heights the texture's 0 and 1 stand for
+uniform vec2 heightmapSize;
+uniform vec2 heightRange;
+uniform float spacing;
+uniform int levelCount;
+// the middle of each level, in its own units
+uniform vec2 levelCentres[MAX_LEVELS];
+
+// per-frame camera state, see uniformblocks.h
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 terrainProjection;
+    vec3 cameraPos;
+};
+
+// the Snow block and snowDepth() come from snowDepth.glsl, inserted after #version by the terrain
+
+// height at a level's (row, column), from wherever it has wrapped to in the layer
+float levelHeight(ivec2 coordinate, int layer)
+{
+    ivec2 texel = coordinate & (TEXTURE_SIZE - 1);
+    return mix(heightRange.x, heightRange.y, texelFetch(heightmap, ivec3(texel.yx, layer), 0).r);
+}
+
+void main()
+{
+    vec2 samplePos = offsetScale.xy + localPos * offsetScale.zw;
+    int lod = int(level);
+    vec2 levelPos = samplePos / exp2(level);
+    float height = levelHeight(ivec2(levelPos), lod);
+
+    // Towards the outside of a level its heights blend into the next level's, which at odd vertices are the average
+    // of the coarser samples either side. At the edge the blend is complete, so vertices the coarser level doesn't
+    // have lie on its triangles and the levels meet without cracks
+    if (lod + 1 < levelCount)
+    {
+        vec2 fromCentre = abs(levelPos - levelCentres[lod]);
+        float blend = clamp((max(fromCentre.x, fromCentre.y) - (HALF_EXTENT - TRANSITION_WIDTH - 1.0)) / TRANSITION_WIDTH, 0.0, 1.0);
+        ivec2 coarseLow = ivec2(floor(levelPos * 0.5));
+        ivec2 coarseHigh = ivec2(ceil(levelPos * 0.5));
+        float coarseHeight = 0.25 * (levelHeight(coarseLow, lod + 1) + levelHeight(ivec2(coarseHigh.x, coarseLow.y), lod + 1)
+            + levelHeight(ivec2(coarseLow.x, coarseHigh.y), lod + 1) + levelHeight(coarseHigh, lod + 1));
+        height = mix(height, coarseHeight, blend);
+    }
+
+    // parts of the rings past the edge of the map fold onto it
+    samplePos = clamp(samplePos, vec2(0.0), heightmapSize - 1.0);
+    vec3 worldPos = vec3((samplePos.x - heightmapSize.x * 0.5) * spacing, height, (samplePos.y - heightmapSize.y * 0.5) * spacing);
+    worldPos.y -= snowDepth(worldPos.xz);
+
+    Height = worldPos.y;
+    WorldXZ = worldPos.xz;
+    Position = (view * vec4(worldPos, 1.0)).xyz;
+    gl_Position = terrainProjection * view * vec4(worldPos, 1.0);
+
+    distance = length(cameraPos - worldPos);
+}
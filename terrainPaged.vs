@@ -0,0 +1,48 @@
+#version 330 core
+// a sample of the tile's grid as (row, column), and 1 for the skirt hanging below its edges
+layout (location = 0) in vec3 gridPos;
+// the tile being drawn: first row, first column, size in samples, texture array layer
+layout (location = 1) in vec4 tile;
+
+out float Height;
+out vec3 Position;
+out float distance;
+// world x and z, where the fragment shader reads the baked lighting
+out vec2 WorldXZ;
+
+// TILE_SIZE and SKIRT_DEPTH are defined by pagedterrain.h
+uniform sampler2DArray heightmap;
+// rows and columns of the whole map, and the heights the texture's 0 and 1 stand for (see tiledheightmap.h)
+uniform vec2 heightmapSize;
+uniform vec2 heightRange;
+uniform float spacing;
+
+// per-frame camera state, see uniformblocks.h
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 terrainProjection;
+    vec3 cameraPos;
+};
+
+// the Snow block and snowDepth() come from snowDepth.glsl, inserted after #version by the terrain
+
+void main()
+{
+    float step = tile.z / TILE_SIZE;
+    float height = mix(heightRange.x, heightRange.y, texelFetch(heightmap, ivec3(gridPos.yx, tile.w), 0).r);
+    height -= gridPos.z * SKIRT_DEPTH * step * spacing;
+
+    // tiles at the edge of the map hang over it, their samples past the edge fold back onto it
+    vec2 samplePos = min(tile.xy + gridPos.xy * step, heightmapSize - 1.0);
+    vec3 worldPos = vec3((samplePos.x - heightmapSize.x * 0.5) * spacing, height, (samplePos.y - heightmapSize.y * 0.5) * spacing);
+    worldPos.y -= snowDepth(worldPos.xz);
+
+    Height = worldPos.y;
+    WorldXZ = worldPos.xz;
+    Position = (view * vec4(worldPos, 1.0)).xyz;
+    gl_Position = terrainProjection * view * vec4(worldPos, 1.0);
+
+    distance = length(cameraPos - worldPos);
+}
@@ -0,0 +1,48 @@
+#version 330 core
+// no vertex attributes: each vertex's sample comes from gl_VertexID, see pulledterrain.h
+
+out float Height;
+out vec3 Position;
+out float distance;
+// world x and z, where the fragment shader reads the baked lighting
+out vec2 WorldXZ;
+
+uniform sampler2D heightmap;
+// rows and columns, and the heights the texture's 0 and 1 stand for (see Heightmap::CreateTexture)
+uniform vec2 heightmapSize;
+uniform vec2 heightRange;
+uniform float spacing;
+
+// per-frame camera state, see uniformblocks.h
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 terrainProjection;
+    vec3 cameraPos;
+};
+
+// the Snow block and snowDepth() come from snowDepth.glsl, inserted after #version by the terrain
+
+// adapted from https://learnopengl.com/Guest-Articles/2021/Tessellation/Height-map
+
+void main()
+{
+    // strip i alternates between rows i and i + 1, one column at a time
+    int columns = int(heightmapSize.y);
+    int strip = gl_VertexID / (columns * 2);
+    int inStrip = gl_VertexID - strip * columns * 2;
+    int row = strip + inStrip % 2;
+    int column = inStrip / 2;
+
+    float height = mix(heightRange.x, heightRange.y, texelFetch(heightmap, ivec2(column, row), 0).r);
+    vec3 aPos = vec3((float(row) - heightmapSize.x * 0.5) * spacing, height, (float(column) - heightmapSize.y * 0.5) * spacing);
+    aPos.y -= snowDepth(aPos.xz);
+
+    Height = aPos.y;
+    WorldXZ = aPos.xz;
+    Position = (view * vec4(aPos, 1.0)).xyz;
+    gl_Position = terrainProjection * view * vec4(aPos, 1.0);
+
+    distance = length(cameraPos - aPos);
+}
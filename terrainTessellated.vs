@@ -0,0 +1,10 @@
+#version 400 core
+// one corner of a patch: its sample, and the lowest and highest height in the patch, see tessellatedterrain.h
+layout (location = 0) in vec4 aCorner;
+
+out vec4 Corner;
+
+void main()
+{
+    Corner = aCorner;
+}
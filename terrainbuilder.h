@@ -0,0 +1,294 @@
+#ifndef TERRAIN_BUILDER_H
+#define TERRAIN_BUILDER_H
+
+#include "heightmap.h"
+#include "benchmark.h"
+#include "profiler.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Builds the strip terrain's mesh (see StripTerrain): a position for every heightmap sample, optionally a normal,
+// and for each pair of rows a triangle strip's worth of indices. Output goes to memory the caller provides, such as
+// mapped GL buffers, so nothing is copied after the build. Rows are split between worker threads, and within a row
+// four samples are done at once with SSE2.
+//
+// Positions match the original per-sample loop exactly, so the terrain looks the same however it was built.
+class TerrainMeshBuilder
+{
+public:
+    // threads to split the rows over, 0 for one per hardware thread
+    unsigned int Threads;
+
+    TerrainMeshBuilder() : Threads(0) {}
+
+    static size_t VertexCount(const Heightmap& heightmap)
+    {
+        return (size_t)heightmap.Rows * heightmap.Columns;
+    }
+
+    // two indices per column for every strip, one strip per pair of rows
+    static size_t IndexCount(const Heightmap& heightmap)
+    {
+        return heightmap.Rows > 1 ? (size_t)(heightmap.Rows - 1) * heightmap.Columns * 2 : 0;
+    }
+
+    // positions takes VertexCount * 3 floats, normals (which may be NULL) the same, and indices IndexCount
+    void Build(const Heightmap& heightmap, float* positions, float* normals, unsigned* indices) const
+    {
+        PROFILE_SCOPE("TerrainMeshBuilder::Build");
+        int height = heightmap.Rows, width = heightmap.Columns;
+        // z only depends on the column, so it's worked out once for every row, with the original loop's arithmetic
+        std::vector<float> columnZ(width);
+        for (int j = 0; j < width; j++)
+            columnZ[j] = (-width / 2.0f + width * j / (float)width) / 2.0f;
+
+        inShares((size_t)height, Threads, 1, [&](size_t first, size_t end)
+        {
+            buildRows(heightmap, &columnZ[0], positions, normals, indices, (int)first, (int)end);
+        });
+    }
+
+    // the positions of the samples in rect, row by row, exactly as Build writes them, for updating part of a mesh
+    static void BuildRegion(const Heightmap& heightmap, const HeightmapRect& rect, float* positions)
+    {
+        int height = heightmap.Rows, width = heightmap.Columns;
+        for (int i = rect.FirstRow; i <= rect.LastRow; i++)
+        {
+            float rowX = (-height / 2.0f + height * i / (float)height) / 2.0f;
+            for (int j = rect.FirstColumn; j <= rect.LastColumn; j++)
+            {
+                positions[0] = rowX;
+                positions[1] = heightmap.Heights[(size_t)i * width + j];
+                positions[2] = (-width / 2.0f + width * j / (float)width) / 2.0f;
+                positions += 3;
+            }
+        }
+    }
+
+private:
+    void buildRows(const Heightmap& heightmap, const float* columnZ, float* positions, float* normals, unsigned* indices, int firstRow, int endRow) const
+    {
+        PROFILE_SCOPE("TerrainMeshBuilder::buildRows");
+        int height = heightmap.Rows;
+        for (int i = firstRow; i < endRow; i++)
+        {
+            float rowX = (-height / 2.0f + height * i / (float)height) / 2.0f;
+            buildPositions(heightmap, i, rowX, columnZ, positions);
+            if (normals)
+                buildNormals(heightmap, i, normals);
+            if (i < height - 1)
+                buildStrip(heightmap, i, indices);
+        }
+    }
+
+#if SSE2_ENABLED
+    // writes x, y and z of four vertices as 12 consecutive floats
+    static void storeInterleaved(float* out, __m128 x, __m128 y, __m128 z)
+    {
+        __m128 xy01 = _mm_unpacklo_ps(x, y);     // x0 y0 x1 y1
+        __m128 xy23 = _mm_unpackhi_ps(x, y);     // x2 y2 x3 y3
+        __m128 z0x1 = _mm_shuffle_ps(z, xy01, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128 y1z1 = _mm_shuffle_ps(xy01, z, _MM_SHUFFLE(1, 1, 3, 3));
+        __m128 z2x3 = _mm_shuffle_ps(z, xy23, _MM_SHUFFLE(2, 2, 2, 2));
+        __m128 y3z3 = _mm_shuffle_ps(xy23, z, _MM_SHUFFLE(3, 3, 3, 3));
+        _mm_storeu_ps(out, _mm_shuffle_ps(xy01, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+        _mm_storeu_ps(out + 4, _mm_shuffle_ps(y1z1, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+        _mm_storeu_ps(out + 8, _mm_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+#endif
+
+    static void buildPositions(const Heightmap& heightmap, int row, float rowX, const float* columnZ, float* positions)
+    {
+        int width = heightmap.Columns;
+        const float* heights = &heightmap.Heights[(size_t)row * width];
+        float* out = positions + (size_t)row * width * 3;
+        int j = 0;
+#if SSE2_ENABLED
+        __m128 x = _mm_set1_ps(rowX);
+        for (; j + 4 <= width; j += 4)
+            storeInterleaved(out + j * 3, x, _mm_loadu_ps(heights + j), _mm_loadu_ps(columnZ + j));
+#endif
+        for (; j < width; j++)
+        {
+            out[j * 3] = rowX;
+            out[j * 3 + 1] = heights[j];
+            out[j * 3 + 2] = columnZ[j];
+        }
+    }
+
+    // central differences, with the samples past the edge taken as the edge's
+    static void buildNormals(const Heightmap& heightmap, int row, float* normals)
+    {
+        int width = heightmap.Columns;
+        const float* above = &heightmap.Heights[(size_t)std::max(row - 1, 0) * width];
+        const float* centre = &heightmap.Heights[(size_t)row * width];
+        const float* below = &heightmap.Heights[(size_t)std::min(row + 1, heightmap.Rows - 1) * width];
+        float* out = normals + (size_t)row * width * 3;
+        const float scale = -0.5f / HEIGHTMAP_SPACING;
+
+        int j = 0;
+        // the first and last columns need clamping, the ones between can read both neighbours
+        if (width > 0)
+            storeNormal(out, scale * (below[0] - above[0]), scale * (centre[std::min(1, width - 1)] - centre[0]));
+        j = 1;
+#if SSE2_ENABLED
+        __m128 vScale = _mm_set1_ps(scale);
+        __m128 one = _mm_set1_ps(1.0f);
+        for (; j + 4 < width; j += 4)
+        {
+            __m128 nx = _mm_mul_ps(vScale, _mm_sub_ps(_mm_loadu_ps(below + j), _mm_loadu_ps(above + j)));
+            __m128 nz = _mm_mul_ps(vScale, _mm_sub_ps(_mm_loadu_ps(centre + j + 1), _mm_loadu_ps(centre + j - 1)));
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(nz, nz)), one));
+            storeInterleaved(out + j * 3, _mm_div_ps(nx, length), _mm_div_ps(one, length), _mm_div_ps(nz, length));
+        }
+#endif
+        for (; j < width; j++)
+            storeNormal(out + j * 3, scale * (below[j] - above[j]), scale * (centre[std::min(j + 1, width - 1)] - centre[j - 1]));
+    }
+
+    static void storeNormal(float* out, float nx, float nz)
+    {
+        float length = std::sqrt(nx * nx + 1.0f + nz * nz);
+        out[0] = nx / length;
+        out[1] = 1.0f / length;
+        out[2] = nz / length;
+    }
+
+    // strip i alternates between rows i and i + 1
+    static void buildStrip(const Heightmap& heightmap, int strip, unsigned* indices)
+    {
+        unsigned width = (unsigned)heightmap.Columns;
+        unsigned* out = indices + (size_t)strip * width * 2;
+        unsigned top = width * strip, bottom = width * (strip + 1);
+        unsigned j = 0;
+#if SSE2_ENABLED
+        __m128i pair = _mm_setr_epi32((int)top, (int)bottom, (int)top + 1, (int)bottom + 1);
+        __m128i two = _mm_set1_epi32(2);
+        for (; j + 2 <= width; j += 2)
+        {
+            _mm_storeu_si128((__m128i*)(out + j * 2), pair);
+            pair = _mm_add_epi32(pair, two);
+        }
+#endif
+        for (; j < width; j++)
+        {
+            out[j * 2] = top + j;
+            out[j * 2 + 1] = bottom + j;
+        }
+    }
+};
+
+// The strip mesh as main.cpp used to build it, a push_back at a time. Kept as the baseline for the benchmark below
+inline void buildTerrainMeshReference(const Heightmap& heightmap, std::vector<float>& vertices, std::vector<unsigned>& indices)
+{
+    int height = heightmap.Rows, width = heightmap.Columns;
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            vertices.push_back((-height / 2.0f + height * i / (float)height) / 2.0f);
+            vertices.push_back(heightmap.Heights[(size_t)i * width + j]);
+            vertices.push_back((-width / 2.0f + width * j / (float)width) / 2.0f);
+        }
+    }
+    for (unsigned i = 0; i < height - 1; i++)
+        for (unsigned j = 0; j < width; j++)
+            for (unsigned k = 0; k < 2; k++)
+                indices.push_back(j + width * (i + k));
+}
+
+// Times the reference build against TerrainMeshBuilder on made-up heightmaps from 256 x 256 up to maxSize x maxSize,
+// doubling each time, and writes the report as JSON to outputPath (stdout when empty). Needs no GL context.
+// The builder's output is checked against the reference at every size.
+inline bool runTerrainBuildBenchmark(int maxSize, const std::string& outputPath)
+{
+    typedef std::chrono::steady_clock Clock;
+    std::ostringstream report;
+    unsigned int threads = threadsToUse(0);
+    report << "{\n  \"threads\": " << threads << ",\n  \"simd\": " << (SSE2_ENABLED ? "true" : "false") << ",\n  \"sizes\": [";
+    bool matches = true;
+
+    for (int size = 256; size <= maxSize; size *= 2)
+    {
+        Heightmap heightmap;
+        heightmap.Rows = heightmap.Columns = size;
+        heightmap.Heights.resize((size_t)size * size);
+        for (int i = 0; i < size; i++)
+            for (int j = 0; j < size; j++)
+                heightmap.Heights[(size_t)i * size + j] = (int)(127.5f + 127.5f * std::sin(i * 0.05f) * std::cos(j * 0.07f)) * HEIGHTMAP_HEIGHT_SCALE - HEIGHTMAP_HEIGHT_SHIFT;
+
+        size_t vertexFloats = TerrainMeshBuilder::VertexCount(heightmap) * 3, indexCount = TerrainMeshBuilder::IndexCount(heightmap);
+        std::unique_ptr<float[]> positions(new float[vertexFloats]);
+        std::unique_ptr<float[]> normals(new float[vertexFloats]);
+        std::unique_ptr<unsigned[]> indices(new unsigned[indexCount]);
+        // fewer repeats for the big maps, which take seconds each
+        int repeats = std::max(1, std::min(5, (int)((64u << 20) / ((size_t)size * size))));
+        std::vector<double> referenceMs, singleMs, parallelMs, normalsMs;
+
+        for (int r = 0; r < repeats; r++)
+        {
+            std::vector<float> vertices;
+            std::vector<unsigned> referenceIndices;
+            Clock::time_point start = Clock::now();
+            buildTerrainMeshReference(heightmap, vertices, referenceIndices);
+            referenceMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+            TerrainMeshBuilder builder;
+            builder.Threads = 1;
+            start = Clock::now();
+            builder.Build(heightmap, positions.get(), NULL, indices.get());
+            singleMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+            builder.Threads = 0;
+            start = Clock::now();
+            builder.Build(heightmap, positions.get(), NULL, indices.get());
+            parallelMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+            start = Clock::now();
+            builder.Build(heightmap, positions.get(), normals.get(), indices.get());
+            normalsMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+            if (r == 0 && (std::memcmp(&vertices[0], positions.get(), vertexFloats * sizeof(float)) != 0
+                || std::memcmp(&referenceIndices[0], indices.get(), indexCount * sizeof(unsigned)) != 0))
+            {
+                std::cout << "ERROR::TERRAIN_BUILDER::MISMATCH: builder output differs from the reference at " << size << " x " << size << std::endl;
+                matches = false;
+            }
+        }
+
+        report << (size > 256 ? "," : "") << "\n    { \"size\": " << size
+            << ", \"reference_ms\": " << summariseTimes(referenceMs)
+            << ",\n      \"builder_1_thread_ms\": " << summariseTimes(singleMs)
+            << ",\n      \"builder_ms\": " << summariseTimes(parallelMs)
+            << ",\n      \"builder_with_normals_ms\": " << summariseTimes(normalsMs) << " }";
+        std::cout << "Built " << size << " x " << size << " terrain meshes" << std::endl;
+    }
+    report << "\n  ]\n}";
+
+    if (outputPath.empty())
+    {
+        std::cout << report.str() << std::endl;
+    }
+    else
+    {
+        std::ofstream file(outputPath.c_str());
+        if (!file)
+        {
+            std::cout << "ERROR::BENCHMARK::REPORT_NOT_WRITTEN: " << outputPath << std::endl;
+            return false;
+        }
+        file << report.str() << std::endl;
+    }
+    return matches;
+}
+#endif
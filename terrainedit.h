@@ -0,0 +1,110 @@
+#ifndef TERRAIN_EDIT_H
+#define TERRAIN_EDIT_H
+
+#include <glm/glm.hpp>
+
+#include "heightmap.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// What a brush does to the heights under it
+enum Brush_Mode {
+    BRUSH_RAISE,        // lifts them by Strength a second at the centre
+    BRUSH_LOWER,        // drops them the same way
+    BRUSH_SMOOTH,       // moves them towards the average of their neighbours
+    BRUSH_FLATTEN,      // moves them towards Height
+    BRUSH_MODE_COUNT
+};
+
+// A round brush reaching Radius world units from its centre, whose effect falls off smoothly to nothing at its edge.
+// Strength is height a second for raise and lower, and for smooth and flatten how much of the way to their target
+// heights the samples at the centre go in a second
+struct TerrainBrush
+{
+    Brush_Mode Mode;
+    float Radius;
+    float Strength;
+    float Height;
+};
+
+// Applies brushes to a heightmap's heights. Each Apply touches only the samples under the brush and returns the
+// rect of them, which the terrain renderers (TerrainRenderer::UpdateRegion), the horizon culler and the ground
+// queries use to update just that part of what they keep. The cost of an edit depends on the brush's size, not
+// the map's.
+class TerrainEditor
+{
+public:
+    // one step of a brush held over world (x, z) for the given seconds. Returns the samples changed, empty if none
+    HeightmapRect Apply(Heightmap& heightmap, const TerrainBrush& brush, float x, float z, float seconds)
+    {
+        PROFILE_SCOPE("TerrainEditor::Apply");
+        if (heightmap.Heights.empty() || brush.Radius <= 0.0f || seconds <= 0.0f)
+            return HeightmapRect();
+        float centreRow = heightmap.XToRow(x), centreColumn = heightmap.ZToColumn(z);
+        float radius = brush.Radius / HEIGHTMAP_SPACING;
+        HeightmapRect rect((int)std::ceil(centreRow - radius), (int)std::ceil(centreColumn - radius),
+            (int)std::floor(centreRow + radius), (int)std::floor(centreColumn + radius));
+        rect.FirstRow = std::max(rect.FirstRow, 0);
+        rect.FirstColumn = std::max(rect.FirstColumn, 0);
+        rect.LastRow = std::min(rect.LastRow, heightmap.Rows - 1);
+        rect.LastColumn = std::min(rect.LastColumn, heightmap.Columns - 1);
+        if (rect.Empty())
+            return rect;
+
+        // smoothing reads the neighbours as they were before this step, so the rect and a border of one are kept
+        int width = rect.LastColumn - rect.FirstColumn + 3;
+        if (brush.Mode == BRUSH_SMOOTH)
+        {
+            before.resize((size_t)(rect.LastRow - rect.FirstRow + 3) * width);
+            for (int row = rect.FirstRow - 1; row <= rect.LastRow + 1; row++)
+                for (int column = rect.FirstColumn - 1; column <= rect.LastColumn + 1; column++)
+                    before[(size_t)(row - rect.FirstRow + 1) * width + column - rect.FirstColumn + 1] = heightmap.At(row, column);
+        }
+
+        for (int row = rect.FirstRow; row <= rect.LastRow; row++)
+        {
+            for (int column = rect.FirstColumn; column <= rect.LastColumn; column++)
+            {
+                float dr = (row - centreRow) / radius, dc = (column - centreColumn) / radius;
+                float distance = dr * dr + dc * dc;
+                if (distance >= 1.0f)
+                    continue;
+                // (1 - d^2)^2, flat in the middle and with no crease at the edge
+                float weight = (1.0f - distance) * (1.0f - distance) * brush.Strength * seconds;
+                float& height = heightmap.Heights[(size_t)row * heightmap.Columns + column];
+                switch (brush.Mode)
+                {
+                case BRUSH_RAISE:
+                    height += weight;
+                    break;
+                case BRUSH_LOWER:
+                    height -= weight;
+                    break;
+                case BRUSH_SMOOTH:
+                {
+                    const float* above = &before[(size_t)(row - rect.FirstRow) * width + column - rect.FirstColumn];
+                    const float* middle = above + width;
+                    const float* below = middle + width;
+                    float average = (above[0] + above[1] + above[2] + middle[0] + middle[2] + below[0] + below[1] + below[2]) / 8.0f;
+                    height += (average - height) * std::min(weight, 1.0f);
+                    break;
+                }
+                case BRUSH_FLATTEN:
+                    height += (brush.Height - height) * std::min(weight, 1.0f);
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+        return rect;
+    }
+
+private:
+    // the heights around a smoothed rect before the step, kept between edits
+    std::vector<float> before;
+};
+#endif
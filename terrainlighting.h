@@ -0,0 +1,310 @@
+#ifndef TERRAIN_LIGHTING_H
+#define TERRAIN_LIGHTING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "heightmap.h"
+#include "uniformblocks.h"
+#include "profiler.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// the terrain shaders read the baked normals and occlusion from here, below the snow trails' unit
+#define TERRAIN_NORMAL_TEXTURE_UNIT 11
+#define TERRAIN_OCCLUSION_TEXTURE_UNIT 12
+// directions around each sample the horizon is searched in, and the distances along each, in samples
+const int TERRAIN_AO_DIRECTIONS = 8;
+const int TERRAIN_AO_STEPS = 10;
+const int TERRAIN_AO_DISTANCES[TERRAIN_AO_STEPS] = { 1, 2, 3, 4, 6, 8, 12, 16, 24, 32 };
+// the furthest the search reaches along a row or column, so the samples an edit can change the occlusion of
+const int TERRAIN_AO_REACH = 32;
+// fewest rows worth starting another thread for
+const int TERRAIN_BAKE_ROWS_PER_THREAD = 16;
+// towards the sun the terrain is lit from
+const glm::vec3 TERRAIN_SUN_DIRECTION(0.4f, 0.8f, 0.3f);
+
+// Normals and ambient occlusion baked from the heightmap once, so the terrain shaders light it with two texture
+// fetches and a dot product and no renderer's vertices need normals. For each sample:
+// - the normal, from the height differences to its neighbours, stored octahedrally in two bytes (GL_RG8).
+//   A heightfield's normals always point up, so only the upper half of the octahedron is used and the fold that
+//   the lower half needs never happens.
+// - the ambient occlusion, one byte (GL_R8): the horizon is found in TERRAIN_AO_DIRECTIONS directions as the steepest
+//   rise to the samples at TERRAIN_AO_DISTANCES along each, and the sky the horizons leave open is kept, 1 for none
+//   hidden.
+// Rows are split between threads, each with its own rows of the results, so the bake scales with cores. Along a
+// row four samples are done at once with SSE2 wherever their search stays inside the map. Edits rebake just the
+// samples within TERRAIN_AO_REACH of the rect and upload those.
+class TerrainLighting
+{
+public:
+    // whether the terrain is lit. Off, nothing is baked and the shaders shade by height alone
+    bool Enabled;
+    // threads the bake runs on, 0 for one per hardware thread
+    unsigned int Threads;
+    int Rows, Columns;
+    // two bytes of octahedral normal and one of occlusion for each sample, row by row
+    std::vector<unsigned char> Normals;
+    std::vector<unsigned char> Occlusion;
+    // how long the last whole bake took
+    double BakeMilliseconds;
+
+    TerrainLighting() : Enabled(true), Threads(0), Rows(0), Columns(0), BakeMilliseconds(0.0), normalTexture(0), occlusionTexture(0),
+        textureRows(0), textureColumns(0)
+    {
+        const int offsets[TERRAIN_AO_DIRECTIONS][2] = { { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 } };
+        for (int direction = 0; direction < TERRAIN_AO_DIRECTIONS; direction++)
+        {
+            directions[direction] = glm::ivec2(offsets[direction][0], offsets[direction][1]);
+            float length = std::sqrt((float)(offsets[direction][0] * offsets[direction][0] + offsets[direction][1] * offsets[direction][1]));
+            for (int step = 0; step < TERRAIN_AO_STEPS; step++)
+                inverseDistances[direction][step] = 1.0f / (TERRAIN_AO_DISTANCES[step] * length * HEIGHTMAP_SPACING);
+        }
+    }
+
+    void Init()
+    {
+        glGenTextures(1, &normalTexture);
+        glGenTextures(1, &occlusionTexture);
+        block.Init(TERRAIN_LIGHTING_BLOCK_BINDING);
+    }
+
+    // bakes a whole heightmap and uploads it. An empty heightmap (as with the paged terrain) is flat and open
+    void Update(const Heightmap& heightmap)
+    {
+        PROFILE_SCOPE("TerrainLighting::Update");
+        if (!Enabled || heightmap.Heights.empty())
+        {
+            Rows = Columns = 1;
+            Normals.assign(2, 128);
+            Occlusion.assign(1, 255);
+        }
+        else
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            Bake(heightmap, HeightmapRect(0, 0, heightmap.Rows - 1, heightmap.Columns - 1));
+            BakeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "Baked terrain lighting for a " << Rows << " x " << Columns << " heightmap in " << BakeMilliseconds << " ms" << std::endl;
+        }
+        upload(HeightmapRect(0, 0, Rows - 1, Columns - 1));
+    }
+
+    // rebakes and uploads what an edited rect of a heightmap of the same size can have changed
+    void UpdateRegion(const Heightmap& heightmap, const HeightmapRect& rect)
+    {
+        if (!Enabled)
+            return;
+        if (heightmap.Rows != Rows || heightmap.Columns != Columns)
+        {
+            Update(heightmap);
+            return;
+        }
+        HeightmapRect reach(std::max(rect.FirstRow - TERRAIN_AO_REACH, 0), std::max(rect.FirstColumn - TERRAIN_AO_REACH, 0),
+            std::min(rect.LastRow + TERRAIN_AO_REACH, Rows - 1), std::min(rect.LastColumn + TERRAIN_AO_REACH, Columns - 1));
+        Bake(heightmap, reach);
+        upload(reach);
+    }
+
+    // The normals and occlusion of the samples in rect, on the CPU only, with no GL calls. Resizes the results
+    // first if the heightmap isn't the size they were baked for
+    void Bake(const Heightmap& heightmap, const HeightmapRect& rect)
+    {
+        PROFILE_SCOPE("TerrainLighting::Bake");
+        if (heightmap.Rows != Rows || heightmap.Columns != Columns)
+        {
+            Rows = heightmap.Rows;
+            Columns = heightmap.Columns;
+            Normals.assign((size_t)Rows * Columns * 2, 128);
+            Occlusion.assign((size_t)Rows * Columns, 255);
+        }
+        if (rect.Empty())
+            return;
+        inShares((size_t)(rect.LastRow - rect.FirstRow + 1), Threads, TERRAIN_BAKE_ROWS_PER_THREAD, [&](size_t first, size_t end)
+        {
+            bakeRows(heightmap, rect, rect.FirstRow + (int)first, rect.FirstRow + (int)end);
+        });
+    }
+
+    void Destroy()
+    {
+        glDeleteTextures(1, &normalTexture);
+        glDeleteTextures(1, &occlusionTexture);
+        block.Destroy();
+    }
+
+private:
+    unsigned int normalTexture, occlusionTexture;
+    int textureRows, textureColumns;
+    UniformBlock<TerrainLightingBlock> block;
+    // (row, column) step of each search direction, and 1 / the world distance of each of its steps
+    glm::ivec2 directions[TERRAIN_AO_DIRECTIONS];
+    float inverseDistances[TERRAIN_AO_DIRECTIONS][TERRAIN_AO_STEPS];
+
+    float at(const Heightmap& heightmap, int row, int column) const
+    {
+        return heightmap.Heights[(size_t)row * Columns + column];
+    }
+
+    // rows [firstRow, lastRow) of rect
+    void bakeRows(const Heightmap& heightmap, HeightmapRect rect, int firstRow, int lastRow)
+    {
+        for (int row = firstRow; row < lastRow; row++)
+        {
+            int column = rect.FirstColumn;
+            while (column <= rect.LastColumn)
+            {
+#if SSE2_ENABLED
+                // four at once where every column they read is inside the map
+                if (column + 3 <= rect.LastColumn && column >= TERRAIN_AO_REACH && column + 3 + TERRAIN_AO_REACH < Columns)
+                {
+                    bakeFour(heightmap, row, column);
+                    column += 4;
+                    continue;
+                }
+#endif
+                bakeOne(heightmap, row, column);
+                column++;
+            }
+        }
+    }
+
+    // an up-facing unit normal to two bytes
+    static void encodeNormal(float x, float y, float z, unsigned char* texel)
+    {
+        float sum = std::abs(x) + y + std::abs(z);
+        texel[0] = (unsigned char)std::lround((x / sum * 0.5f + 0.5f) * 255.0f);
+        texel[1] = (unsigned char)std::lround((z / sum * 0.5f + 0.5f) * 255.0f);
+    }
+
+    void bakeOne(const Heightmap& heightmap, int row, int column)
+    {
+        size_t sample = (size_t)row * Columns + column;
+        // central differences, one-sided at the edges
+        int up = std::max(row - 1, 0), down = std::min(row + 1, Rows - 1);
+        int left = std::max(column - 1, 0), right = std::min(column + 1, Columns - 1);
+        float slopeX = (at(heightmap, down, column) - at(heightmap, up, column)) / (std::max(down - up, 1) * HEIGHTMAP_SPACING);
+        float slopeZ = (at(heightmap, row, right) - at(heightmap, row, left)) / (std::max(right - left, 1) * HEIGHTMAP_SPACING);
+        float inverseLength = 1.0f / std::sqrt(slopeX * slopeX + 1.0f + slopeZ * slopeZ);
+        encodeNormal(-slopeX * inverseLength, inverseLength, -slopeZ * inverseLength, &Normals[sample * 2]);
+
+        float height = at(heightmap, row, column);
+        float hidden = 0.0f;
+        for (int direction = 0; direction < TERRAIN_AO_DIRECTIONS; direction++)
+        {
+            // the ground itself is the lowest horizon
+            float steepest = 0.0f;
+            for (int step = 0; step < TERRAIN_AO_STEPS; step++)
+            {
+                int r = row + directions[direction].x * TERRAIN_AO_DISTANCES[step];
+                int c = column + directions[direction].y * TERRAIN_AO_DISTANCES[step];
+                if (r < 0 || r >= Rows || c < 0 || c >= Columns)
+                    break;
+                steepest = std::max(steepest, (at(heightmap, r, c) - height) * inverseDistances[direction][step]);
+            }
+            // the sine of the horizon's elevation
+            hidden += steepest / std::sqrt(1.0f + steepest * steepest);
+        }
+        Occlusion[sample] = (unsigned char)std::lround((1.0f - hidden / TERRAIN_AO_DIRECTIONS) * 255.0f);
+    }
+
+#if SSE2_ENABLED
+    // bakeOne for (row, column) to (row, column + 3), whose searches stay inside the map along the row
+    void bakeFour(const Heightmap& heightmap, int row, int column)
+    {
+        const float* heights = &heightmap.Heights[0];
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+        const __m128 signBits = _mm_set1_ps(-0.0f);
+        int up = std::max(row - 1, 0), down = std::min(row + 1, Rows - 1);
+        const float* centre = heights + (size_t)row * Columns + column;
+        __m128 slopeX = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(heights + (size_t)down * Columns + column), _mm_loadu_ps(heights + (size_t)up * Columns + column)),
+            _mm_set1_ps(1.0f / (std::max(down - up, 1) * HEIGHTMAP_SPACING)));
+        __m128 slopeZ = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(centre + 1), _mm_loadu_ps(centre - 1)), _mm_set1_ps(1.0f / (2.0f * HEIGHTMAP_SPACING)));
+        // with the normal (-slopeX, 1, -slopeZ) / length, the octahedral sum's 1 / length cancels
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signBits, slopeX), one), _mm_andnot_ps(signBits, slopeZ));
+        __m128 half = _mm_set1_ps(0.5f), scale = _mm_set1_ps(255.0f);
+        __m128i x = _mm_cvtps_epi32(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_div_ps(_mm_xor_ps(slopeX, signBits), sum), half), half), scale));
+        __m128i z = _mm_cvtps_epi32(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_div_ps(_mm_xor_ps(slopeZ, signBits), sum), half), half), scale));
+
+        __m128 height = _mm_loadu_ps(centre);
+        __m128 hidden = zero;
+        for (int direction = 0; direction < TERRAIN_AO_DIRECTIONS; direction++)
+        {
+            __m128 steepest = zero;
+            for (int step = 0; step < TERRAIN_AO_STEPS; step++)
+            {
+                int r = row + directions[direction].x * TERRAIN_AO_DISTANCES[step];
+                if (r < 0 || r >= Rows)
+                    break;
+                const float* other = heights + (size_t)r * Columns + column + directions[direction].y * TERRAIN_AO_DISTANCES[step];
+                __m128 slope = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(other), height), _mm_set1_ps(inverseDistances[direction][step]));
+                steepest = _mm_max_ps(steepest, slope);
+            }
+            hidden = _mm_add_ps(hidden, _mm_div_ps(steepest, _mm_sqrt_ps(_mm_add_ps(one, _mm_mul_ps(steepest, steepest)))));
+        }
+        __m128 open = _mm_sub_ps(one, _mm_mul_ps(hidden, _mm_set1_ps(1.0f / TERRAIN_AO_DIRECTIONS)));
+        __m128i occlusion = _mm_cvtps_epi32(_mm_mul_ps(open, scale));
+
+        alignas(16) int xs[4], zs[4], occlusions[4];
+        _mm_store_si128((__m128i*)xs, x);
+        _mm_store_si128((__m128i*)zs, z);
+        _mm_store_si128((__m128i*)occlusions, occlusion);
+        size_t sample = (size_t)row * Columns + column;
+        for (int i = 0; i < 4; i++)
+        {
+            Normals[(sample + i) * 2] = (unsigned char)xs[i];
+            Normals[(sample + i) * 2 + 1] = (unsigned char)zs[i];
+            Occlusion[sample + i] = (unsigned char)occlusions[i];
+        }
+    }
+#endif
+
+    // sends the texels in rect, making the textures first if the map's size changed, and the block
+    void upload(const HeightmapRect& rect)
+    {
+        PROFILE_SCOPE("TerrainLighting::Upload");
+        if (Rows != textureRows || Columns != textureColumns)
+        {
+            textureRows = Rows;
+            textureColumns = Columns;
+            const GLenum formats[2] = { GL_RG8, GL_R8 }, layouts[2] = { GL_RG, GL_RED };
+            const unsigned int textures[2] = { normalTexture, occlusionTexture };
+            const int units[2] = { TERRAIN_NORMAL_TEXTURE_UNIT, TERRAIN_OCCLUSION_TEXTURE_UNIT };
+            for (int i = 0; i < 2; i++)
+            {
+                glActiveTexture(GL_TEXTURE0 + units[i]);
+                glBindTexture(GL_TEXTURE_2D, textures[i]);
+                glTexImage2D(GL_TEXTURE_2D, 0, formats[i], Columns, Rows, 0, layouts[i], GL_UNSIGNED_BYTE, NULL);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            }
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        // the rect's rows are read straight out of the whole map's
+        int width = rect.LastColumn - rect.FirstColumn + 1, height = rect.LastRow - rect.FirstRow + 1;
+        size_t first = (size_t)rect.FirstRow * Columns + rect.FirstColumn;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, Columns);
+        glBindTexture(GL_TEXTURE_2D, normalTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.FirstColumn, rect.FirstRow, width, height, GL_RG, GL_UNSIGNED_BYTE, &Normals[first * 2]);
+        glBindTexture(GL_TEXTURE_2D, occlusionTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.FirstColumn, rect.FirstRow, width, height, GL_RED, GL_UNSIGNED_BYTE, &Occlusion[first]);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        // world (z, x) to texture coordinates, through the texel centres
+        block.Data.mapTransform = glm::vec4(1.0f / (HEIGHTMAP_SPACING * Columns), 1.0f / (HEIGHTMAP_SPACING * Rows),
+            (Columns / 2.0f + 0.5f) / Columns, (Rows / 2.0f + 0.5f) / Rows);
+        block.Data.sunDirection = glm::vec4(glm::normalize(TERRAIN_SUN_DIRECTION), Enabled ? 1.0f : 0.0f);
+        block.Upload();
+    }
+};
+#endif
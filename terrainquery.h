@@ -0,0 +1,633 @@
+#ifndef TERRAIN_QUERY_H
+#define TERRAIN_QUERY_H
+
+#include <glm/glm.hpp>
+
+#include "heightmap.h"
+#include "profiler.h"
+#include "parallel.h"
+#include "tiledheightmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+// fewest rays or sight lines worth starting another thread for in a batch
+const size_t TERRAIN_RAYS_PER_THREAD = 64;
+// the copy of the heights and the pyramid are kept in square blocks of 2^TERRAIN_QUERY_BLOCK_SHIFT values a side
+const int TERRAIN_QUERY_BLOCK_SHIFT = 7;
+
+// a ray from Origin along Direction (which needn't be unit length) for up to MaxDistance world units
+struct TerrainRay
+{
+    glm::vec3 Origin;
+    glm::vec3 Direction;
+    float MaxDistance;
+};
+
+// where a ray first met the terrain: how far along it, the point, and the unit normal of the triangle it hit
+struct TerrainHit
+{
+    bool Hit;
+    float Distance;
+    glm::vec3 Position;
+    glm::vec3 Normal;
+};
+
+// Height and normal of the terrain under world (x, z) points, for putting things on the ground. Heights are
+// bilinear between samples and clamped at the edge of the map, matching Heightmap::HeightAt, and use the same
+// transform as every terrain mode: HEIGHTMAP_SPACING between samples, the map centred on the origin, and heights
+// already scaled and shifted by HEIGHTMAP_HEIGHT_SCALE and HEIGHTMAP_HEIGHT_SHIFT when the heightmap was loaded.
+// Normals are the bilinear surface's, so they change direction at sample boundaries like the drawn triangles do.
+//
+// Query answers whole arrays of points, four at a time with SSE2, so thousands of snowmen cost microseconds a
+// frame. The heights are a copy that is never changed in place, so any number of threads can query while another
+// updates: each query finishes on the heights it started with. The copy is kept in blocks that snapshots share, so
+// UpdateRegion only copies the blocks an edit touches and can keep up with a brush every frame.
+//
+// Rays are cast against the triangles the strip terrain draws, two to a cell. Update also builds a pyramid of the
+// lowest and highest height under each cell, each 2x2 block of cells, and so on up to one node over the whole map.
+// A ray walks down it front to back, skipping every node it passes over, so it only tests the few cells next to
+// where it meets the ground instead of marching across the map, and a sight line stops at the first node it passes
+// wholly under. Batches are split between threads.
+//
+// The paged terrain has no heightmap to copy, so UpdateTiles points the queries at its tile source instead: heights
+// and normals are read from the full-resolution level one point at a time, without a copy. Rays walk the source's
+// tile bounds as the upper levels of the pyramid. Below a level-0 tile there are no bounds, so a ray tests each of
+// its cells it crosses there, reading their corners with SampleHeight.
+class TerrainQuery
+{
+public:
+    // takes a copy of the heightmap's heights. An empty heightmap (as with the paged terrain) reads as flat at 0
+    void Update(const Heightmap& heightmap)
+    {
+        PROFILE_SCOPE("TerrainQuery::Update");
+        std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>();
+        next->rows = heightmap.Rows;
+        next->columns = heightmap.Columns;
+        next->heights.resize(heightmap.Rows, heightmap.Columns);
+        copyHeights(*next, heightmap, HeightmapRect(0, 0, heightmap.Rows - 1, heightmap.Columns - 1));
+        buildBounds(*next);
+        std::atomic_store(&snapshot, std::shared_ptr<const Snapshot>(next));
+    }
+
+    // answers queries from a tile source's full-resolution level, which must stay open while they run. NULL reads
+    // as flat at 0
+    void UpdateTiles(const TileSource* source)
+    {
+        std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>();
+        if (source)
+        {
+            next->rows = (int)source->Header.rows;
+            next->columns = (int)source->Header.columns;
+            next->spacing = source->Header.spacing;
+            next->source = source;
+            // up to the first level with one node over the whole map
+            for (int level = 0; next->rows >= 2 && next->columns >= 2; level++)
+            {
+                next->levels = level + 1;
+                if (next->nodes(level) == glm::ivec2(1, 1))
+                    break;
+            }
+        }
+        std::atomic_store(&snapshot, std::shared_ptr<const Snapshot>(next));
+    }
+
+    // Replaces the heights in an edited rect of a heightmap of the same size, and the pyramid over them. The new
+    // snapshot shares every block but the ones the rect and the nodes above it touch with the old one, which queries
+    // running meanwhile keep
+    void UpdateRegion(const Heightmap& heightmap, const HeightmapRect& rect)
+    {
+        PROFILE_SCOPE("TerrainQuery::UpdateRegion");
+        std::shared_ptr<const Snapshot> current = std::atomic_load(&snapshot);
+        if (!current || current->source || current->rows != heightmap.Rows || current->columns != heightmap.Columns || current->bounds.empty())
+        {
+            Update(heightmap);
+            return;
+        }
+        // copies the block pointers, not the blocks
+        std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>(*current);
+        next->heights.own(rect.FirstRow, rect.FirstColumn, rect.LastRow, rect.LastColumn);
+        copyHeights(*next, heightmap, rect);
+        // the cells touching the rect, then every node above them
+        glm::ivec2 first(std::max(rect.FirstRow - 1, 0), std::max(rect.FirstColumn - 1, 0)), last(rect.LastRow, rect.LastColumn);
+        for (size_t level = 0; level < next->bounds.size(); level++, first /= 2, last /= 2)
+        {
+            Grid<glm::vec2>& bounds = next->bounds[level];
+            glm::ivec2 end = glm::min(last, glm::ivec2(bounds.rows - 1, bounds.columns - 1));
+            bounds.own(first.x, first.y, end.x, end.y);
+            for (int row = first.x; row <= end.x; row++)
+                for (int column = first.y; column <= end.y; column++)
+                    bounds.at(row, column) = level == 0 ? cellBounds(*next, row, column) : childBounds(*next, (int)level, row, column);
+        }
+        std::atomic_store(&snapshot, std::shared_ptr<const Snapshot>(next));
+    }
+
+    float HeightAt(float x, float z) const
+    {
+        float height;
+        Query(&x, &z, 1, &height, NULL);
+        return height;
+    }
+
+    glm::vec3 NormalAt(float x, float z) const
+    {
+        float height;
+        glm::vec3 normal;
+        Query(&x, &z, 1, &height, &normal);
+        return normal;
+    }
+
+    // heights (and, if normals isn't NULL, unit normals) of count points given as separate x and z arrays
+    void Query(const float* x, const float* z, size_t count, float* heights, glm::vec3* normals) const
+    {
+        std::shared_ptr<const Snapshot> current = std::atomic_load(&snapshot);
+        if (!current || (current->heights.blocks.empty() && !current->source))
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                heights[i] = 0.0f;
+                if (normals)
+                    normals[i] = glm::vec3(0.0f, 1.0f, 0.0f);
+            }
+            return;
+        }
+
+        if (current->source)
+        {
+            const TileSource& source = *current->source;
+            for (size_t i = 0; i < count; i++)
+                bilinear(*current, [&](int row, int column) { return source.SampleHeight(row, column); }, x[i], z[i], heights[i], normals ? &normals[i] : NULL);
+            return;
+        }
+
+        size_t i = 0;
+#if SSE2_ENABLED
+        for (; i + 4 <= count; i += 4)
+            queryFour(*current, x + i, z + i, heights + i, normals ? normals + i : NULL);
+#endif
+        for (; i < count; i++)
+            queryOne(*current, x[i], z[i], heights[i], normals ? &normals[i] : NULL);
+    }
+
+    // the first place the ray meets the terrain, if it does within its length
+    bool Raycast(const TerrainRay& ray, TerrainHit& hit) const
+    {
+        std::shared_ptr<const Snapshot> current = std::atomic_load(&snapshot);
+        hit.Hit = false;
+        return current && cast(*current, ray, false, hit);
+    }
+
+    // count rays at once, split between threads (0 for one per hardware thread)
+    void Raycast(const TerrainRay* rays, size_t count, TerrainHit* hits, unsigned int threads = 0) const
+    {
+        PROFILE_SCOPE("TerrainQuery::Raycast");
+        std::shared_ptr<const Snapshot> current = std::atomic_load(&snapshot);
+        inShares(count, threads, TERRAIN_RAYS_PER_THREAD, [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; i++)
+            {
+                hits[i].Hit = false;
+                if (current)
+                    cast(*current, rays[i], false, hits[i]);
+            }
+        });
+    }
+
+    // whether the terrain doesn't get in the way between two points
+    bool LineOfSight(const glm::vec3& from, const glm::vec3& to) const
+    {
+        std::shared_ptr<const Snapshot> current = std::atomic_load(&snapshot);
+        return !current || lineOfSight(*current, from, to);
+    }
+
+    // count sight lines at once, split between threads (0 for one per hardware thread)
+    void LineOfSight(const glm::vec3* from, const glm::vec3* to, size_t count, bool* visible, unsigned int threads = 0) const
+    {
+        PROFILE_SCOPE("TerrainQuery::LineOfSight");
+        std::shared_ptr<const Snapshot> current = std::atomic_load(&snapshot);
+        inShares(count, threads, TERRAIN_RAYS_PER_THREAD, [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; i++)
+                visible[i] = !current || lineOfSight(*current, from[i], to[i]);
+        });
+    }
+
+private:
+    // A grid of values in square blocks held by shared pointers, so a copy of the grid shares them all until own
+    // gives it its own copies of the blocks it is about to change. Blocks past the last row or column are padded.
+    // Reads go through a plain array of the blocks' first values, a lookup fewer than through the shared pointers
+    template <typename T>
+    struct Grid
+    {
+        static const int SIZE = 1 << TERRAIN_QUERY_BLOCK_SHIFT;
+        static const int MASK = SIZE - 1;
+
+        Grid() : rows(0), columns(0), blockColumns(0) {}
+
+        int rows, columns, blockColumns;
+        std::vector<std::shared_ptr<std::vector<T>>> blocks;
+        std::vector<T*> data;
+
+        void resize(int newRows, int newColumns)
+        {
+            rows = std::max(newRows, 0);
+            columns = std::max(newColumns, 0);
+            blockColumns = (columns + MASK) >> TERRAIN_QUERY_BLOCK_SHIFT;
+            blocks.resize((size_t)((rows + MASK) >> TERRAIN_QUERY_BLOCK_SHIFT) * blockColumns);
+            data.resize(blocks.size());
+            for (size_t i = 0; i < blocks.size(); i++)
+            {
+                blocks[i] = std::make_shared<std::vector<T>>((size_t)SIZE * SIZE);
+                data[i] = &(*blocks[i])[0];
+            }
+        }
+
+        // copies the blocks holding the values from (firstRow, firstColumn) to (lastRow, lastColumn)
+        void own(int firstRow, int firstColumn, int lastRow, int lastColumn)
+        {
+            for (int blockRow = firstRow >> TERRAIN_QUERY_BLOCK_SHIFT; blockRow <= lastRow >> TERRAIN_QUERY_BLOCK_SHIFT; blockRow++)
+            {
+                for (int blockColumn = firstColumn >> TERRAIN_QUERY_BLOCK_SHIFT; blockColumn <= lastColumn >> TERRAIN_QUERY_BLOCK_SHIFT; blockColumn++)
+                {
+                    size_t i = (size_t)blockRow * blockColumns + blockColumn;
+                    blocks[i] = std::make_shared<std::vector<T>>(*blocks[i]);
+                    data[i] = &(*blocks[i])[0];
+                }
+            }
+        }
+
+        // writing only to blocks this grid owns
+        T& at(int row, int column)
+        {
+            return data[(size_t)(row >> TERRAIN_QUERY_BLOCK_SHIFT) * blockColumns + (column >> TERRAIN_QUERY_BLOCK_SHIFT)][((row & MASK) << TERRAIN_QUERY_BLOCK_SHIFT) + (column & MASK)];
+        }
+
+        const T& at(int row, int column) const
+        {
+            return data[(size_t)(row >> TERRAIN_QUERY_BLOCK_SHIFT) * blockColumns + (column >> TERRAIN_QUERY_BLOCK_SHIFT)][((row & MASK) << TERRAIN_QUERY_BLOCK_SHIFT) + (column & MASK)];
+        }
+    };
+
+    struct Snapshot
+    {
+        Snapshot() : rows(0), columns(0), spacing(HEIGHTMAP_SPACING), source(NULL), levels(0) {}
+
+        int rows, columns;
+        float spacing;
+        Grid<float> heights;
+        // set instead of the heights and bounds by UpdateTiles
+        const TileSource* source;
+        // lowest and highest height of each node, level 0 a node per cell and each level after one per 2x2 nodes of
+        // the level before
+        std::vector<Grid<glm::vec2>> bounds;
+        // levels of nodes rays walk, the last with one node over the whole map. 0 when rays can't be cast
+        int levels;
+
+        float at(int row, int column) const
+        {
+            return heights.at(row, column);
+        }
+
+        // a sample for the rays, from whichever of the heights or the source there is
+        float sample(int row, int column) const
+        {
+            return source ? source->SampleHeight(row, column) : at(row, column);
+        }
+
+        // nodes along the rows and columns of a level, each node 2^level cells across
+        glm::ivec2 nodes(int level) const
+        {
+            if (!source)
+                return glm::ivec2(bounds[level].rows, bounds[level].columns);
+            return glm::ivec2(std::max((rows - 1 + (1 << level) - 1) >> level, 1), std::max((columns - 1 + (1 << level) - 1) >> level, 1));
+        }
+
+        // Sets range to the lowest and highest height under a node. With a source only the levels as big as its
+        // tiles have bounds, levels past its last are the whole height range, and false leaves the parent's range
+        bool nodeRange(int level, int row, int column, glm::vec2& range) const
+        {
+            if (!source)
+            {
+                range = bounds[level].at(row, column);
+                return true;
+            }
+            int tileLevel = level - TILE_LEVEL;
+            if (tileLevel < 0)
+                return false;
+            if (tileLevel >= source->Levels())
+            {
+                range = glm::vec2(source->Header.heightLow, source->Header.heightHigh);
+                return true;
+            }
+            if (row >= source->TileRows(tileLevel) || column >= source->TileColumns(tileLevel))
+                return false;
+            range = source->TileBounds(tileLevel, row, column);
+            return true;
+        }
+    };
+    // the node level as big as a level-0 tile of a source, TILED_HEIGHTMAP_TILE_SIZE cells across
+    static const int TILE_LEVEL = 6;
+    static_assert(TILED_HEIGHTMAP_TILE_SIZE == 1 << TILE_LEVEL, "TILE_LEVEL must match TILED_HEIGHTMAP_TILE_SIZE");
+    // replaced by Update and UpdateRegion and read through std::atomic_load, never changed in place
+    std::shared_ptr<const Snapshot> snapshot;
+
+    // a ray in grid units: x is the row, y the height and z the column, with distances still in world units
+    struct GridRay
+    {
+        glm::vec3 origin;
+        glm::vec3 direction;
+        // stop at the first node wholly above the ray, rather than finding the exact hit
+        bool anyHit;
+    };
+
+    // copies a rect of the heightmap into blocks the snapshot owns, a block's part of a row at a time
+    static void copyHeights(Snapshot& map, const Heightmap& heightmap, const HeightmapRect& rect)
+    {
+        for (int row = rect.FirstRow; row <= rect.LastRow; row++)
+        {
+            for (int column = rect.FirstColumn; column <= rect.LastColumn; )
+            {
+                int end = std::min((column | Grid<float>::MASK) + 1, rect.LastColumn + 1);
+                const float* from = &heightmap.Heights[(size_t)row * heightmap.Columns];
+                std::copy(from + column, from + end, &map.heights.at(row, column));
+                column = end;
+            }
+        }
+    }
+
+    static void buildBounds(Snapshot& map)
+    {
+        map.bounds.clear();
+        map.levels = 0;
+        if (map.rows < 2 || map.columns < 2)
+            return;
+        glm::ivec2 size(map.rows - 1, map.columns - 1);
+        for (int level = 0; ; level++)
+        {
+            map.bounds.push_back(Grid<glm::vec2>());
+            map.bounds[level].resize(size.x, size.y);
+            map.levels = level + 1;
+            for (int row = 0; row < size.x; row++)
+                for (int column = 0; column < size.y; column++)
+                    map.bounds[level].at(row, column) = level == 0 ? cellBounds(map, row, column) : childBounds(map, level, row, column);
+            if (size.x == 1 && size.y == 1)
+                break;
+            size = glm::ivec2((size.x + 1) / 2, (size.y + 1) / 2);
+        }
+    }
+
+    // lowest and highest of a cell's four corners
+    static glm::vec2 cellBounds(const Snapshot& map, int row, int column)
+    {
+        float a = map.at(row, column), b = map.at(row, column + 1), c = map.at(row + 1, column), d = map.at(row + 1, column + 1);
+        return glm::vec2(std::min(std::min(a, b), std::min(c, d)), std::max(std::max(a, b), std::max(c, d)));
+    }
+
+    // lowest and highest of a node's (up to) four children on the level below
+    static glm::vec2 childBounds(const Snapshot& map, int level, int row, int column)
+    {
+        const Grid<glm::vec2>& below = map.bounds[level - 1];
+        glm::vec2 node(1e30f, -1e30f);
+        for (int childRow = row * 2; childRow < std::min(row * 2 + 2, below.rows); childRow++)
+        {
+            for (int childColumn = column * 2; childColumn < std::min(column * 2 + 2, below.columns); childColumn++)
+            {
+                const glm::vec2& child = below.at(childRow, childColumn);
+                node = glm::vec2(std::min(node.x, child.x), std::max(node.y, child.y));
+            }
+        }
+        return node;
+    }
+
+    static bool cast(const Snapshot& map, const TerrainRay& ray, bool anyHit, TerrainHit& hit)
+    {
+        float length = glm::length(ray.Direction);
+        if (map.levels == 0 || length <= 0.0f)
+            return false;
+        glm::vec3 direction = ray.Direction / length;
+        GridRay gridRay;
+        gridRay.origin = glm::vec3(ray.Origin.x / map.spacing + map.rows / 2.0f, ray.Origin.y, ray.Origin.z / map.spacing + map.columns / 2.0f);
+        gridRay.direction = glm::vec3(direction.x / map.spacing, direction.y, direction.z / map.spacing);
+        gridRay.anyHit = anyHit;
+
+        // the part of the ray inside the box around the whole map
+        glm::vec2 range;
+        map.nodeRange(map.levels - 1, 0, 0, range);
+        glm::vec3 low(0.0f, range.x, 0.0f), high((float)(map.rows - 1), range.y, (float)(map.columns - 1));
+        float t0 = 0.0f, t1 = ray.MaxDistance;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (gridRay.direction[axis] == 0.0f)
+            {
+                if (gridRay.origin[axis] < low[axis] || gridRay.origin[axis] > high[axis])
+                    return false;
+                continue;
+            }
+            float enter = (low[axis] - gridRay.origin[axis]) / gridRay.direction[axis];
+            float exit = (high[axis] - gridRay.origin[axis]) / gridRay.direction[axis];
+            t0 = std::max(t0, std::min(enter, exit));
+            t1 = std::min(t1, std::max(enter, exit));
+        }
+        if (t0 > t1)
+            return false;
+
+        float distance;
+        glm::vec3 normal;
+        if (!castNode(map, gridRay, map.levels - 1, 0, 0, t0, t1, range, distance, normal))
+            return false;
+        hit.Hit = true;
+        hit.Distance = distance;
+        hit.Position = ray.Origin + direction * distance;
+        hit.Normal = normal;
+        return true;
+    }
+
+    static bool lineOfSight(const Snapshot& map, const glm::vec3& from, const glm::vec3& to)
+    {
+        TerrainRay ray;
+        ray.Origin = from;
+        ray.Direction = to - from;
+        ray.MaxDistance = glm::length(to - from);
+        TerrainHit hit;
+        return !cast(map, ray, true, hit);
+    }
+
+    // Looks for the ray's first hit in the node between distances t0 and t1, which the caller has worked out are
+    // the part of the ray over the node. Children are visited in the order the ray crosses them. A node without
+    // bounds of its own uses its parent's range
+    static bool castNode(const Snapshot& map, const GridRay& ray, int level, int nodeRow, int nodeColumn, float t0, float t1, glm::vec2 range, float& distance, glm::vec3& normal)
+    {
+        map.nodeRange(level, nodeRow, nodeColumn, range);
+        float h0 = ray.origin.y + ray.direction.y * t0, h1 = ray.origin.y + ray.direction.y * t1;
+        if (std::min(h0, h1) > range.y)
+            return false;
+        if (ray.anyHit && std::max(h0, h1) < range.x)
+        {
+            distance = t0;
+            normal = glm::vec3(0.0f, 1.0f, 0.0f);
+            return true;
+        }
+        if (level == 0)
+            return castCell(map, ray, nodeRow, nodeColumn, t0, t1, distance, normal);
+
+        // where the ray crosses the row and column lines between the children
+        int half = 1 << (level - 1);
+        float splitRow = (float)((nodeRow * 2 + 1) * half), splitColumn = (float)((nodeColumn * 2 + 1) * half);
+        float times[4] = { t0, t1, t1, t1 };
+        int count = 1;
+        if (ray.direction.x != 0.0f)
+        {
+            float t = (splitRow - ray.origin.x) / ray.direction.x;
+            if (t > t0 && t < t1)
+                times[count++] = t;
+        }
+        if (ray.direction.z != 0.0f)
+        {
+            float t = (splitColumn - ray.origin.z) / ray.direction.z;
+            if (t > t0 && t < t1)
+                times[count++] = t;
+        }
+        std::sort(times + 1, times + count);
+        times[count] = t1;
+
+        glm::ivec2 children = map.nodes(level - 1);
+        for (int i = 0; i < count; i++)
+        {
+            float middle = (times[i] + times[i + 1]) * 0.5f;
+            int childRow = nodeRow * 2 + (ray.origin.x + ray.direction.x * middle >= splitRow ? 1 : 0);
+            int childColumn = nodeColumn * 2 + (ray.origin.z + ray.direction.z * middle >= splitColumn ? 1 : 0);
+            if (childRow >= children.x || childColumn >= children.y)
+                continue;
+            if (castNode(map, ray, level - 1, childRow, childColumn, times[i], times[i + 1], range, distance, normal))
+                return true;
+        }
+        return false;
+    }
+
+    // The ray against a cell's two triangles, split along the diagonal from (row + 1, column) to (row, column + 1)
+    // as the strips are. A little slack at the ends of [t0, t1] keeps rays along cell edges from slipping between
+    static bool castCell(const Snapshot& map, const GridRay& ray, int row, int column, float t0, float t1, float& distance, glm::vec3& normal)
+    {
+        glm::vec3 a((float)row, map.sample(row, column), (float)column);
+        glm::vec3 b((float)(row + 1), map.sample(row + 1, column), (float)column);
+        glm::vec3 c((float)row, map.sample(row, column + 1), (float)(column + 1));
+        glm::vec3 d((float)(row + 1), map.sample(row + 1, column + 1), (float)(column + 1));
+        const float slack = 1e-4f * (t1 - t0) + 1e-6f;
+        float best = t1 + slack;
+        bool found = false;
+        const glm::vec3* triangles[2][3] = { { &a, &b, &c }, { &b, &d, &c } };
+        for (int i = 0; i < 2; i++)
+        {
+            // Moller-Trumbore
+            glm::vec3 edge1 = *triangles[i][1] - *triangles[i][0], edge2 = *triangles[i][2] - *triangles[i][0];
+            glm::vec3 p = glm::cross(ray.direction, edge2);
+            float determinant = glm::dot(edge1, p);
+            if (std::fabs(determinant) < 1e-12f)
+                continue;
+            float inverse = 1.0f / determinant;
+            glm::vec3 s = ray.origin - *triangles[i][0];
+            float u = glm::dot(s, p) * inverse;
+            if (u < 0.0f || u > 1.0f)
+                continue;
+            glm::vec3 q = glm::cross(s, edge1);
+            float v = glm::dot(ray.direction, q) * inverse;
+            if (v < 0.0f || u + v > 1.0f)
+                continue;
+            float t = glm::dot(edge2, q) * inverse;
+            if (t < t0 - slack || t >= best)
+                continue;
+            best = t;
+            found = true;
+            // back to world units for the normal, facing up
+            glm::vec3 worldEdge1(edge1.x * map.spacing, edge1.y, edge1.z * map.spacing);
+            glm::vec3 worldEdge2(edge2.x * map.spacing, edge2.y, edge2.z * map.spacing);
+            normal = glm::normalize(glm::cross(worldEdge1, worldEdge2));
+            if (normal.y < 0.0f)
+                normal = -normal;
+        }
+        if (found)
+            distance = std::max(best, 0.0f);
+        return found;
+    }
+
+    static void queryOne(const Snapshot& map, float x, float z, float& height, glm::vec3* normal)
+    {
+        bilinear(map, [&](int row, int column) { return map.at(row, column); }, x, z, height, normal);
+    }
+
+    // the height (and normal) at one point from the four samples around it, which at(row, column) reads
+    template <typename Sample>
+    static void bilinear(const Snapshot& map, const Sample& at, float x, float z, float& height, glm::vec3* normal)
+    {
+        float row = std::min(std::max(x / map.spacing + map.rows / 2.0f, 0.0f), (float)(map.rows - 1));
+        float column = std::min(std::max(z / map.spacing + map.columns / 2.0f, 0.0f), (float)(map.columns - 1));
+        int r = std::min((int)row, std::max(map.rows - 2, 0));
+        int c = std::min((int)column, std::max(map.columns - 2, 0));
+        int r1 = std::min(r + 1, map.rows - 1), c1 = std::min(c + 1, map.columns - 1);
+        float fr = row - r, fc = column - c;
+        float h00 = at(r, c), h01 = at(r, c1), h10 = at(r1, c), h11 = at(r1, c1);
+        float top = h00 * (1.0f - fc) + h01 * fc;
+        float bottom = h10 * (1.0f - fc) + h11 * fc;
+        height = top * (1.0f - fr) + bottom * fr;
+        if (!normal)
+            return;
+        // slopes of the bilinear patch along x and z, from its slopes along rows and columns
+        float slopeX = (bottom - top) / map.spacing;
+        float slopeZ = ((h01 - h00) * (1.0f - fr) + (h11 - h10) * fr) / map.spacing;
+        float length = std::sqrt(slopeX * slopeX + 1.0f + slopeZ * slopeZ);
+        *normal = glm::vec3(-slopeX / length, 1.0f / length, -slopeZ / length);
+    }
+
+#if SSE2_ENABLED
+    // queryOne for four points. The cell arithmetic and interpolation are vectorised; SSE2 has no gather, so the
+    // four corner heights are loaded one point at a time
+    static void queryFour(const Snapshot& map, const float* x, const float* z, float* heights, glm::vec3* normals)
+    {
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+        const __m128 inverseSpacing = _mm_set1_ps(1.0f / HEIGHTMAP_SPACING);
+        __m128 row = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x), inverseSpacing), _mm_set1_ps(map.rows / 2.0f));
+        __m128 column = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(z), inverseSpacing), _mm_set1_ps(map.columns / 2.0f));
+        row = _mm_min_ps(_mm_max_ps(row, zero), _mm_set1_ps((float)(map.rows - 1)));
+        column = _mm_min_ps(_mm_max_ps(column, zero), _mm_set1_ps((float)(map.columns - 1)));
+        // the cell's first sample, truncated (the positions are never negative) and kept off the last row and column
+        __m128i r = _mm_cvttps_epi32(_mm_min_ps(row, _mm_set1_ps((float)std::max(map.rows - 2, 0))));
+        __m128i c = _mm_cvttps_epi32(_mm_min_ps(column, _mm_set1_ps((float)std::max(map.columns - 2, 0))));
+        __m128 fr = _mm_sub_ps(row, _mm_cvtepi32_ps(r));
+        __m128 fc = _mm_sub_ps(column, _mm_cvtepi32_ps(c));
+
+        alignas(16) int rows[4], columns[4];
+        alignas(16) float h00[4], h01[4], h10[4], h11[4];
+        _mm_store_si128((__m128i*)rows, r);
+        _mm_store_si128((__m128i*)columns, c);
+        for (int k = 0; k < 4; k++)
+        {
+            int r1 = std::min(rows[k] + 1, map.rows - 1), c1 = std::min(columns[k] + 1, map.columns - 1);
+            h00[k] = map.at(rows[k], columns[k]);
+            h01[k] = map.at(rows[k], c1);
+            h10[k] = map.at(r1, columns[k]);
+            h11[k] = map.at(r1, c1);
+        }
+
+        __m128 a = _mm_load_ps(h00), b = _mm_load_ps(h01), d = _mm_load_ps(h10), e = _mm_load_ps(h11);
+        __m128 fc1 = _mm_sub_ps(one, fc), fr1 = _mm_sub_ps(one, fr);
+        __m128 top = _mm_add_ps(_mm_mul_ps(a, fc1), _mm_mul_ps(b, fc));
+        __m128 bottom = _mm_add_ps(_mm_mul_ps(d, fc1), _mm_mul_ps(e, fc));
+        _mm_storeu_ps(heights, _mm_add_ps(_mm_mul_ps(top, fr1), _mm_mul_ps(bottom, fr)));
+        if (!normals)
+            return;
+
+        __m128 slopeX = _mm_mul_ps(_mm_sub_ps(bottom, top), inverseSpacing);
+        __m128 slopeZ = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(b, a), fr1), _mm_mul_ps(_mm_sub_ps(e, d), fr)), inverseSpacing);
+        __m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(slopeX, slopeX), one), _mm_mul_ps(slopeZ, slopeZ))));
+        alignas(16) float nx[4], ny[4], nz[4];
+        _mm_store_ps(nx, _mm_mul_ps(_mm_sub_ps(zero, slopeX), inverseLength));
+        _mm_store_ps(ny, inverseLength);
+        _mm_store_ps(nz, _mm_mul_ps(_mm_sub_ps(zero, slopeZ), inverseLength));
+        for (int k = 0; k < 4; k++)
+            normals[k] = glm::vec3(nx[k], ny[k], nz[k]);
+    }
+#endif
+};
+#endif
@@ -0,0 +1,227 @@
+#ifndef TESSELLATED_TERRAIN_H
+#define TESSELLATED_TERRAIN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "terrain.h"
+#include "frustum.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+// patches are core in GL 4.0, which the GL 3.3 glad loader doesn't define or load
+#ifndef GL_PATCHES
+#define GL_PATCHES 0x000E
+#define GL_PATCH_VERTICES 0x8E72
+#define GL_MAX_TESS_GEN_LEVEL 0x8E7E
+#endif
+typedef void (APIENTRYP PFNGLPATCHPARAMETERIPROC_TERRAIN)(GLenum pname, GLint value);
+
+// samples along each side of a patch. The most a patch edge can be split is 64 times, so at full tessellation a
+// patch has a vertex per sample
+const int TESSELLATION_PATCH_SIZE = 64;
+// frames before the triangle count of a frame is read back, so reading it never waits on the GPU
+const int TESSELLATION_QUERY_LATENCY = 4;
+
+// Terrain drawn with the tessellation stages (GL 4.0), following the learnopengl height map article's GPU variant.
+// The heightmap is covered by a fixed grid of TESSELLATION_PATCH_SIZE sample patches, each just its four corners and
+// its height range, which never change. terrainTessellated.tcs drops patches whose box is outside the view frustum,
+// and splits each edge of the others by how many pixels it covers on screen, so nearby terrain gets up to a
+// vertex per sample and distant terrain a handful of triangles. Neighbouring patches work out a shared edge's level
+// from the same two corners, so they always agree and there are no cracks. terrainTessellated.tes places the new
+// vertices and reads their heights from the heightmap texture. The whole terrain is one draw, and the CPU does the
+// same work every frame however close the camera is.
+class TessellatedTerrain : public TerrainRenderer
+{
+public:
+    // loader is the function glad was loaded with, for the GL 4.0 entry point glad doesn't know. viewportHeight
+    // turns the projection into pixels until SetViewportHeight changes it, and pixelsPerEdge is the screen length to
+    // aim for along each triangle edge (--tess-pixels)
+    TessellatedTerrain(GLADloadproc loader, float viewportHeight, float pixelsPerEdge)
+        : loader(loader), viewportHeight(viewportHeight), pixelsPerEdge(pixelsPerEdge), patchParameteri(NULL), VAO(0), patchVBO(0),
+        heightmapTexture(0), patchCount(0), rows(0), columns(0), queryIndex(0)
+    {
+        for (int i = 0; i < TESSELLATION_QUERY_LATENCY; i++)
+        {
+            queries[i] = 0;
+            queryPending[i] = false;
+        }
+    }
+
+    bool Init(const Heightmap& heightmap) override
+    {
+        patchParameteri = (PFNGLPATCHPARAMETERIPROC_TERRAIN)loader("glPatchParameteri");
+        GLint maxLevel = 0;
+        glGetIntegerv(GL_MAX_TESS_GEN_LEVEL, &maxLevel);
+        if (!patchParameteri || maxLevel < TESSELLATION_PATCH_SIZE)
+        {
+            std::cout << "ERROR::TESSELLATED_TERRAIN::UNSUPPORTED: tessellation needs a GL 4.0 context" << std::endl;
+            return false;
+        }
+        rows = heightmap.Rows;
+        columns = heightmap.Columns;
+
+        std::ostringstream defines;
+        defines << "#define MAX_LEVEL " << TESSELLATION_PATCH_SIZE << ".0\n";
+        shader.reset(new Shader("terrainTessellated.vs", "terrainTessellated.tcs", "terrainTessellated.tes", "heightMapShader.fs", shaderDefines(defines.str())));
+        setUpShader(*shader);
+        shader->setFloat("pixelsPerEdge", pixelsPerEdge);
+        frustumPlanes = shader->uniform<glm::vec4>("frustumPlanes[0]");
+        viewportHeightUniform = shader->uniform<float>("viewportHeight");
+        shader->set(viewportHeightUniform, viewportHeight);
+
+        PROFILE_BEGIN(terrainUploadZone, "Upload terrain buffers");
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glGenBuffers(1, &patchVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, patchVBO);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+        buildPatches(heightmap);
+        heightmapTexture = createHeightTexture(heightmap, *shader);
+        glGenQueries(TESSELLATION_QUERY_LATENCY, queries);
+        GpuBytes = (size_t)patchCount * 4 * sizeof(glm::vec4) + heightmap.Heights.size() * sizeof(unsigned short);
+        PROFILE_END(terrainUploadZone);
+
+        std::cout << "Created " << patchCount << " tessellation patches of " << TESSELLATION_PATCH_SIZE << " x " << TESSELLATION_PATCH_SIZE << " samples" << std::endl;
+        return true;
+    }
+
+    void SetViewportHeight(float height) override
+    {
+        if (height <= 0.0f || height == viewportHeight)
+            return;
+        viewportHeight = height;
+        if (shader)
+        {
+            shader->use();
+            shader->set(viewportHeightUniform, viewportHeight);
+        }
+    }
+
+    void Draw(const glm::vec3& cameraPos, const glm::mat4& viewProjection) override
+    {
+        // the triangles of the frame TESSELLATION_QUERY_LATENCY frames ago, which is long finished
+        if (queryPending[queryIndex])
+        {
+            GLuint primitives = 0;
+            glGetQueryObjectuiv(queries[queryIndex], GL_QUERY_RESULT, &primitives);
+            TrianglesDrawn = primitives;
+        }
+
+        Frustum frustum;
+        frustum.Extract(viewProjection);
+        shader->use();
+        glUniform4fv(frustumPlanes.Location, 6, &frustum.Planes[0].x);
+
+        glBeginQuery(GL_PRIMITIVES_GENERATED, queries[queryIndex]);
+        glBindVertexArray(VAO);
+        patchParameteri(GL_PATCH_VERTICES, 4);
+        glDrawArrays(GL_PATCHES, 0, patchCount * 4);
+        glBindVertexArray(0);
+        glEndQuery(GL_PRIMITIVES_GENERATED);
+        queryPending[queryIndex] = true;
+        queryIndex = (queryIndex + 1) % TESSELLATION_QUERY_LATENCY;
+
+        NodesDrawn = patchCount;
+        DrawCalls = 1;
+    }
+
+    // a heightmap of the same size needs new patch height ranges and a new height texture
+    bool UpdateHeights(const Heightmap& heightmap) override
+    {
+        if (heightmap.Rows != rows || heightmap.Columns != columns)
+            return TerrainRenderer::UpdateHeights(heightmap);
+        buildPatches(heightmap);
+        updateHeightTexture(heightmap, heightmapTexture, *shader);
+        return true;
+    }
+
+    // an edit only needs the height ranges of the patches over it and its texels
+    bool UpdateRegion(const Heightmap& heightmap, const HeightmapRect& rect) override
+    {
+        PROFILE_SCOPE("TessellatedTerrain::UpdateRegion");
+        if (heightmap.Rows != rows || heightmap.Columns != columns)
+            return TerrainRenderer::UpdateHeights(heightmap);
+        // a sample on the edge between two patches is in both
+        int patchColumns = (columns - 2) / TESSELLATION_PATCH_SIZE + 1, patchRows = (rows - 2) / TESSELLATION_PATCH_SIZE + 1;
+        int firstColumn = std::max(rect.FirstColumn - 1, 0) / TESSELLATION_PATCH_SIZE;
+        int lastColumn = std::min(rect.LastColumn / TESSELLATION_PATCH_SIZE, patchColumns - 1);
+        std::vector<glm::vec4> corners;
+        glBindBuffer(GL_ARRAY_BUFFER, patchVBO);
+        for (int patchRow = std::max(rect.FirstRow - 1, 0) / TESSELLATION_PATCH_SIZE; patchRow <= std::min(rect.LastRow / TESSELLATION_PATCH_SIZE, patchRows - 1); patchRow++)
+        {
+            // the row's patches are next to each other in the buffer
+            corners.clear();
+            for (int patchColumn = firstColumn; patchColumn <= lastColumn; patchColumn++)
+                addPatch(heightmap, patchRow * TESSELLATION_PATCH_SIZE, patchColumn * TESSELLATION_PATCH_SIZE, corners);
+            size_t first = ((size_t)patchRow * patchColumns + firstColumn) * 4;
+            glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::vec4), corners.size() * sizeof(glm::vec4), &corners[0]);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        updateHeightTextureRegion(heightmap, rect, heightmapTexture, *shader);
+        return true;
+    }
+
+    void Destroy() override
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &patchVBO);
+        glDeleteTextures(1, &heightmapTexture);
+        glDeleteQueries(TESSELLATION_QUERY_LATENCY, queries);
+        for (int i = 0; i < TESSELLATION_QUERY_LATENCY; i++)
+            queryPending[i] = false;
+    }
+
+private:
+    GLADloadproc loader;
+    float viewportHeight;
+    float pixelsPerEdge;
+    PFNGLPATCHPARAMETERIPROC_TERRAIN patchParameteri;
+
+    unsigned int VAO, patchVBO;
+    unsigned int heightmapTexture;
+    std::unique_ptr<Shader> shader;
+    Uniform<glm::vec4> frustumPlanes;
+    Uniform<float> viewportHeightUniform;
+    int patchCount;
+    int rows, columns;
+
+    GLuint queries[TESSELLATION_QUERY_LATENCY];
+    bool queryPending[TESSELLATION_QUERY_LATENCY];
+    int queryIndex;
+
+    // Four vertices per patch, one for each corner as (row, column, lowest height, highest height), with the corners
+    // at u = 0 and 1 along rows and v = 0 and 1 along columns in the order (0, 0), (1, 0), (0, 1), (1, 1). Patches at
+    // the far edges stop at the last sample
+    void buildPatches(const Heightmap& heightmap)
+    {
+        std::vector<glm::vec4> corners;
+        for (int row = 0; row < rows - 1; row += TESSELLATION_PATCH_SIZE)
+            for (int column = 0; column < columns - 1; column += TESSELLATION_PATCH_SIZE)
+                addPatch(heightmap, row, column, corners);
+        patchCount = (int)corners.size() / 4;
+        if (corners.empty())
+            return;
+        glBindBuffer(GL_ARRAY_BUFFER, patchVBO);
+        glBufferData(GL_ARRAY_BUFFER, corners.size() * sizeof(glm::vec4), &corners[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void addPatch(const Heightmap& heightmap, int row, int column, std::vector<glm::vec4>& corners) const
+    {
+        int endRow = std::min(row + TESSELLATION_PATCH_SIZE, rows - 1), endColumn = std::min(column + TESSELLATION_PATCH_SIZE, columns - 1);
+        float low, high;
+        heightmap.MinMax(row, column, endRow, endColumn, low, high);
+        corners.push_back(glm::vec4((float)row, (float)column, low, high));
+        corners.push_back(glm::vec4((float)endRow, (float)column, low, high));
+        corners.push_back(glm::vec4((float)row, (float)endColumn, low, high));
+        corners.push_back(glm::vec4((float)endRow, (float)endColumn, low, high));
+    }
+};
+#endif
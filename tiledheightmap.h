@@ -0,0 +1,445 @@
+#ifndef TILED_HEIGHTMAP_H
+#define TILED_HEIGHTMAP_H
+
+#include "heightmap.h"
+#include "stb_image.h"
+#include "profiler.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Most mip levels a tile file can have. Level 15 tiles are TILED_HEIGHTMAP_TILE_SIZE * 2^15 = 2 million samples across
+#define TILED_HEIGHTMAP_MAX_LEVELS 16
+
+// quads along each side of a tile. Tiles hold one more sample than that each way, so neighbours share their edges
+const int TILED_HEIGHTMAP_TILE_SIZE = 64;
+const int TILED_HEIGHTMAP_TILE_SAMPLES = (TILED_HEIGHTMAP_TILE_SIZE + 1) * (TILED_HEIGHTMAP_TILE_SIZE + 1);
+const size_t TILED_HEIGHTMAP_TILE_BYTES = TILED_HEIGHTMAP_TILE_SAMPLES * sizeof(unsigned short);
+
+// A read-only file mapped into memory. Pages are read from disk when first touched, and Release lets the OS drop
+// pages that won't be needed again soon, so what stays resident depends on what is read rather than the file's size
+class MappedFile
+{
+public:
+    MappedFile() : data(NULL), size(0)
+    {
+#ifdef _WIN32
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#endif
+    }
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    bool Open(const std::string& path)
+    {
+        Close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+        LARGE_INTEGER fileSize;
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            Close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        data = mapping ? (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+        size = (size_t)fileSize.QuadPart;
+#else
+        int descriptor = open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (descriptor < 0 || fstat(descriptor, &info) != 0 || info.st_size == 0)
+        {
+            if (descriptor >= 0)
+                close(descriptor);
+            return false;
+        }
+        size = (size_t)info.st_size;
+        void* mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, descriptor, 0);
+        // the mapping keeps the file open
+        close(descriptor);
+        data = mapped == MAP_FAILED ? NULL : (const unsigned char*)mapped;
+        if (data)
+            madvise((void*)data, size, MADV_RANDOM);
+#endif
+        if (!data)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data)
+            munmap((void*)data, size);
+#endif
+        data = NULL;
+        size = 0;
+    }
+
+    const unsigned char* Data() const
+    {
+        return data;
+    }
+
+    size_t Size() const
+    {
+        return size;
+    }
+
+    // drops the pages of [offset, offset + length) from this process's memory. They are read again if touched
+    void Release(size_t offset, size_t length) const
+    {
+        if (!data || length == 0)
+            return;
+#ifdef _WIN32
+        // unlocking pages that were never locked takes them out of the working set
+        VirtualUnlock((void*)(data + offset), length);
+#else
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t first = offset / page * page;
+        size_t end = std::min((offset + length + page - 1) / page * page, size);
+        madvise((void*)(data + first), end - first, MADV_DONTNEED);
+#endif
+    }
+
+private:
+    const unsigned char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+// Start of a tile file. Every level of the mip pyramid is cut into tiles of TILED_HEIGHTMAP_TILE_SIZE quads, stored
+// row by row as 16-bit texels, and each level also has a table of its tiles' lowest and highest texels. Level l
+// keeps every 2^l-th sample of level 0, so a tile at level l covers TILED_HEIGHTMAP_TILE_SIZE << l samples of the
+// map. A tile's bounds also take in its children's, so they hold every level-0 sample under it, not just its own. Samples past the edge of the map repeat the edge. Numbers are little-endian.
+struct TiledHeightmapHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t tileSize;
+    // samples at level 0
+    uint32_t rows;
+    uint32_t columns;
+    uint32_t levelCount;
+    float spacing;
+    // heights that texels 0 and 65535 stand for
+    float heightLow;
+    float heightHigh;
+    // tiles along each side of every level
+    uint32_t tileRows[TILED_HEIGHTMAP_MAX_LEVELS];
+    uint32_t tileColumns[TILED_HEIGHTMAP_MAX_LEVELS];
+    // file offsets of each level's first tile and of its table of (lowest, highest) texel pairs
+    uint64_t tileOffsets[TILED_HEIGHTMAP_MAX_LEVELS];
+    uint64_t boundsOffsets[TILED_HEIGHTMAP_MAX_LEVELS];
+};
+
+const char TILED_HEIGHTMAP_MAGIC[8] = { 'H', 'M', 'T', 'I', 'L', 'E', 'S', '\0' };
+const uint32_t TILED_HEIGHTMAP_VERSION = 2;
+
+// Where the paged terrain's tiles come from: a mip pyramid laid out as in a tile file, which Header describes once
+// Open returns. ReadTile and TileBounds can be called from several loader threads at once
+class TileSource
+{
+public:
+    TiledHeightmapHeader Header;
+
+    TileSource()
+    {
+        std::memset(&Header, 0, sizeof(Header));
+    }
+
+    virtual ~TileSource() {}
+
+    virtual bool Open() = 0;
+    virtual void Close() = 0;
+
+    // texels of a tile, TILED_HEIGHTMAP_TILE_SIZE + 1 rows of as many columns
+    virtual void ReadTile(int level, int row, int column, unsigned short* texels) const = 0;
+
+    // lowest and highest height of a tile's samples and of every level-0 sample under it
+    virtual glm::vec2 TileBounds(int level, int row, int column) const = 0;
+
+    // height of a sample of the full-resolution level, for the ground queries. row and column are inside the map
+    virtual float SampleHeight(int row, int column) const = 0;
+
+    // threads worth reading tiles on at once
+    virtual unsigned int LoaderThreads() const
+    {
+        return 1;
+    }
+
+    int Levels() const
+    {
+        return (int)Header.levelCount;
+    }
+
+    int TileRows(int level) const
+    {
+        return (int)Header.tileRows[level];
+    }
+
+    int TileColumns(int level) const
+    {
+        return (int)Header.tileColumns[level];
+    }
+
+    float TexelHeight(unsigned short texel) const
+    {
+        return Header.heightLow + (Header.heightHigh - Header.heightLow) * (texel / 65535.0f);
+    }
+};
+
+// A tile file read through a memory mapping, so opening one costs nothing however big the terrain is, and only
+// the tiles that are read take memory. Tiles can be read from any thread.
+class TiledHeightmap : public TileSource
+{
+public:
+    explicit TiledHeightmap(const std::string& path) : path(path) {}
+
+    bool Open() override
+    {
+        if (!file.Open(path))
+        {
+            std::cout << "ERROR::TILED_HEIGHTMAP::FILE_NOT_MAPPED: " << path << std::endl;
+            return false;
+        }
+        if (file.Size() < sizeof(TiledHeightmapHeader))
+            return fail(path);
+        std::memcpy(&Header, file.Data(), sizeof(Header));
+        if (std::memcmp(Header.magic, TILED_HEIGHTMAP_MAGIC, sizeof(Header.magic)) != 0 || Header.version != TILED_HEIGHTMAP_VERSION
+            || Header.tileSize != (uint32_t)TILED_HEIGHTMAP_TILE_SIZE || Header.levelCount == 0 || Header.levelCount > TILED_HEIGHTMAP_MAX_LEVELS)
+            return fail(path);
+        for (uint32_t level = 0; level < Header.levelCount; level++)
+        {
+            size_t tiles = (size_t)Header.tileRows[level] * Header.tileColumns[level];
+            if (Header.tileOffsets[level] + tiles * TILED_HEIGHTMAP_TILE_BYTES > file.Size()
+                || Header.boundsOffsets[level] + tiles * 2 * sizeof(unsigned short) > file.Size())
+                return fail(path);
+        }
+        std::cout << "Opened tiled heightmap of size " << Header.rows << " x " << Header.columns << " with " << Header.levelCount << " levels" << std::endl;
+        return true;
+    }
+
+    void Close() override
+    {
+        file.Close();
+    }
+
+    // texels of a tile straight from the mapping. Reading them may fault pages in from disk
+    const unsigned short* Tile(int level, int row, int column) const
+    {
+        return (const unsigned short*)(file.Data() + tileOffset(level, row, column));
+    }
+
+    // copies a tile out of the mapping and lets the OS have its pages back
+    void ReadTile(int level, int row, int column, unsigned short* texels) const override
+    {
+        std::memcpy(texels, Tile(level, row, column), TILED_HEIGHTMAP_TILE_BYTES);
+        file.Release(tileOffset(level, row, column), TILED_HEIGHTMAP_TILE_BYTES);
+    }
+
+    // read from the mapping without copying the tile, so only the pages holding the sample are touched
+    float SampleHeight(int row, int column) const override
+    {
+        int tileRow = std::min(row / TILED_HEIGHTMAP_TILE_SIZE, TileRows(0) - 1);
+        int tileColumn = std::min(column / TILED_HEIGHTMAP_TILE_SIZE, TileColumns(0) - 1);
+        const unsigned short* texels = Tile(0, tileRow, tileColumn);
+        return TexelHeight(texels[(row - tileRow * TILED_HEIGHTMAP_TILE_SIZE) * (TILED_HEIGHTMAP_TILE_SIZE + 1) + column - tileColumn * TILED_HEIGHTMAP_TILE_SIZE]);
+    }
+
+    glm::vec2 TileBounds(int level, int row, int column) const override
+    {
+        const unsigned short* bounds = (const unsigned short*)(file.Data() + Header.boundsOffsets[level]) + ((size_t)row * Header.tileColumns[level] + column) * 2;
+        return glm::vec2(TexelHeight(bounds[0]), TexelHeight(bounds[1]));
+    }
+
+private:
+    std::string path;
+    MappedFile file;
+
+    size_t tileOffset(int level, int row, int column) const
+    {
+        return (size_t)Header.tileOffsets[level] + ((size_t)row * Header.tileColumns[level] + column) * TILED_HEIGHTMAP_TILE_BYTES;
+    }
+
+    bool fail(const std::string& path)
+    {
+        std::cout << "ERROR::TILED_HEIGHTMAP::BAD_FILE: " << path << " isn't a tile file of this version" << std::endl;
+        file.Close();
+        return false;
+    }
+};
+
+// Cuts a heightmap into a tile file (see TiledHeightmapHeader) for the paged terrain. The input is either an image
+// stb_image can load, read at 16 bits, or a square headerless file of little-endian 16-bit samples (.raw or .r16),
+// which is memory-mapped rather than loaded, so maps far bigger than memory can be converted. Heights match
+// Heightmap's: an 8-bit image gives the same terrain whichever way it is loaded, and 16-bit input just has finer
+// steps. The output is written a tile at a time, so memory use is one tile plus the bounds tables.
+inline bool writeTiledHeightmap(const std::string& inputPath, const std::string& outputPath)
+{
+    PROFILE_SCOPE("writeTiledHeightmap");
+    MappedFile raw;
+    unsigned short* image = NULL;
+    const unsigned short* samples = NULL;
+    int rows = 0, columns = 0, channels = 1;
+
+    std::string extension = inputPath.substr(inputPath.find_last_of('.') + 1);
+    if (extension == "raw" || extension == "r16")
+    {
+        if (!raw.Open(inputPath))
+        {
+            std::cout << "ERROR::TILED_HEIGHTMAP::FILE_NOT_MAPPED: " << inputPath << std::endl;
+            return false;
+        }
+        rows = columns = (int)std::sqrt((double)(raw.Size() / 2));
+        if ((size_t)rows * columns * 2 != raw.Size())
+        {
+            std::cout << "ERROR::TILED_HEIGHTMAP::RAW_NOT_SQUARE: " << inputPath << std::endl;
+            return false;
+        }
+        samples = (const unsigned short*)raw.Data();
+    }
+    else
+    {
+        stbi_set_flip_vertically_on_load(true);
+        image = stbi_load_16(inputPath.c_str(), &columns, &rows, &channels, 0);
+        if (!image)
+        {
+            std::cout << "ERROR::HEIGHTMAP::FILE_NOT_LOADED: " << inputPath << std::endl;
+            return false;
+        }
+        samples = image;
+    }
+
+    TiledHeightmapHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, TILED_HEIGHTMAP_MAGIC, sizeof(header.magic));
+    header.version = TILED_HEIGHTMAP_VERSION;
+    header.tileSize = TILED_HEIGHTMAP_TILE_SIZE;
+    header.rows = (uint32_t)rows;
+    header.columns = (uint32_t)columns;
+    header.spacing = HEIGHTMAP_SPACING;
+    // 8-bit value v loads as v * 257, so texel t is height t / 257 * scale - shift as in Heightmap::Load
+    header.heightLow = -HEIGHTMAP_HEIGHT_SHIFT;
+    header.heightHigh = 255.0f * HEIGHTMAP_HEIGHT_SCALE - HEIGHTMAP_HEIGHT_SHIFT;
+
+    // levels are added until one tile covers the map. Tile data is page aligned, with every level's bounds after it
+    uint64_t offset = 4096;
+    do
+    {
+        uint32_t level = header.levelCount++;
+        int span = TILED_HEIGHTMAP_TILE_SIZE << level;
+        header.tileRows[level] = (uint32_t)std::max((rows - 1 + span - 1) / span, 1);
+        header.tileColumns[level] = (uint32_t)std::max((columns - 1 + span - 1) / span, 1);
+        header.tileOffsets[level] = offset;
+        offset += (uint64_t)header.tileRows[level] * header.tileColumns[level] * TILED_HEIGHTMAP_TILE_BYTES;
+    } while ((header.tileRows[header.levelCount - 1] > 1 || header.tileColumns[header.levelCount - 1] > 1) && header.levelCount < TILED_HEIGHTMAP_MAX_LEVELS);
+    for (uint32_t level = 0; level < header.levelCount; level++)
+    {
+        header.boundsOffsets[level] = offset;
+        offset += (uint64_t)header.tileRows[level] * header.tileColumns[level] * 2 * sizeof(unsigned short);
+    }
+
+    std::ofstream out(outputPath.c_str(), std::ios::binary);
+    if (!out)
+    {
+        std::cout << "ERROR::TILED_HEIGHTMAP::FILE_NOT_WRITTEN: " << outputPath << std::endl;
+        stbi_image_free(image);
+        return false;
+    }
+    out.write((const char*)&header, sizeof(header));
+    std::vector<char> padding((size_t)header.tileOffsets[0] - sizeof(header), 0);
+    out.write(&padding[0], padding.size());
+
+    std::vector<unsigned short> tile(TILED_HEIGHTMAP_TILE_SAMPLES);
+    std::vector<unsigned short> bounds[TILED_HEIGHTMAP_MAX_LEVELS];
+    for (uint32_t level = 0; level < header.levelCount; level++)
+    {
+        PROFILE_SCOPE("writeTiledHeightmap level");
+        for (uint32_t tileRow = 0; tileRow < header.tileRows[level]; tileRow++)
+        {
+            for (uint32_t tileColumn = 0; tileColumn < header.tileColumns[level]; tileColumn++)
+            {
+                unsigned short low = 65535, high = 0;
+                for (int i = 0; i <= TILED_HEIGHTMAP_TILE_SIZE; i++)
+                {
+                    size_t row = std::min(((size_t)tileRow * TILED_HEIGHTMAP_TILE_SIZE + i) << level, (size_t)rows - 1);
+                    for (int j = 0; j <= TILED_HEIGHTMAP_TILE_SIZE; j++)
+                    {
+                        size_t column = std::min(((size_t)tileColumn * TILED_HEIGHTMAP_TILE_SIZE + j) << level, (size_t)columns - 1);
+                        unsigned short texel = samples[(row * columns + column) * channels];
+                        tile[i * (TILED_HEIGHTMAP_TILE_SIZE + 1) + j] = texel;
+                        low = std::min(low, texel);
+                        high = std::max(high, texel);
+                    }
+                }
+                out.write((const char*)&tile[0], TILED_HEIGHTMAP_TILE_BYTES);
+                // the samples this level skipped are under the (up to) four tiles below it
+                for (uint32_t childRow = tileRow * 2; level > 0 && childRow < std::min(tileRow * 2 + 2, header.tileRows[level - 1]); childRow++)
+                {
+                    for (uint32_t childColumn = tileColumn * 2; childColumn < std::min(tileColumn * 2 + 2, header.tileColumns[level - 1]); childColumn++)
+                    {
+                        size_t child = ((size_t)childRow * header.tileColumns[level - 1] + childColumn) * 2;
+                        low = std::min(low, bounds[level - 1][child]);
+                        high = std::max(high, bounds[level - 1][child + 1]);
+                    }
+                }
+                bounds[level].push_back(low);
+                bounds[level].push_back(high);
+            }
+            // the rows of the raw input that were just read won't be needed again at this level
+            if (raw.Data() && level == 0)
+                raw.Release((size_t)tileRow * TILED_HEIGHTMAP_TILE_SIZE * columns * 2, (size_t)TILED_HEIGHTMAP_TILE_SIZE * columns * 2);
+        }
+        std::cout << "Wrote level " << level << " of " << header.tileRows[level] << " x " << header.tileColumns[level] << " tiles" << std::endl;
+    }
+    for (uint32_t level = 0; level < header.levelCount; level++)
+        out.write((const char*)&bounds[level][0], bounds[level].size() * sizeof(unsigned short));
+
+    stbi_image_free(image);
+    if (!out)
+    {
+        std::cout << "ERROR::TILED_HEIGHTMAP::FILE_NOT_WRITTEN: " << outputPath << std::endl;
+        return false;
+    }
+    std::cout << "Wrote tiled heightmap of size " << rows << " x " << columns << " to " << outputPath << std::endl;
+    return true;
+}
+#endif
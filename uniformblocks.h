@@ -0,0 +1,144 @@
+#ifndef UNIFORMBLOCKS_H
+#define UNIFORMBLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstring>
+
+// Binding points of the per-frame uniform blocks. Every program that declares a block reads it from the same buffer
+enum Uniform_Block_Binding {
+    CAMERA_BLOCK_BINDING = 0,
+    LIGHTS_BLOCK_BINDING = 1,
+    FOG_BLOCK_BINDING = 2,
+    SNOW_BLOCK_BINDING = 3,
+    TERRAIN_LIGHTING_BLOCK_BINDING = 4
+};
+
+// The structs below mirror the std140 layout of the blocks declared in the shaders, padding included.
+// Change both together.
+
+// layout (std140) uniform Camera, in every shader
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    // projection with a far plane that takes in the whole heightmap
+    glm::mat4 terrainProjection;
+    glm::vec3 cameraPos;
+    float pad0;
+};
+
+// struct Light in shader.fs. A float after a vec3 fills the vec3's fourth component
+struct LightStd140 {
+    glm::vec3 position;
+    float pad0;
+    glm::vec3 ambient;
+    float pad1;
+    glm::vec3 diffuse;
+    float pad2;
+    glm::vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+    float pad3[2];
+};
+
+// layout (std140) uniform Lights, in shader.fs
+struct LightsBlock {
+    LightStd140 light;
+    LightStd140 colouredLight;
+};
+
+// struct FogSettings in shader.fs and heightMapShader.fs
+struct FogStd140 {
+    glm::vec4 colour;
+    // distance at which fog starts to build up
+    float distance;
+    float pad0[3];
+};
+
+// layout (std140) uniform Fog, in shader.fs and heightMapShader.fs
+struct FogBlock {
+    FogStd140 objectFog;
+    FogStd140 terrainFog;
+};
+
+// layout (std140) uniform Snow, in the terrain vertex shaders, see snowtrails.h
+struct SnowBlock {
+    // world x and z of the trail texture's corner, 1 / the world units it covers, and how deep a full trail sinks the ground
+    glm::vec4 window;
+};
+
+// layout (std140) uniform TerrainLighting, in heightMapShader.fs, see terrainlighting.h
+struct TerrainLightingBlock {
+    // scale and offset from world (z, x) to the baked textures' coordinates
+    glm::vec4 mapTransform;
+    // towards the sun, and 1 if the terrain is lit or 0 if it's shaded by height alone
+    glm::vec4 sunDirection;
+};
+
+static_assert(sizeof(CameraBlock) == 208, "CameraBlock must match the std140 layout of the Camera block");
+static_assert(sizeof(LightStd140) == 80, "LightStd140 must match the std140 layout of struct Light");
+static_assert(sizeof(FogStd140) == 32, "FogStd140 must match the std140 layout of struct FogSettings");
+static_assert(sizeof(SnowBlock) == 16, "SnowBlock must match the std140 layout of the Snow block");
+static_assert(sizeof(TerrainLightingBlock) == 32, "TerrainLightingBlock must match the std140 layout of the TerrainLighting block");
+
+// A uniform buffer holding one block. Fill in Data each frame and call Upload(), which only sends the bytes that
+// changed since the last upload (none if nothing did), whatever the number of programs reading the block.
+template <typename T>
+class UniformBlock
+{
+public:
+    unsigned int ID;
+    T Data;
+
+    UniformBlock() : ID(0), uploaded(false)
+    {
+        // zeroed so padding compares equal between uploads
+        std::memset((void*)&Data, 0, sizeof(T));
+        std::memset((void*)&shadow, 0, sizeof(T));
+    }
+
+    void Init(GLuint binding)
+    {
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+    }
+
+    // returns the number of bytes sent
+    size_t Upload()
+    {
+        const unsigned char* data = (const unsigned char*)&Data;
+        const unsigned char* last = (const unsigned char*)&shadow;
+        size_t begin = 0, end = sizeof(T);
+        if (uploaded)
+        {
+            while (begin < end && data[begin] == last[begin])
+                begin++;
+            while (end > begin && data[end - 1] == last[end - 1])
+                end--;
+            if (begin == end)
+                return 0;
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, begin, end - begin, data + begin);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        std::memcpy((void*)&shadow, &Data, sizeof(T));
+        uploaded = true;
+        return end - begin;
+    }
+
+    void Destroy()
+    {
+        glDeleteBuffers(1, &ID);
+        ID = 0;
+    }
+
+private:
+    T shadow;
+    bool uploaded;
+};
+#endif